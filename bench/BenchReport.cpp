@@ -0,0 +1,230 @@
+/*
+ * BenchReport.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "BenchReport.h"
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+double BenchResult::percentile(double p) const {
+	if (samples.empty()) return 0;
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	const double at = p / 100 * (sorted.size() - 1);
+	const unsigned below = (unsigned) at;
+	if (below + 1 >= sorted.size()) return sorted.back();
+	return sorted[below] + (at - below) * (sorted[below + 1] - sorted[below]);
+}
+
+double BenchResult::mean() const {
+	if (samples.empty()) return 0;
+	double sum = 0;
+	for (unsigned i = 0; i < samples.size(); ++i) sum += samples[i];
+	return sum / samples.size();
+}
+
+BenchReport::BenchReport(std::string const& benchmark_) : benchmark(benchmark_) {
+#ifdef __VERSION__
+	info["compiler"] = __VERSION__;
+#endif
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	char text[16];
+	snprintf(text, sizeof(text), "%d", threads);
+	info["threads"] = text;
+#ifdef __OPTIMIZE__
+	info["optimized"] = "yes";
+#else
+	info["optimized"] = "no";
+#endif
+}
+
+std::vector<double> BenchReport::measure(BenchCase& c, unsigned warmup, unsigned reps, double budget) {
+	std::vector<double> times;
+	double longest = 0;
+	for (unsigned i = 0; i < warmup; ++i) {
+		c.setUp();
+		const double start = FrameScheduler::now();
+		c.run();
+		longest = std::max(longest, FrameScheduler::now() - start);
+		c.tearDown();
+	}
+	if (longest * reps > budget) reps = std::max(3u, (unsigned) (budget / longest));
+	for (unsigned i = 0; i < reps; ++i) {
+		c.setUp();
+		const double start = FrameScheduler::now();
+		c.run();
+		times.push_back((FrameScheduler::now() - start) * 1000);
+		c.tearDown();
+	}
+	return times;
+}
+
+void BenchReport::printSummary(std::ostream& out) const {
+	char line[256];
+	for (unsigned i = 0; i < results.size(); ++i) {
+		BenchResult const& r = results[i];
+		snprintf(line, sizeof(line), "%-14s %-22s %12.4g %s  (p10 %.4g, p90 %.4g, n=%u)",
+				r.input.c_str(), r.name.c_str(), r.percentile(50), r.unit.c_str(),
+				r.percentile(10), r.percentile(90), (unsigned) r.samples.size());
+		out << line << std::endl;
+	}
+}
+
+// the names and inputs are ours, only quotes and backslashes need escaping
+static std::string quoted(std::string const& s) {
+	std::string q("\"");
+	for (unsigned i = 0; i < s.size(); ++i) {
+		if (s[i] == '"' || s[i] == '\\') q += '\\';
+		q += s[i];
+	}
+	return q + "\"";
+}
+
+static std::string number(double x) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.6g", x);
+	return buf;
+}
+
+void BenchReport::writeJSON(std::ostream& out) const {
+	out << "{" << std::endl;
+	out << "  \"benchmark\": " << quoted(benchmark) << "," << std::endl;
+	out << "  \"info\": {";
+	for (std::map<std::string, std::string>::const_iterator it = info.begin(); it != info.end(); ++it) {
+		out << (it == info.begin() ? "" : ", ") << quoted(it->first) << ": " << quoted(it->second);
+	}
+	out << "}," << std::endl;
+	out << "  \"results\": [" << std::endl;
+	for (unsigned i = 0; i < results.size(); ++i) {
+		BenchResult const& r = results[i];
+		out << "    {\"name\": " << quoted(r.name) << ", \"input\": " << quoted(r.input)
+				<< ", \"unit\": " << quoted(r.unit) << ", \"count\": " << r.samples.size();
+		out << ", \"median\": " << number(r.percentile(50)) << ", \"p10\": " << number(r.percentile(10))
+				<< ", \"p90\": " << number(r.percentile(90)) << ", \"p99\": " << number(r.percentile(99))
+				<< ", \"min\": " << number(r.percentile(0)) << ", \"max\": " << number(r.percentile(100))
+				<< ", \"mean\": " << number(r.mean());
+		out << ", \"params\": {";
+		for (std::map<std::string, double>::const_iterator it = r.params.begin(); it != r.params.end(); ++it) {
+			out << (it == r.params.begin() ? "" : ", ") << quoted(it->first) << ": " << number(it->second);
+		}
+		out << "}";
+		if (r.keepSamples) {
+			out << ", \"samples\": [";
+			for (unsigned s = 0; s < r.samples.size(); ++s) out << (s ? ", " : "") << number(r.samples[s]);
+			out << "]";
+		}
+		out << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
+// the value of "key": in a line of writeJSON (a string without its quotes, or a number)
+static bool field(std::string const& line, std::string const& key, std::string& value) {
+	const std::string k = "\"" + key + "\": ";
+	size_t at = line.find(k);
+	if (at == std::string::npos) return false;
+	at += k.size();
+	if (line[at] == '"') {
+		const size_t end = line.find('"', at + 1);
+		if (end == std::string::npos) return false;
+		value = line.substr(at + 1, end - at - 1);
+	} else {
+		value = line.substr(at, line.find_first_of(",}", at) - at);
+	}
+	return true;
+}
+
+int BenchReport::compare(std::string const& baselineFile, double threshold, std::ostream& out) const {
+	std::ifstream in(baselineFile.c_str());
+	if (!in) return -1;
+	std::map<std::string, double> before; // by input and name
+	std::string line, name, input, median;
+	while (std::getline(in, line)) {
+		if (field(line, "name", name) && field(line, "input", input) && field(line, "median", median))
+			before[input + " " + name] = atof(median.c_str());
+	}
+
+	int regressions = 0;
+	char text[256];
+	for (unsigned i = 0; i < results.size(); ++i) {
+		BenchResult const& r = results[i];
+		std::map<std::string, double>::const_iterator it = before.find(r.input + " " + r.name);
+		if (it == before.end() || it->second <= 0) continue;
+		const double change = (r.percentile(50) / it->second - 1) * 100;
+		if (change <= threshold) continue;
+		snprintf(text, sizeof(text), "SLOWER %-14s %-22s %.4g -> %.4g %s (+%.1f%%)", r.input.c_str(), r.name.c_str(),
+				it->second, r.percentile(50), r.unit.c_str(), change);
+		out << text << std::endl;
+		regressions++;
+	}
+	return regressions;
+}
+
+int BenchReport::finish(std::string const& file, std::string const& baseline, double threshold) const {
+	printSummary(std::cerr);
+	if (file.empty()) {
+		writeJSON(std::cout);
+	} else {
+		std::ofstream out(file.c_str());
+		writeJSON(out);
+		if (!out) {
+			std::cerr << "ERROR: could not write " << file << std::endl;
+			return 1;
+		}
+	}
+	if (baseline.empty()) return 0;
+	const int slower = compare(baseline, threshold, std::cerr);
+	if (slower < 0) {
+		std::cerr << "ERROR: could not read " << baseline << std::endl;
+		return 1;
+	}
+	std::cerr << slower << " slower than " << baseline << " by more than " << threshold << "%" << std::endl;
+	return (slower > 0) ? 3 : 0;
+}
+
+std::string benchFiles::makeWorkDirectory() {
+	char dirTemplate[] = "/tmp/personviewer-bench.XXXXXX";
+	return mkdtemp(dirTemplate) ? std::string(dirTemplate) : std::string();
+}
+
+void benchFiles::removeDirectory(std::string const& dir) {
+	DIR* d = opendir(dir.c_str());
+	if (!d) return;
+	for (dirent* e = readdir(d); e != NULL; e = readdir(d)) {
+		if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+		unlink((dir + "/" + e->d_name).c_str());
+	}
+	closedir(d);
+	rmdir(dir.c_str());
+}
+
+bool benchFiles::copyFile(std::string const& from, std::string const& to) {
+	std::ifstream in(from.c_str(), std::ios::binary);
+	std::ofstream out(to.c_str(), std::ios::binary);
+	out << in.rdbuf();
+	return in && out;
+}
+
+std::string benchFiles::absolute(std::string const& path) {
+	char full[PATH_MAX];
+	return realpath(path.c_str(), full) ? std::string(full) : std::string();
+}
@@ -0,0 +1,107 @@
+/*
+ * BenchReport.h
+ * What the benchmarks share: running a case a few times to warm up and then
+ * timing it, the statistics of the times (median and percentiles rather
+ * than the mean, a run that got interrupted shouldn't move them much), and
+ * writing them all out as JSON, so two builds can be compared.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef BENCHREPORT_H_
+#define BENCHREPORT_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// one thing to time; setUp and tearDown are not timed
+class BenchCase {
+public:
+	virtual ~BenchCase() {}
+	virtual void setUp() {}
+	virtual void run() = 0;
+	virtual void tearDown() {}
+};
+
+struct BenchResult {
+	std::string name;
+	std::string input;
+	std::string unit; // of the samples
+	std::vector<double> samples;
+	std::map<std::string, double> params; // what was measured, e.g. vertices
+	bool keepSamples; // written out with the statistics
+
+	BenchResult() : unit("ms"), keepSamples(true) {}
+	// p in [0, 100], linear between the closest samples
+	double percentile(double p) const;
+	double mean() const;
+};
+
+class BenchReport {
+private:
+	std::string benchmark;
+	std::vector<BenchResult> results;
+	std::map<std::string, std::string> info; // about the build and the machine
+
+public:
+	explicit BenchReport(std::string const& benchmark);
+	virtual ~BenchReport() {}
+
+	void setInfo(std::string const& key, std::string const& value) { info[key] = value; }
+	BenchResult& add(BenchResult const& result) { results.push_back(result); return results.back(); }
+	std::vector<BenchResult> const& getResults() const { return results; }
+
+	/* Runs c warmup times, then reps times (fewer if one warmup run took
+	 * longer than budget seconds, but at least 3), and returns the times in ms.
+	 */
+	static std::vector<double> measure(BenchCase& c, unsigned warmup, unsigned reps, double budget);
+
+	// one line per result: median and the 10th and 90th percentile
+	void printSummary(std::ostream& out) const;
+	void writeJSON(std::ostream& out) const;
+	/* Compares the medians with the ones in a file written by writeJSON
+	 * before (e.g. by another build), and prints the ones that got slower by
+	 * more than threshold percent. Returns how many did, -1 if the file
+	 * can't be read.
+	 */
+	int compare(std::string const& baselineFile, double threshold, std::ostream& out) const;
+	/* What a benchmark does at the end: the summary to stderr, the JSON into
+	 * file (stdout if empty) and the comparison with baseline (if not empty).
+	 * Returns the exit status: 1 if a file couldn't be written or read, 3 if
+	 * something got slower, 0 otherwise.
+	 */
+	int finish(std::string const& file, std::string const& baseline, double threshold) const;
+};
+
+// the benchmarks work in a directory of their own, so nothing is left next to the inputs
+namespace benchFiles {
+	// a new directory under /tmp, empty if it can't be made
+	std::string makeWorkDirectory();
+	// removes dir and the files in it
+	void removeDirectory(std::string const& dir);
+	bool copyFile(std::string const& from, std::string const& to);
+	// path from the current directory (empty if it doesn't exist)
+	std::string absolute(std::string const& path);
+}
+
+// while one of these is around, std::cout writes nowhere (the library prints a lot)
+class QuietCout {
+private:
+	struct NullBuf : public std::streambuf {
+		int overflow(int c) { return c; }
+	};
+	NullBuf nullBuf;
+	std::streambuf* saved;
+
+	QuietCout(QuietCout const&);
+	QuietCout& operator=(QuietCout const&);
+
+public:
+	QuietCout() : saved(std::cout.rdbuf(&nullBuf)) {}
+	~QuietCout() { std::cout.rdbuf(saved); }
+};
+
+#endif /* BENCHREPORT_H_ */
@@ -0,0 +1,531 @@
+/*
+ * kernels.cpp
+ * Times the small functions the stages spend their time in, in ns per call,
+ * so a rewrite of one can be judged on its own. The inputs are taken from
+ * person-tiny (and person-small) with rundive, as the pipeline sees them:
+ * the segments from the vertices to their attachment points against the
+ * triangles of the mesh (split into the pairs the bounding spheres reject
+ * and the ones that go on to the full test), the rotations of the frames
+ * (and the angles they are made of, one at a time the old ZYX way and with
+ * the composer, and whole joints in batches),
+ * the vertices with the bones that move them, and the vectors delta is
+ * made of.
+ *
+ * Each case runs over its inputs enough times to take about --target-ms;
+ * that is timed a few times and the median per call is reported.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Sparse>
+
+#include "BenchReport.h"
+#include "Animation.h"
+#include "Attachment.h"
+#include "ChannelLayout.h"
+#include "EulerBatch.h"
+#include "FrameScheduler.h"
+#include "Mesh.h"
+#include "Quaternion.h"
+#include "Skeleton.h"
+#include "geometry.h"
+#include "sparseMatrixHelp.h"
+#include "tools.h"
+
+using namespace std;
+
+struct Options {
+	string data;
+	string out, baseline;
+	unsigned warmup, reps;
+	double targetMs; // per sample
+	double threshold; // percent
+
+	Options() : data("a3files"), warmup(2), reps(11), targetMs(20), threshold(10) {}
+};
+
+static const unsigned MAX_INPUTS = 16384; // per case, so they stay in the cache like in the loops they come from
+
+// the results go here, so the loops are not optimized away
+static volatile float sink;
+
+// a case that runs over n inputs passes times
+class KernelCase : public BenchCase {
+public:
+	unsigned passes;
+	KernelCase() : passes(1) {}
+	virtual unsigned getInputNum() const = 0;
+};
+
+class IntersectCase : public KernelCase {
+private:
+	vector<LineSegment> const& segments;
+	vector<Triangle> const& triangles;
+public:
+	IntersectCase(vector<LineSegment> const& s, vector<Triangle> const& t) : segments(s), triangles(t) {}
+	unsigned getInputNum() const { return segments.size(); }
+	void run() {
+		unsigned hits = 0;
+		for (unsigned p = 0; p < passes; ++p)
+			for (unsigned i = 0; i < segments.size(); ++i) hits += intersectLineSegWithTriangle(segments[i], triangles[i]);
+		sink = hits;
+	}
+};
+
+class TooFarCase : public KernelCase {
+private:
+	vector<Sphere> const& a;
+	vector<Sphere> const& b;
+public:
+	TooFarCase(vector<Sphere> const& a_, vector<Sphere> const& b_) : a(a_), b(b_) {}
+	unsigned getInputNum() const { return a.size(); }
+	void run() {
+		unsigned far = 0;
+		for (unsigned p = 0; p < passes; ++p)
+			for (unsigned i = 0; i < a.size(); ++i) far += a[i].tooFar(b[i]);
+		sink = far;
+	}
+};
+
+// what skinning does with a point: sum += (p - offset) * weight
+class PointAccumulateCase : public KernelCase {
+private:
+	vector<Point> const& points;
+public:
+	PointAccumulateCase(vector<Point> const& p) : points(p) {}
+	unsigned getInputNum() const { return points.size() - 1; }
+	void run() {
+		Point sum;
+		for (unsigned p = 0; p < passes; ++p)
+			for (unsigned i = 0; i + 1 < points.size(); ++i) sum += (points[i] - points[i+1]) * 0.5f;
+		sink = sum.x() + sum.y() + sum.z();
+	}
+};
+
+class PointLengthCase : public KernelCase {
+private:
+	vector<Point> const& points;
+public:
+	PointLengthCase(vector<Point> const& p) : points(p) {}
+	unsigned getInputNum() const { return points.size() - 1; }
+	void run() {
+		float sum = 0;
+		for (unsigned p = 0; p < passes; ++p)
+			for (unsigned i = 0; i + 1 < points.size(); ++i) sum += (points[i] - points[i+1]).getLength();
+		sink = sum;
+	}
+};
+
+class SlerpCase : public KernelCase {
+private:
+	vector<Quaternion> const& from;
+	vector<Quaternion> const& to;
+	vector<float> const& t;
+public:
+	SlerpCase(vector<Quaternion> const& a, vector<Quaternion> const& b, vector<float> const& t_) : from(a), to(b), t(t_) {}
+	unsigned getInputNum() const { return from.size(); }
+	void run() {
+		Quaternion q;
+		float sum = 0, c[4];
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned i = 0; i < from.size(); ++i) {
+				Quaternion::slerp(from[i], to[i], t[i], q);
+				q.getComponents(c);
+				sum += c[0];
+			}
+		}
+		sink = sum;
+	}
+};
+
+class RotationMatrixCase : public KernelCase {
+private:
+	vector<Quaternion> quats; // (getRotation isn't const)
+public:
+	RotationMatrixCase(vector<Quaternion> const& q) : quats(q) {}
+	unsigned getInputNum() const { return quats.size(); }
+	void run() {
+		float m[16], sum = 0;
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned i = 0; i < quats.size(); ++i) {
+				quats[i].getRotation(m);
+				sum += m[0] + m[5];
+			}
+		}
+		sink = sum;
+	}
+};
+
+class GenMatrixCase : public KernelCase {
+private:
+	vector<MotionFrame> frames;
+	vector<ChannelLayout> layouts; // of the joint of each frame
+public:
+	GenMatrixCase(vector<MotionFrame> const& f, vector<ChannelLayout> const& l) : frames(f), layouts(l) {}
+	unsigned getInputNum() const { return frames.size(); }
+	void run() {
+		float sum = 0;
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned i = 0; i < frames.size(); ++i) {
+				frames[i].genMatrix(layouts[i]);
+				sum += frames[i].getMatrix()(0, 0);
+			}
+		}
+		sink = sum;
+	}
+};
+
+/* The rotation of a frame out of its angles, for ZYX joints: Fixed is how it
+ * was done before any channel order could be read (three general quaternion
+ * products), else the composer the ChannelLayout picks for ZYX
+ * (EulerRotation<Z, Y, X>), which has to be no slower.
+ */
+template <bool Fixed>
+class EulerZYXCase : public KernelCase {
+private:
+	vector<float> const& degrees; // x, y, z of each frame
+	ChannelLayout layout;
+public:
+	EulerZYXCase(vector<float> const& d) : degrees(d) {
+		const unsigned char zyx[3] = {ChannelLayout::ZROT, ChannelLayout::YROT, ChannelLayout::XROT};
+		layout = ChannelLayout(zyx, 3);
+	}
+	unsigned getInputNum() const { return degrees.size() / 3; }
+	void run() {
+		float sum = 0, c[4];
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned i = 0; i < degrees.size(); i += 3) {
+				float const* d = &degrees[i];
+				Quaternion q;
+				if (Fixed) {
+					q = Quaternion(degToRad(d[2]), 0, 0, 1);
+					q *= Quaternion(degToRad(d[1]), 0, 1, 0);
+					q *= Quaternion(degToRad(d[0]), 1, 0, 0);
+				} else {
+					q = layout.compose(d);
+				}
+				q.getComponents(c);
+				sum += c[0];
+			}
+		}
+		sink = sum;
+	}
+};
+
+// the angles of the frames of each joint turned into matrices a joint at a time, as
+// Skeleton::addAnimationFrames does it (ns per frame of a joint, the three angles)
+class EulerBatchCase : public KernelCase {
+private:
+	vector<ChannelLayout> const& layouts; // of each joint
+	vector< vector<float> > const& degrees; // of each joint: the x, y, z angles of its frames, an array each
+	const unsigned frameNum;
+	vector<float> work; // the quaternions and the matrices of a joint
+public:
+	EulerBatchCase(vector<ChannelLayout> const& l, vector< vector<float> > const& d, unsigned frames) :
+		layouts(l), degrees(d), frameNum(frames), work(16 * frames) {}
+	unsigned getInputNum() const { return layouts.size() * frameNum; }
+	void run() {
+		float* quat[4] = {&work[0], &work[frameNum], &work[2 * frameNum], &work[3 * frameNum]};
+		float* mats = &work[4 * frameNum];
+		float sum = 0;
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned j = 0; j < layouts.size(); ++j) {
+				float const* rot[3] = {&degrees[j][0], &degrees[j][frameNum], &degrees[j][2 * frameNum]};
+				layouts[j].composeBatch(rot, frameNum, quat);
+				eulerBatch::toMatrices(quat, NULL, frameNum, mats);
+				sum += mats[0];
+			}
+		}
+		sink = sum;
+	}
+};
+
+// a vertex, one of the bones that moves it, and a frame
+struct Influence {
+	Eigen::Vector4f point;
+	int bone;
+	unsigned frame;
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+class LocationCase : public KernelCase {
+private:
+	Skeleton const& skeleton;
+	vector<Influence, Eigen::aligned_allocator<Influence> > const& influences;
+public:
+	LocationCase(Skeleton const& s, vector<Influence, Eigen::aligned_allocator<Influence> > const& i) :
+		skeleton(s), influences(i) {}
+	unsigned getInputNum() const { return influences.size(); }
+	void run() {
+		float sum = 0;
+		const unsigned root = skeleton.getRoot(0);
+		for (unsigned p = 0; p < passes; ++p) {
+			for (unsigned i = 0; i < influences.size(); ++i) {
+				Eigen::Vector4f v = influences[i].point;
+				skeleton.getLocation(root, v, influences[i].bone, influences[i].frame);
+				sum += v(0);
+			}
+		}
+		sink = sum;
+	}
+};
+
+class DeltaCase : public KernelCase {
+private:
+	Eigen::VectorXd const& vec;
+public:
+	DeltaCase(Eigen::VectorXd const& v) : vec(v) {}
+	unsigned getInputNum() const { return 1; }
+	void run() {
+		double sum = 0;
+		for (unsigned p = 0; p < passes; ++p) sum += delta(vec).nonZeros();
+		sink = sum;
+	}
+};
+
+// ----
+
+static vector<char> writable(string const& s) {
+	vector<char> buf(s.begin(), s.end());
+	buf.push_back('\0');
+	return buf;
+}
+
+static void timed(string const& name, string const& input, KernelCase& c, Options const& opt,
+		BenchReport& report, map<string, double> params = map<string, double>()) {
+	cerr << name << ".." << endl;
+	// enough passes for targetMs
+	c.passes = 1;
+	for (;;) {
+		const double start = FrameScheduler::now();
+		c.run();
+		const double ms = (FrameScheduler::now() - start) * 1000;
+		if (ms >= opt.targetMs / 4 || c.passes >= (1u << 24)) {
+			c.passes = max(1u, (unsigned) (c.passes * opt.targetMs / max(ms, 1e-3)));
+			break;
+		}
+		c.passes *= 8;
+	}
+	BenchResult r;
+	r.name = name;
+	r.input = input;
+	r.unit = "ns/op";
+	params["inputs"] = c.getInputNum();
+	params["passes"] = c.passes;
+	r.params = params;
+	r.samples = BenchReport::measure(c, opt.warmup, opt.reps, 1e9);
+	const double ops = (double) c.passes * c.getInputNum();
+	for (unsigned i = 0; i < r.samples.size(); ++i) r.samples[i] *= 1e6 / ops;
+	report.add(r);
+}
+
+static void usage() {
+	cerr << "bench-kernels [--data <dir>] [--warmup <n>] [--reps <n>] [--target-ms <ms>] [--out <file.json>]" << endl;
+	cerr << "              [--baseline <file.json> [--threshold <%>]]" << endl;
+	cerr << "Times the geometry and rotation kernels on inputs taken from the a3files in <dir> (a3files by default)," << endl;
+	cerr << "in ns per call. With a baseline, the kernels whose median is more than threshold percent (10) slower" << endl;
+	cerr << "are listed and the exit status is 3." << endl;
+}
+
+int main(int argc, char** argv) {
+	Options opt;
+	for (int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		if (arg.compare("--data") == 0 && i+1 < argc) opt.data = argv[++i];
+		else if (arg.compare("--out") == 0 && i+1 < argc) opt.out = argv[++i];
+		else if (arg.compare("--baseline") == 0 && i+1 < argc) opt.baseline = argv[++i];
+		else if (arg.compare("--threshold") == 0 && i+1 < argc) opt.threshold = atof(argv[++i]);
+		else if (arg.compare("--warmup") == 0 && i+1 < argc) opt.warmup = atoi(argv[++i]);
+		else if (arg.compare("--reps") == 0 && i+1 < argc) opt.reps = atoi(argv[++i]);
+		else if (arg.compare("--target-ms") == 0 && i+1 < argc) opt.targetMs = atof(argv[++i]);
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (opt.reps == 0 || opt.targetMs <= 0) {
+		usage();
+		return 1;
+	}
+	const string data = benchFiles::absolute(opt.data);
+	if (data.empty()) {
+		cerr << "ERROR: no directory " << opt.data << endl;
+		return 1;
+	}
+	if (!opt.out.empty() && opt.out[0] != '/') opt.out = benchFiles::absolute(".") + "/" + opt.out;
+	if (!opt.baseline.empty()) opt.baseline = benchFiles::absolute(opt.baseline);
+	const string work = benchFiles::makeWorkDirectory();
+	if (work.empty() || chdir(work.c_str()) != 0) {
+		cerr << "ERROR: could not make a work directory" << endl;
+		return 1;
+	}
+
+	// the a3files, loaded and attached like the viewer does
+	boost::shared_ptr<Mesh> model(new Mesh()), small(new Mesh());
+	boost::shared_ptr<Animation> anim;
+	{
+		QuietCout quiet;
+		vector<char> tiny = writable(work + "/person-tiny.obj"), smallName = writable(work + "/person-small.obj");
+		vector<char> clip = writable(work + "/rundive.bvh");
+		if (!benchFiles::copyFile(data + "/mesh/person-tiny.obj", &tiny[0])
+				|| !benchFiles::copyFile(data + "/mesh/person-small.obj", &smallName[0])
+				|| !benchFiles::copyFile(data + "/motion/rundive.bvh", &clip[0])) {
+			cerr << "ERROR: could not copy the a3files from " << data << endl;
+			benchFiles::removeDirectory(work);
+			return 1;
+		}
+		try {
+			model->loadModel(&tiny[0]);
+			small->loadModel(&smallName[0]);
+			anim.reset(new Animation(&clip[0]));
+		} catch (ParseException& e) {
+			cerr << e.what() << endl;
+			benchFiles::removeDirectory(work);
+			return 2;
+		}
+		anim->setModel(model, false);
+	}
+	Skeleton const& skeleton = anim->getSkeleton();
+	const unsigned root = skeleton.getRoot(0);
+	const unsigned frameNum = skeleton.getAnimFrameNum(root);
+
+	// the segments from the vertices to their attachment points, against the
+	// triangles in the order Mesh::intersects goes through them
+	vector<LineSegment> rejectedSegments, fullSegments;
+	vector<Triangle> rejectedTriangles, fullTriangles;
+	vector<Sphere> spheresA, spheresB; // the first pairs, whatever happens to them
+	unsigned hits = 0;
+	std::vector<Point> const& vertices = model->getOrigVertices();
+	TriangleRecord const* triangles = model->getTriangleRecords();
+	for (unsigned v = 0; v < vertices.size() && fullSegments.size() < MAX_INPUTS; v += 3) {
+		std::set<Attachment> attachments;
+		skeleton.getClosestBones(root, vertices[v], attachments);
+		for (std::set<Attachment>::const_iterator a = attachments.begin(); a != attachments.end(); ++a) {
+			LineSegment l(a->getAttachPoint(), vertices[v]);
+			for (unsigned f = 0; f < model->getNumFaces(); ++f) {
+				Triangle t = triangles[f].toTriangle();
+				if (spheresA.size() < MAX_INPUTS) {
+					spheresA.push_back(l.getBoundSphere());
+					spheresB.push_back(t.getBoundSphere());
+				}
+				if (l.getBoundSphere().tooFar(t.getBoundSphere())) {
+					if (rejectedSegments.size() < MAX_INPUTS) {
+						rejectedSegments.push_back(l);
+						rejectedTriangles.push_back(t);
+					}
+				} else if (fullSegments.size() < MAX_INPUTS) {
+					fullSegments.push_back(l);
+					fullTriangles.push_back(t);
+					hits += intersectLineSegWithTriangle(l, t);
+				}
+			}
+		}
+	}
+
+	// the rotations of the animated joints in consecutive frames, and where between them
+	vector<Quaternion> from, to;
+	vector<float> between;
+	vector<MotionFrame> frames;
+	vector<ChannelLayout> layouts;
+	vector<float> zyxDegrees; // the angles of the ZYX joints, x y z
+	vector<unsigned> const& animated = skeleton.getAnimatedJoints();
+	for (unsigned f = 0; f + 1 < frameNum && from.size() < MAX_INPUTS; ++f) {
+		for (unsigned a = 0; a < animated.size(); ++a) {
+			from.push_back(skeleton.getFrame(animated[a], f).getRotation());
+			to.push_back(skeleton.getFrame(animated[a], f + 1).getRotation());
+			between.push_back(fmod(0.37 * (f * animated.size() + a), 1.0));
+			frames.push_back(skeleton.getFrame(animated[a], f));
+			layouts.push_back(skeleton.getLayout(animated[a]));
+			unsigned char const* order = layouts.back().getRotationOrder();
+			if (layouts.back().getRotationNum() == 3 && order[0] == 2 && order[1] == 1 && order[2] == 0) {
+				for (unsigned axis = 0; axis < 3; ++axis) zyxDegrees.push_back(frames.back().getValue(ChannelLayout::XROT + axis));
+			}
+		}
+	}
+
+	// the angles of the animated joints, an array per axis
+	const unsigned batchFrames = min(frameNum, MAX_INPUTS / max(1u, (unsigned) animated.size()));
+	vector<ChannelLayout> jointLayouts;
+	vector< vector<float> > jointDegrees;
+	for (unsigned a = 0; a < animated.size(); ++a) {
+		jointLayouts.push_back(skeleton.getLayout(animated[a]));
+		jointDegrees.push_back(vector<float>(3 * batchFrames));
+		for (unsigned f = 0; f < batchFrames; ++f) {
+			for (unsigned axis = 0; axis < 3; ++axis) {
+				jointDegrees.back()[axis * batchFrames + f] = skeleton.getFrame(animated[a], f).getValue(ChannelLayout::XROT + axis);
+			}
+		}
+	}
+
+	// what skinFrame calls getLocation with: the bones with a weight, over the frames
+	vector<Influence, Eigen::aligned_allocator<Influence> > influences;
+	Eigen::MatrixXd const& weights = anim->getAttachWeights();
+	for (unsigned k = 0; influences.size() < MAX_INPUTS && k < 64 * vertices.size(); ++k) {
+		const unsigned v = k % vertices.size();
+		for (int b = 0; b < weights.cols(); ++b) {
+			if (weights(v, b) <= EPS) continue;
+			Influence in;
+			in.point = getVectorFormPoint(vertices[v]);
+			in.bone = b;
+			in.frame = (k / vertices.size() * 97 + v) % frameNum;
+			influences.push_back(in);
+		}
+	}
+
+	// delta is made of the number of neighbours of each vertex when the Laplacian is built
+	Eigen::VectorXd tinyDegrees(model->getNumVertices()), smallDegrees(small->getNumVertices());
+	for (int v = 0; v < tinyDegrees.rows(); ++v) tinyDegrees(v) = model->getLaplacian().coeff(v, v);
+	for (int v = 0; v < smallDegrees.rows(); ++v) smallDegrees(v) = small->getLaplacian().coeff(v, v);
+
+	BenchReport report("kernels");
+	stringstream s;
+	s << opt.warmup << " warmup, " << opt.reps << " reps, " << opt.targetMs << " ms per sample";
+	report.setInfo("runs", s.str());
+	const string a3 = "a3files";
+
+	IntersectCase rejected(rejectedSegments, rejectedTriangles), full(fullSegments, fullTriangles);
+	timed("intersect_rejected", a3, rejected, opt, report);
+	map<string, double> params;
+	params["hits"] = hits;
+	timed("intersect_full", a3, full, opt, report, params);
+	TooFarCase tooFar(spheresA, spheresB);
+	timed("sphere_too_far", a3, tooFar, opt, report);
+	PointAccumulateCase accumulate(vertices);
+	timed("point_sub_scale_add", a3, accumulate, opt, report);
+	PointLengthCase length(vertices);
+	timed("point_length", a3, length, opt, report);
+	SlerpCase slerp(from, to, between);
+	timed("quaternion_slerp", a3, slerp, opt, report);
+	RotationMatrixCase rotation(from);
+	timed("quaternion_get_rotation", a3, rotation, opt, report);
+	GenMatrixCase genMatrix(frames, layouts);
+	timed("motion_frame_gen_matrix", a3, genMatrix, opt, report);
+	EulerZYXCase<true> zyxFixed(zyxDegrees);
+	timed("euler_zyx_fixed", a3, zyxFixed, opt, report);
+	EulerZYXCase<false> zyxComposer(zyxDegrees);
+	timed("euler_zyx_composer", a3, zyxComposer, opt, report);
+	EulerBatchCase eulerBatch(jointLayouts, jointDegrees, batchFrames);
+	params.clear();
+	params["joints"] = jointLayouts.size();
+	params["frames"] = batchFrames;
+	timed("euler_batch_to_matrices", a3, eulerBatch, opt, report, params);
+	LocationCase location(skeleton, influences);
+	timed("skeleton_get_location", a3, location, opt, report);
+	DeltaCase tinyDelta(tinyDegrees), smallDelta(smallDegrees);
+	timed("delta", "person-tiny", tinyDelta, opt, report);
+	timed("delta", "person-small", smallDelta, opt, report);
+
+	benchFiles::removeDirectory(work);
+	return report.finish(opt.out, opt.baseline, opt.threshold);
+}
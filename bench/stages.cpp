@@ -0,0 +1,558 @@
+/*
+ * stages.cpp
+ * Times the stages of the pipeline, one after the other, on the a3files and
+ * on bigger inputs made from them: loading the mesh (parsing the .obj, and
+ * from the .objc), parsing the clip (and from the .bvhc), building the
+ * Laplacian, attaching the mesh to the skeleton, solving for the weights,
+ * baking the frames, and the CPU side of drawing frames at 60 Hz (sampling
+ * the pose, the bone lines, gathering the baked positions for the buffers).
+ * Loading, the Laplacian, baking and drawing are timed again with the mesh
+ * reordered for the caches (<stage>_reordered, see MeshReorder.h).
+ *
+ * Everything is done in a temporary directory (the inputs are copied there,
+ * so the compiled files and the logs of the stages don't end up next to the
+ * a3files). The results are written as JSON.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/shared_ptr.hpp>
+
+#include "BenchReport.h"
+#include "AllocProfile.h"
+#include "Animation.h"
+#include "CompiledClip.h"
+#include "CompiledMesh.h"
+#include "FrameScheduler.h"
+#include "Mesh.h"
+#include "MeshReorder.h"
+#include "ObjLoader.h"
+#include "Pose.h"
+#include "Trace.h"
+#include "VertexStream.h"
+
+using namespace std;
+
+struct Options {
+	string data; // where the a3files are
+	string inputs; // comma separated
+	string out; // JSON, stdout if empty
+	string baseline; // JSON of another run to compare with
+	string trace; // Chrome trace of the run, none if empty
+	unsigned warmup, reps;
+	double budget; // seconds per stage
+	double threshold; // percent slower than the baseline that is a regression
+
+	Options() : data("a3files"), inputs("tiny,small,mesh-x4,clip-x8"), warmup(1), reps(5), budget(30), threshold(10) {}
+};
+
+struct Input {
+	string name;
+	string mesh, clip; // in the work directory
+};
+
+// (Mesh and Animation want char*)
+static vector<char> writable(string const& s) {
+	vector<char> buf(s.begin(), s.end());
+	buf.push_back('\0');
+	return buf;
+}
+
+// as the .obj scanner reads it
+static void writeObj(ObjData const& obj, string const& to) {
+	ofstream out(to.c_str());
+	out << fixed << setprecision(6); // the .obj scanner doesn't read exponents
+	for (unsigned i = 0; i < obj.vertices.size(); ++i)
+		out << "v " << obj.vertices[i].x() << " " << obj.vertices[i].y() << " " << obj.vertices[i].z() << "\n";
+	for (unsigned i = 0; i < obj.normals.size(); ++i) {
+		Point const& n = obj.normals[i];
+		// (a normal of length 0 in the file was normalized into nans, which can't be read back)
+		if (n.x() == n.x() && n.y() == n.y() && n.z() == n.z()) out << "vn " << n.x() << " " << n.y() << " " << n.z() << "\n";
+		else out << "vn 0 0 0\n";
+	}
+	for (unsigned f = 0; f < obj.faceVertices.size(); f += 3) {
+		out << "f";
+		for (unsigned i = 0; i < 3; ++i) out << " " << obj.faceVertices[f + i] + 1 << "//" << obj.faceNormals[f + i] + 1;
+		out << "\n";
+	}
+}
+
+/* Writes the mesh of from with every triangle cut into 4 (at the middles
+ * of the edges) into to, times times: 4^times as many triangles.
+ */
+static void subdivideObj(string const& from, string const& to, unsigned times) {
+	ObjData obj;
+	objLoader::load(from, obj);
+	for (unsigned t = 0; t < times; ++t) {
+		map<pair<unsigned, unsigned>, unsigned> vertexMiddles, normalMiddles;
+		vector<unsigned> faceVertices, faceNormals;
+		for (unsigned f = 0; f < obj.faceVertices.size() / 3; ++f) {
+			unsigned v[6], n[6];
+			for (unsigned i = 0; i < 3; ++i) {
+				v[i] = obj.faceVertices[3*f + i];
+				n[i] = obj.faceNormals[3*f + i];
+			}
+			for (unsigned i = 0; i < 3; ++i) {
+				const unsigned j = (i + 1) % 3;
+				pair<unsigned, unsigned> edge(min(v[i], v[j]), max(v[i], v[j]));
+				if (vertexMiddles.find(edge) == vertexMiddles.end()) {
+					vertexMiddles[edge] = obj.vertices.size();
+					obj.vertices.push_back((obj.vertices[v[i]] + obj.vertices[v[j]]) * 0.5f);
+				}
+				v[3 + i] = vertexMiddles[edge];
+				pair<unsigned, unsigned> nEdge(min(n[i], n[j]), max(n[i], n[j]));
+				if (normalMiddles.find(nEdge) == normalMiddles.end()) {
+					normalMiddles[nEdge] = obj.normals.size();
+					Point sum = obj.normals[n[i]] + obj.normals[n[j]];
+					const float length = sum.getLength();
+					obj.normals.push_back(length > 0 ? sum * (1 / length) : obj.normals[n[i]]);
+				}
+				n[3 + i] = normalMiddles[nEdge];
+			}
+			// the corners, then the middle one
+			static const unsigned CUT[4][3] = {{0, 3, 5}, {3, 1, 4}, {5, 4, 2}, {3, 4, 5}};
+			for (unsigned c = 0; c < 4; ++c) {
+				for (unsigned i = 0; i < 3; ++i) {
+					faceVertices.push_back(v[CUT[c][i]]);
+					faceNormals.push_back(n[CUT[c][i]]);
+				}
+			}
+		}
+		obj.faceVertices.swap(faceVertices);
+		obj.faceNormals.swap(faceNormals);
+	}
+	writeObj(obj, to);
+}
+
+/* Writes the mesh of from with its vertices and its triangles in a random
+ * order (always the same one) into to: what a mesh out of a tool that
+ * doesn't care about the order can look like.
+ */
+static void shuffleObj(string const& from, string const& to) {
+	ObjData obj;
+	objLoader::load(from, obj);
+	srand(12345);
+	vector<unsigned> newIndex(obj.vertices.size());
+	for (unsigned v = 0; v < newIndex.size(); ++v) newIndex[v] = v;
+	random_shuffle(newIndex.begin(), newIndex.end());
+	vector<Point> vertices(obj.vertices.size());
+	for (unsigned v = 0; v < newIndex.size(); ++v) vertices[newIndex[v]] = obj.vertices[v];
+	obj.vertices.swap(vertices);
+
+	vector<unsigned> faces(obj.faceVertices.size() / 3);
+	for (unsigned f = 0; f < faces.size(); ++f) faces[f] = f;
+	random_shuffle(faces.begin(), faces.end());
+	vector<unsigned> faceVertices, faceNormals;
+	for (unsigned f = 0; f < faces.size(); ++f) {
+		for (unsigned i = 0; i < 3; ++i) {
+			faceVertices.push_back(newIndex[obj.faceVertices[3 * faces[f] + i]]);
+			faceNormals.push_back(obj.faceNormals[3 * faces[f] + i]);
+		}
+	}
+	obj.faceVertices.swap(faceVertices);
+	obj.faceNormals.swap(faceNormals);
+	writeObj(obj, to);
+}
+
+// writes the clip of from played times times in a row into to
+static void repeatClip(string const& from, string const& to, unsigned times) {
+	ifstream in(from.c_str());
+	stringstream text;
+	text << in.rdbuf();
+	const string s = text.str();
+	const size_t framesAt = s.find("Frames:");
+	const size_t timeAt = s.find("Frame Time:", framesAt);
+	if (framesAt == string::npos || timeAt == string::npos) {
+		cerr << "ERROR: no MOTION section in " << from << endl;
+		exit(1);
+	}
+	const unsigned frames = atoi(s.c_str() + framesAt + strlen("Frames:"));
+	const size_t rowsAt = s.find('\n', timeAt) + 1;
+	string rows = s.substr(rowsAt);
+	if (!rows.empty() && rows[rows.size() - 1] != '\n') rows += '\n';
+
+	ofstream out(to.c_str());
+	out << s.substr(0, framesAt) << "Frames: " << frames * times << "\n" << s.substr(timeAt, rowsAt - timeAt);
+	for (unsigned t = 0; t < times; ++t) out << rows;
+}
+
+// ---- the stages
+
+class LoadMesh : public BenchCase {
+private:
+	string file;
+	bool compiled; // from the .objc (which has to be there), or parsing the .obj
+	bool reorder;
+	boost::shared_ptr<Mesh> mesh;
+public:
+	LoadMesh(string const& file_, bool compiled_, bool reorder_ = false) :
+		file(file_), compiled(compiled_), reorder(reorder_) {}
+	void setUp() { if (!compiled) unlink(CompiledMesh::siblingOf(file).c_str()); }
+	void run() {
+		vector<char> name = writable(file);
+		mesh.reset(new Mesh());
+		mesh->loadModel(&name[0], reorder);
+	}
+	void tearDown() { mesh.reset(); }
+};
+
+class LoadClip : public BenchCase {
+private:
+	string file;
+	bool compiled;
+	boost::shared_ptr<Animation> anim;
+public:
+	LoadClip(string const& file_, bool compiled_) : file(file_), compiled(compiled_) {}
+	void setUp() { if (!compiled) unlink(CompiledClip::siblingOf(file).c_str()); }
+	void run() {
+		vector<char> name = writable(file);
+		anim.reset(new Animation(&name[0]));
+	}
+	void tearDown() { anim.reset(); }
+};
+
+class BuildLaplacian : public BenchCase {
+private:
+	ObjData const& obj;
+	Eigen::SparseMatrix<double> laplacian;
+public:
+	BuildLaplacian(ObjData const& obj_) : obj(obj_) {}
+	void run() {
+		Mesh::buildLaplacian(&obj.faceVertices[0], obj.faceVertices.size() / 3, obj.vertices.size(), laplacian);
+	}
+};
+
+// attaching leaves things behind in the mesh and the animation, so it gets new ones every time
+class Attach : public BenchCase {
+private:
+	Input const& input;
+	boost::shared_ptr<Mesh> model;
+	boost::shared_ptr<Animation> anim;
+public:
+	Attach(Input const& input_) : input(input_) {}
+	void setUp() {
+		vector<char> mesh = writable(input.mesh), clip = writable(input.clip);
+		model.reset(new Mesh());
+		model->loadModel(&mesh[0]);
+		anim.reset(new Animation(&clip[0]));
+	}
+	void run() { anim->attachBones(model); }
+	void tearDown() { anim.reset(); model.reset(); }
+};
+
+class Solve : public BenchCase {
+private:
+	Animation& anim;
+public:
+	Solve(Animation& anim_) : anim(anim_) {}
+	void run() { anim.solveAttachWeights(); }
+};
+
+class Bake : public BenchCase {
+private:
+	Animation& anim;
+public:
+	Bake(Animation& anim_) : anim(anim_) {}
+	void run() { anim.precalculateMesh(); }
+};
+
+/* What the viewer does for a frame besides GL: sample the pose at the time,
+ * the lines of the skeleton, and gather the baked positions of the frame
+ * into the array that goes to the buffer. Each run plays the whole clip,
+ * the time of every frame is kept.
+ */
+class DisplayLoop : public BenchCase {
+private:
+	Animation& anim;
+	Mesh& model;
+	Pose pose;
+	vector<float> ends, positions;
+public:
+	static const unsigned RATE = 60; // Hz
+	vector<double> frameTimes; // ms
+
+	DisplayLoop(Animation& anim_, Mesh& model_) : anim(anim_), model(model_),
+			ends(6 * anim.getBoneLineNum()), positions(model.getStream().positions.size()) {}
+	void run() {
+		VertexStream const& stream = model.getStream();
+		const unsigned baked = model.getFrameNum() - 1;
+		const unsigned frames = (unsigned) (anim.getClipLength() * RATE);
+		for (unsigned i = 0; i < frames; ++i) {
+			const double start = FrameScheduler::now();
+			const double t = (double) i / RATE;
+			anim.samplePoses(&t, 1, pose);
+			if (!ends.empty()) anim.boneLines(pose, 0, &ends[0]);
+			const unsigned f = 1 + min(baked - 1, (unsigned) (t / anim.getStdFrameTime()));
+			if (!positions.empty()) stream.gatherPositions(model.getFrame(f), &positions[0]);
+			frameTimes.push_back((FrameScheduler::now() - start) * 1000);
+		}
+	}
+};
+
+// ----
+
+static BenchResult timed(string const& name, Input const& input, BenchCase& c, Options const& opt,
+		map<string, double> const& params) {
+	cerr << input.name << ": " << name << ".." << endl;
+	BenchResult r;
+	r.name = name;
+	r.input = input.name;
+	r.params = params;
+	QuietCout quiet;
+	r.samples = BenchReport::measure(c, opt.warmup, opt.reps, opt.budget);
+	return r;
+}
+
+/* What a run of c allocates, as <name>_allocs (in allocations, so a
+ * baseline catches new ones), when the allocation profiler is built in.
+ */
+static BenchResult counted(string const& name, Input const& input, BenchCase& c, map<string, double> const& params) {
+	BenchResult r;
+	r.name = name + "_allocs";
+	r.input = input.name;
+	r.unit = "allocs";
+	r.params = params;
+	QuietCout quiet;
+	c.setUp();
+	allocProfile::start();
+	c.run();
+	allocProfile::stop();
+	c.tearDown();
+	const allocProfile::Counts counts = allocProfile::total();
+	r.samples.push_back(counts.allocations);
+	r.params["bytes"] = counts.bytes;
+	r.params["frees"] = counts.frees;
+	return r;
+}
+
+// with the allocation profiler built in, the allocations are counted instead of timing (it slows them down)
+static void stage(BenchReport& report, string const& name, Input const& input, BenchCase& c, Options const& opt,
+		map<string, double> const& params) {
+	if (allocProfile::available()) report.add(counted(name, input, c, params));
+	else report.add(timed(name, input, c, opt, params));
+}
+
+/* The stages that the order of the mesh matters for, with the mesh reordered
+ * (parsing the .obj includes reordering it): <stage>_reordered.
+ */
+static void benchReordered(Input const& input, Options const& opt, BenchReport& report,
+		map<string, double> const& params, ObjData const& obj) {
+	vector<char> meshName = writable(input.mesh), clipName = writable(input.clip);
+	LoadMesh parseMesh(input.mesh, false, true);
+	stage(report, "load_obj_reordered", input, parseMesh, opt, params);
+
+	ObjData reordered = obj;
+	vector<unsigned> originalVertexOf, originalFaceOf;
+	meshReorder::apply(reordered, originalVertexOf, originalFaceOf);
+	BuildLaplacian laplacian(reordered);
+	stage(report, "laplacian_reordered", input, laplacian, opt, params);
+
+	boost::shared_ptr<Mesh> model(new Mesh());
+	boost::shared_ptr<Animation> anim;
+	{
+		QuietCout quiet;
+		model->loadModel(&meshName[0], true);
+		anim.reset(new Animation(&clipName[0]));
+		anim->attachBones(model);
+		anim->solveAttachWeights();
+	}
+	Bake bake(*anim);
+	stage(report, "bake_reordered", input, bake, opt, params);
+	DisplayLoop display(*anim, *model);
+	stage(report, "display_clip_reordered", input, display, opt, params);
+}
+
+static void benchInput(Input const& input, Options const& opt, BenchReport& report) {
+	map<string, double> params;
+	vector<char> meshName = writable(input.mesh), clipName = writable(input.clip);
+
+	// the compiled files, and what the stages are run on
+	boost::shared_ptr<Mesh> model(new Mesh());
+	boost::shared_ptr<Animation> anim;
+	ObjData obj;
+	{
+		QuietCout quiet;
+		model->loadModel(&meshName[0]);
+		anim.reset(new Animation(&clipName[0]));
+		objLoader::load(input.mesh, obj);
+	}
+	params["vertices"] = model->getNumVertices();
+	params["triangles"] = model->getNumFaces();
+	params["bones"] = anim->getBoneNum();
+	params["frames"] = (unsigned) (anim->getClipLength() / anim->getStdFrameTime() + 0.5);
+	// vertex cache misses per triangle (see MeshReorder.h), as the mesh is and reordered
+	{
+		const unsigned cache = meshReorder::DEFAULT_CACHE_SIZE;
+		ObjData reordered = obj;
+		vector<unsigned> originalVertexOf, originalFaceOf;
+		meshReorder::apply(reordered, originalVertexOf, originalFaceOf, cache);
+		params["miss_ratio_before"] = meshReorder::missRatio(obj.faceVertices.empty() ? NULL : &obj.faceVertices[0],
+				obj.faceVertices.size() / 3, obj.vertices.size(), cache);
+		params["miss_ratio_after"] = meshReorder::missRatio(reordered.faceVertices.empty() ? NULL :
+				&reordered.faceVertices[0], reordered.faceVertices.size() / 3, reordered.vertices.size(), cache);
+	}
+
+	LoadMesh parseMesh(input.mesh, false);
+	stage(report, "load_obj", input, parseMesh, opt, params);
+	LoadMesh loadMesh(input.mesh, true);
+	stage(report, "load_objc", input, loadMesh, opt, params);
+	LoadClip parseClip(input.clip, false);
+	stage(report, "parse_bvh", input, parseClip, opt, params);
+	LoadClip loadClip(input.clip, true);
+	stage(report, "load_bvhc", input, loadClip, opt, params);
+	BuildLaplacian laplacian(obj);
+	stage(report, "laplacian", input, laplacian, opt, params);
+	Attach attach(input);
+	stage(report, "attach", input, attach, opt, params);
+
+	{
+		QuietCout quiet;
+		anim->attachBones(model);
+	}
+	Solve solve(*anim);
+	stage(report, "solve", input, solve, opt, params);
+	Bake bake(*anim);
+	stage(report, "bake", input, bake, opt, params);
+
+	DisplayLoop display(*anim, *model);
+	if (allocProfile::available()) {
+		report.add(counted("display_clip", input, display, params));
+	} else {
+		report.add(timed("display_clip", input, display, opt, params));
+		// and per frame, of the timed runs (the warmup ones come first)
+		BenchResult frames = report.getResults().back();
+		const size_t warm = min((size_t) opt.warmup * (size_t) (anim->getClipLength() * DisplayLoop::RATE),
+				display.frameTimes.size());
+		frames.name = "display_frame";
+		frames.samples.assign(display.frameTimes.begin() + warm, display.frameTimes.end());
+		frames.keepSamples = false;
+		report.add(frames);
+	}
+
+	// (after the others: the .objc is the reordered one from here on)
+	benchReordered(input, opt, report, params, obj);
+}
+
+static void usage() {
+	cerr << "bench-stages [--data <dir>] [--inputs tiny,small,mesh-x4,clip-x8] [--warmup <n>] [--reps <n>]" << endl;
+	cerr << "             [--budget <seconds per stage>] [--out <file.json>] [--baseline <file.json> [--threshold <%>]]" << endl;
+	cerr << "             [--trace <file.json>]" << endl;
+	cerr << "Times the stages of the pipeline on the a3files in <dir> (a3files by default) and on bigger" << endl;
+	cerr << "inputs made from them (mesh-x4: person-small with 4 times the triangles, clip-x8: rundive 8 times," << endl;
+	cerr << "and not by default mesh-x4-shuffled: mesh-x4 with its vertices and triangles in a random order)." << endl;
+	cerr << "With a baseline, the stages whose median is more than threshold percent (10) slower are listed" << endl;
+	cerr << "and the exit status is 3. With --trace the stages are timed while tracing (against a baseline" << endl;
+	cerr << "without, that is the overhead of the tracing) and the trace is written into the file." << endl;
+}
+
+int main(int argc, char** argv) {
+	Options opt;
+	for (int i = 1; i < argc; ++i) {
+		string arg(argv[i]);
+		if (arg.compare("--data") == 0 && i+1 < argc) opt.data = argv[++i];
+		else if (arg.compare("--inputs") == 0 && i+1 < argc) opt.inputs = argv[++i];
+		else if (arg.compare("--out") == 0 && i+1 < argc) opt.out = argv[++i];
+		else if (arg.compare("--warmup") == 0 && i+1 < argc) opt.warmup = atoi(argv[++i]);
+		else if (arg.compare("--reps") == 0 && i+1 < argc) opt.reps = atoi(argv[++i]);
+		else if (arg.compare("--budget") == 0 && i+1 < argc) opt.budget = atof(argv[++i]);
+		else if (arg.compare("--baseline") == 0 && i+1 < argc) opt.baseline = argv[++i];
+		else if (arg.compare("--threshold") == 0 && i+1 < argc) opt.threshold = atof(argv[++i]);
+		else if (arg.compare("--trace") == 0 && i+1 < argc) opt.trace = argv[++i];
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (opt.reps == 0) {
+		usage();
+		return 1;
+	}
+
+	const string data = benchFiles::absolute(opt.data);
+	if (data.empty()) {
+		cerr << "ERROR: no directory " << opt.data << endl;
+		return 1;
+	}
+	// (before moving to the work directory; the output doesn't have to be there yet)
+	if (!opt.out.empty() && opt.out[0] != '/') opt.out = benchFiles::absolute(".") + "/" + opt.out;
+	if (!opt.baseline.empty()) opt.baseline = benchFiles::absolute(opt.baseline);
+	if (!opt.trace.empty() && opt.trace[0] != '/') opt.trace = benchFiles::absolute(".") + "/" + opt.trace;
+	const string work = benchFiles::makeWorkDirectory();
+	if (work.empty() || chdir(work.c_str()) != 0) {
+		cerr << "ERROR: could not make a work directory" << endl;
+		return 1;
+	}
+
+	const string tiny = data + "/mesh/person-tiny.obj", small = data + "/mesh/person-small.obj";
+	const string rundive = data + "/motion/rundive.bvh";
+	vector<Input> inputs;
+	stringstream list(opt.inputs);
+	string name;
+	while (getline(list, name, ',')) {
+		Input in;
+		in.name = name;
+		in.mesh = work + "/" + name + ".obj";
+		in.clip = work + "/" + name + ".bvh";
+		bool ok = true;
+		if (name.compare("tiny") == 0) {
+			ok = benchFiles::copyFile(tiny, in.mesh) && benchFiles::copyFile(rundive, in.clip);
+		} else if (name.compare("small") == 0) {
+			ok = benchFiles::copyFile(small, in.mesh) && benchFiles::copyFile(rundive, in.clip);
+		} else if (name.compare("mesh-x4") == 0) {
+			subdivideObj(small, in.mesh, 1);
+			ok = benchFiles::copyFile(rundive, in.clip);
+		} else if (name.compare("mesh-x4-shuffled") == 0) {
+			const string ordered = work + "/" + name + "-ordered.obj";
+			subdivideObj(small, ordered, 1);
+			shuffleObj(ordered, in.mesh);
+			ok = benchFiles::copyFile(rundive, in.clip);
+		} else if (name.compare("clip-x8") == 0) {
+			ok = benchFiles::copyFile(tiny, in.mesh);
+			repeatClip(rundive, in.clip, 8);
+		} else {
+			cerr << "ERROR: unknown input " << name << endl;
+			ok = false;
+		}
+		if (!ok) {
+			benchFiles::removeDirectory(work);
+			return 1;
+		}
+		inputs.push_back(in);
+	}
+
+	BenchReport report("stages");
+	stringstream s;
+	s << opt.warmup << " warmup, " << opt.reps << " reps, " << opt.budget << "s budget";
+	report.setInfo("runs", s.str());
+	report.setInfo("trace", opt.trace.empty() ? "off" : "on");
+	report.setInfo("alloc_profile", allocProfile::available() ? "yes" : "no");
+	if (!opt.trace.empty()) trace::start();
+
+	try {
+		for (unsigned i = 0; i < inputs.size(); ++i) benchInput(inputs[i], opt, report);
+	} catch (ParseException& e) {
+		cerr << e.what() << endl;
+		benchFiles::removeDirectory(work);
+		return 2;
+	}
+	benchFiles::removeDirectory(work);
+	if (!opt.trace.empty() && !trace::write(opt.trace)) {
+		cerr << "ERROR: could not write " << opt.trace << endl;
+		return 1;
+	}
+
+	return report.finish(opt.out, opt.baseline, opt.threshold);
+}
@@ -0,0 +1,309 @@
+/*
+ * AllocProfile.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "AllocProfile.h"
+
+#ifndef ALLOC_PROFILE
+
+bool allocProfile::available() { return false; }
+void allocProfile::start() {}
+void allocProfile::stop() {}
+allocProfile::Counts allocProfile::total() { return Counts(); }
+void allocProfile::print(std::ostream& out, unsigned /*sites*/) {
+	out << "(built without ALLOC_PROFILE, no allocations counted)" << std::endl;
+}
+
+#else
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+// what the replacements below call, glibc's own
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t n, size_t size);
+	void* __libc_realloc(void* p, size_t size);
+	void __libc_free(void* p);
+}
+
+namespace {
+	// the return addresses kept per site: new or malloc is mostly called from
+	// inside the library (std::vector, ...), the callers of that are the interesting ones
+	const unsigned DEPTH = 8;
+
+	// one per stage and call site, the frees of a stage are counted at the site with no frames
+	struct Site {
+		bool used;
+		char const* stage; // the name of the scope (the pointer), NULL outside of all
+		void* frames[DEPTH];
+		unsigned long long allocations, bytes, frees;
+	};
+	const unsigned SITE_NUM = 1 << 14; // a power of 2
+	Site sites[SITE_NUM];
+	Site overflow; // for when the table is full
+	volatile bool counting = false;
+	volatile int lock = 0;
+	__thread bool inside = false; // backtrace may allocate itself
+
+	// not inlined, the frames are counted from it
+	__attribute__((noinline)) void count(size_t bytes, bool isFree) {
+		if (!counting || inside) return;
+		inside = true;
+		void* frames[DEPTH + 2] = {NULL};
+		// without this function and the replacement calling it
+		if (!isFree) backtrace(frames, DEPTH + 2);
+		void** site = frames + 2;
+		char const* stage = trace::current;
+
+		size_t h = (size_t) stage >> 3;
+		for (unsigned i = 0; i < DEPTH; ++i) h = h * 31 + ((size_t) site[i] >> 2);
+		h ^= h >> 15;
+
+		while (__sync_lock_test_and_set(&lock, 1)) {}
+		Site* s = &overflow;
+		for (unsigned probe = 0; probe < 64; ++probe) {
+			Site& t = sites[(h + probe) & (SITE_NUM - 1)];
+			if (!t.used) {
+				t.used = true;
+				t.stage = stage;
+				std::copy(site, site + DEPTH, t.frames);
+				s = &t;
+				break;
+			}
+			if (t.stage == stage && std::equal(site, site + DEPTH, t.frames)) {
+				s = &t;
+				break;
+			}
+		}
+		if (isFree) {
+			s->frees++;
+		} else {
+			s->allocations++;
+			s->bytes += bytes;
+		}
+		__sync_lock_release(&lock);
+		inside = false;
+	}
+
+	// the library's own frames, not what we are looking for
+	bool isLibrary(std::string const& name) {
+		return name.compare(0, 5, "std::") == 0 || name.compare(0, 11, "__gnu_cxx::") == 0
+				|| name.compare(0, 12, "operator new") == 0 || name.compare(0, 7, "Eigen::") == 0
+				|| name.empty();
+	}
+
+	// without the parameters (the lines get long enough)
+	std::string shortName(std::string name) {
+		size_t at = name.find("[abi:cxx11]");
+		if (at != std::string::npos) name.erase(at, 11);
+		at = name.find('(', name.compare(0, 21, "(anonymous namespace)") == 0 ? 21 : 0);
+		return (at == std::string::npos || at == 0) ? name : name.substr(0, at);
+	}
+
+	// a function name (with -rdynamic), or the file and the offset in it for addr2line
+	std::string describe(void* frame) {
+		Dl_info info;
+		char text[64];
+		if (!frame || !dladdr(frame, &info)) return "";
+		if (info.dli_sname) {
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+			std::string name(status == 0 ? demangled : info.dli_sname);
+			free(demangled);
+			return shortName(name);
+		}
+		char const* file = info.dli_fname ? strrchr(info.dli_fname, '/') : NULL;
+		snprintf(text, sizeof(text), "+0x%lx", (unsigned long) ((char*) frame - (char*) info.dli_fbase));
+		return std::string(file ? file + 1 : (info.dli_fname ? info.dli_fname : "?")) + text;
+	}
+
+	// the first frame outside the library (and where in it), or all of them if there are no names
+	std::string whereFrom(Site const& s) {
+		std::string where, first;
+		for (unsigned f = 0; f < DEPTH && where.empty(); ++f) {
+			const std::string name = describe(s.frames[f]);
+			if (f == 0) first = name;
+			if (!isLibrary(name) && name.find('+') == std::string::npos) where = name;
+		}
+		if (where.empty()) {
+			for (unsigned f = 0; f < DEPTH && s.frames[f]; ++f) where += (f ? " < " : "") + describe(s.frames[f]);
+		} else if (where != first) {
+			where += " (in " + first + ")";
+		}
+		return where;
+	}
+
+	typedef std::pair<std::string, allocProfile::Counts> Named;
+
+	struct StageCounts {
+		allocProfile::Counts counts;
+		std::map<std::string, allocProfile::Counts> sites; // sites with the same description are one
+	};
+
+	bool moreAllocations(Named const& a, Named const& b) { return a.second.allocations > b.second.allocations; }
+	bool stageMoreAllocations(std::pair<std::string, StageCounts> const& a, std::pair<std::string, StageCounts> const& b) {
+		return a.second.counts.allocations > b.second.counts.allocations;
+	}
+}
+
+bool allocProfile::available() { return true; }
+
+void allocProfile::start() {
+	counting = false;
+	std::fill((char*) sites, (char*) (sites + SITE_NUM), 0);
+	overflow = Site();
+	// the first backtrace loads what it needs, that's not to be counted
+	void* frames[DEPTH];
+	backtrace(frames, DEPTH);
+	counting = true;
+}
+
+void allocProfile::stop() {
+	counting = false;
+}
+
+allocProfile::Counts allocProfile::total() {
+	Counts c;
+	for (unsigned i = 0; i <= SITE_NUM; ++i) {
+		Site const& s = (i < SITE_NUM) ? sites[i] : overflow;
+		c.allocations += s.allocations;
+		c.bytes += s.bytes;
+		c.frees += s.frees;
+	}
+	return c;
+}
+
+void allocProfile::print(std::ostream& out, unsigned siteNum) {
+	const bool was = counting;
+	counting = false;
+
+	// (stages of the same name from different scopes are one)
+	std::map<std::string, StageCounts> byName;
+	for (unsigned i = 0; i <= SITE_NUM; ++i) {
+		Site const& s = (i < SITE_NUM) ? sites[i] : overflow;
+		if (s.allocations == 0 && s.frees == 0) continue;
+		StageCounts& stage = byName[(i == SITE_NUM) ? "(table full)" : (s.stage ? s.stage : "(no stage)")];
+		stage.counts.allocations += s.allocations;
+		stage.counts.bytes += s.bytes;
+		stage.counts.frees += s.frees;
+		if (s.allocations > 0) {
+			allocProfile::Counts& site = stage.sites[whereFrom(s)];
+			site.allocations += s.allocations;
+			site.bytes += s.bytes;
+		}
+	}
+	std::vector< std::pair<std::string, StageCounts> > stages(byName.begin(), byName.end());
+	std::stable_sort(stages.begin(), stages.end(), stageMoreAllocations);
+
+	const Counts all = total();
+	out << "-- allocations by stage: " << all.allocations << " allocations, " << all.bytes / 1024 << " KB, "
+			<< all.frees << " frees in all" << std::endl;
+	char line[256];
+	for (unsigned i = 0; i < stages.size(); ++i) {
+		StageCounts& stage = stages[i].second;
+		snprintf(line, sizeof(line), "  %-22s %10llu allocations %12.1f KB %10llu frees", stages[i].first.c_str(),
+				stage.counts.allocations, stage.counts.bytes / 1024.0, stage.counts.frees);
+		out << line << std::endl;
+		std::vector<Named> sites(stage.sites.begin(), stage.sites.end());
+		std::stable_sort(sites.begin(), sites.end(), moreAllocations);
+		for (unsigned k = 0; k < std::min((unsigned) sites.size(), siteNum); ++k) {
+			snprintf(line, sizeof(line), "      %10llu %12.1f KB  ", sites[k].second.allocations, sites[k].second.bytes / 1024.0);
+			out << line << sites[k].first << std::endl;
+		}
+	}
+	counting = was;
+}
+
+// ---- the replacements
+
+void* operator new(std::size_t size) throw(std::bad_alloc) {
+	count(size, false);
+	void* p = __libc_malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](std::size_t size) throw(std::bad_alloc) {
+	count(size, false);
+	void* p = __libc_malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) throw() {
+	count(size, false);
+	return __libc_malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) throw() {
+	count(size, false);
+	return __libc_malloc(size ? size : 1);
+}
+
+void operator delete(void* p) throw() {
+	if (!p) return;
+	count(0, true);
+	__libc_free(p);
+}
+
+void operator delete[](void* p) throw() {
+	if (!p) return;
+	count(0, true);
+	__libc_free(p);
+}
+
+void operator delete(void* p, std::nothrow_t const&) throw() {
+	if (!p) return;
+	count(0, true);
+	__libc_free(p);
+}
+
+void operator delete[](void* p, std::nothrow_t const&) throw() {
+	if (!p) return;
+	count(0, true);
+	__libc_free(p);
+}
+
+extern "C" {
+
+void* malloc(size_t size) throw() {
+	count(size, false);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) throw() {
+	count(n * size, false);
+	return __libc_calloc(n, size);
+}
+
+// the old block is freed (if there is one) and a new one allocated (if size isn't 0)
+void* realloc(void* p, size_t size) throw() {
+	if (p) count(0, true);
+	if (size > 0) count(size, false);
+	return __libc_realloc(p, size);
+}
+
+void free(void* p) throw() {
+	if (!p) return;
+	count(0, true);
+	__libc_free(p);
+}
+
+}
+
+#endif
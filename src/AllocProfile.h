@@ -0,0 +1,44 @@
+/*
+ * AllocProfile.h
+ * Counts the heap allocations (operator new and malloc, calloc, realloc) and
+ * the frees, by the stage they happen in (the innermost TRACE_SCOPE of the
+ * thread, see Trace.h) and by call site (where new or malloc was called
+ * from), so it can be seen which allocations are worth getting rid of.
+ *
+ * Opt in: only when built with ALLOC_PROFILE are new, delete and the malloc
+ * family replaced (by ones counting and then calling glibc's). Without it
+ * available() is false and nothing is counted. Nothing is counted before
+ * start() either.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef ALLOCPROFILE_H_
+#define ALLOCPROFILE_H_
+
+#include <iostream>
+
+namespace allocProfile {
+	struct Counts {
+		unsigned long long allocations;
+		unsigned long long bytes; // asked for
+		unsigned long long frees;
+		Counts() : allocations(0), bytes(0), frees(0) {}
+	};
+
+	// false if built without ALLOC_PROFILE
+	bool available();
+	// counts from now on, what was counted before is dropped
+	void start();
+	void stop();
+	// since start, all stages (and outside of them)
+	Counts total();
+	/* A table of the stages, the ones allocating the most first, each with
+	 * its sites top sites. A site is a function name if the program
+	 * exports its symbols (-rdynamic), else file+offset for addr2line.
+	 */
+	void print(std::ostream& out, unsigned sites = 5);
+}
+
+#endif /* ALLOCPROFILE_H_ */
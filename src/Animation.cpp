@@ -9,10 +9,17 @@
  */
 
 #include "Animation.h"
-#include "SkeletonNode.h"
+#include "Skeleton.h"
 #include "tools.h"
 #include "sparseMatrixHelp.h"
 #include "Attachment.h"
+#include "BvhStream.h"
+#include "CompiledClip.h"
+#include "EulerBatch.h"
+#include "QuatBatch.h"
+#include "WeightTransfer.h"
+#include "Trace.h"
+#include "MemoryUse.h"
 
 #ifdef __APPLE__
 #  include <GLUT/glut.h>
@@ -24,11 +31,82 @@
 #include <sstream>
 #include <cmath>
 #include <limits>
+#include <algorithm>
 #include <ctime>
 
-Animation::Animation(char *filename) throw(ParseException) :
-					figureSize(0), selectedBone(0), displayOnMeshType(NONE_M) {
+/* Lets the frames held by the skeleton be handed out like any other FrameSource
+ * (this is what we compile clips from when everything is loaded).
+ */
+class SkeletonFrames : public FrameSource {
+private:
+	Skeleton const& skeleton;
+	unsigned frameNum;
+	unsigned channels;
+public:
+	SkeletonFrames(Skeleton const& skeleton_, unsigned frameNum_) :
+			skeleton(skeleton_), frameNum(frameNum_), channels(skeleton.getChannelNum()) {}
+	virtual unsigned getFrameNum() const { return frameNum; }
+	virtual unsigned getChannelsPerFrame() const { return channels; }
+	virtual void decodeFrames(unsigned first, unsigned count, std::vector<float>& out) const throw(ParseException) {
+		out.clear();
+		out.reserve(count * channels);
+		for (unsigned i = 0; i < count; ++i) {
+			skeleton.appendFrameChannels(out, (first + i) % frameNum);
+		}
+	}
+};
+
+/* If there is an up to date compiled version of the file (file.bvhc) we load
+ * that, otherwise we parse the text and write the compiled version for next time.
+ *
+ * If streaming is true only the hierarchy is read in now. The frames are
+ * then decoded from the file as the animation gets to them, so
+ * clips of any length can be played with the same amount of memory.
+ */
+Animation::Animation(char *filename, bool streaming) throw(ParseException) :
+					windowStart(0), windowSize(0),
+					figureSize(0), selectedBone(0), displayOnMeshType(NONE_M), testFiles(true) {
+	TRACE_SCOPE("load clip");
+
+	this->filename = filename;
+	std::string compiled = CompiledClip::siblingOf(filename);
+	if (CompiledClip::isCompiledName(filename)) {
+		loadCompiled(filename, streaming);
+	} else if (CompiledClip::isFresh(compiled, filename)) {
+		if (debug::ison(debug::LITTLE)) std::cout << "Using compiled clip " << compiled << std::endl;
+		loadCompiled(compiled, streaming);
+	} else {
+		parseText(filename, streaming);
+		if (compileClip(compiled)) {
+			if (debug::ison(debug::LITTLE)) std::cout << "Wrote compiled clip " << compiled << std::endl;
+		} else {
+			std::cerr << "Could not write compiled clip " << compiled << " (continuing without)" << std::endl;
+		}
+	}
+
+	std::cout << "Finished." << std::endl;
+	animating = false;
+
+	stdFPS = floor((1.0 / stdFrameTime) + 0.5);
+	virtFPS = stdFPS;
+
+	curFrameFrac = -1;
+
+	// TODO for testing only: setup attachment vectors to have correct size
+	for (unsigned i = 0; i < skeleton.getJointNum(); ++i) {
+		std::vector<LineSegment> empty;
+		intersectingAtt.push_back(empty);
+		connectedAtt.push_back(empty);
+	}
+}
+
+Animation::~Animation() {
+	// because of shared_ptr the node that root is pointed to gets deleted.
+}
 
+// reads in the .bvh text (or just the hierarchy and a frame index when streaming)
+void Animation::parseText(char *filename, bool streaming) throw(ParseException) {
+	TRACE_SCOPE("parse bvh");
 	std::ifstream infile(filename);
 	// read stuff in
 	std::string word;
@@ -37,9 +115,9 @@ Animation::Animation(char *filename) throw(ParseException) :
 	// now description starts
 	infile >> word;
 	while (word.compare("ROOT") == 0) {
-		roots.push_back(SkeletonNode(infile));
+		skeleton.parseRoot(infile);
 		std::cout << "The tree structure we read in is:" << std::endl;
-		(roots.end()-1)->printNames(0);
+		skeleton.printNames(skeleton.getRoot(skeleton.getRootNum()-1));
 		infile >> word;
 	}
 
@@ -58,48 +136,99 @@ Animation::Animation(char *filename) throw(ParseException) :
 	confirmParse("Time:", word);
 	infile >> stdFrameTime;
 
-	// assume that the animation for the 2 roots are interleaved
-	for (unsigned f = 0; f < frameNum; ++f) {
-		for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-											rootIt != roots.end(); ++rootIt) {
-			rootIt->addAnimationFrame(infile);
+	// a clip without frames has nothing to stream, it's loaded like the others
+	if (streaming && frameNum > 0) {
+		unsigned channels = skeleton.getChannelNum();
+		std::streamoff dataOffset = infile.tellg();
+		infile.close();
+		stream.reset(new BvhStream(filename, (size_t) dataOffset, frameNum, channels));
+		windowSize = std::min(frameNum, 128u);
+		loadWindow(0);
+	} else {
+		// assume that the animation for the 2 roots are interleaved
+		unsigned channels = skeleton.getChannelNum();
+		skeleton.reserveAnimation(frameNum);
+		// read a batch of lines, then convert them all at once
+		std::vector<float> rows;
+		for (unsigned start = 0; start < frameNum; start += 256) {
+			unsigned count = std::min(256u, frameNum - start);
+			rows.resize(count * channels);
+			for (unsigned i = 0; i < rows.size(); ++i) {
+				double v = 0;
+				if (!(infile >> v)) {
+					// what is there instead (nothing if the file ended)
+					infile.clear();
+					word.clear();
+					infile >> word;
+					std::stringstream ss;
+					ss << "frame " << start + i / channels << ": '" << word << "'";
+					throw ParseException("a number", ss.str());
+				}
+				rows[i] = v;
+			}
+			addFrames(rows, count);
 		}
-	}
 
-	// there should be nothing more in the file
-	while (!infile.eof()) {
-		std::getline(infile, word);
-		if (word.begin() != remove_if(word.begin(), word.end(), isspace)) {
-			std::cerr << "Unexpected term '" << word << "' at the end of the bvh file" << std::endl;
+		// there should be nothing more in the file
+		while (infile && !infile.eof()) {
+			std::getline(infile, word);
+			if (word.begin() != remove_if(word.begin(), word.end(), isspace)) {
+				std::cerr << "Unexpected term '" << word << "' at the end of the bvh file" << std::endl;
+			}
 		}
+		infile.close();
 	}
-	infile.close();
+}
 
-	for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-										rootIt != roots.end(); ++rootIt) {
-		rootIt->setWorldOffsetRec(Point());
-	}
+// takes everything from a compiled clip; nothing to parse here
+void Animation::loadCompiled(std::string const& compiledFile, bool streaming) throw(ParseException) {
+	TRACE_SCOPE("load compiled clip");
+	boost::shared_ptr<CompiledClip> clip(new CompiledClip(compiledFile));
 
-	std::cout << "Finished." << std::endl;
-	this->filename = filename;
-	animating = false;
+	skeleton.loadCompiled(*clip);
+	for (unsigned r = 0; r < skeleton.getRootNum(); ++r) {
+		std::cout << "The tree structure we read in is:" << std::endl;
+		skeleton.printNames(skeleton.getRoot(r));
+	}
+	frameNum = clip->getFrameNum();
+	stdFrameTime = clip->getFrameTime();
+
+	if (streaming && frameNum > 0) {
+		stream = clip;
+		windowSize = std::min(frameNum, 128u);
+		loadWindow(0);
+		return;
+	}
 
-	stdFPS = floor((1.0 / stdFrameTime) + 0.5);
-	virtFPS = stdFPS;
+	skeleton.reserveAnimation(frameNum);
+	// converting in batches keeps the temporary small
+	std::vector<float> channels;
+	for (unsigned start = 0; start < frameNum; start += 256) {
+		unsigned count = std::min(256u, frameNum - start);
+		clip->decodeFrames(start, count, channels);
+		addFrames(channels, count);
+	}
+}
 
-	curFrameFrac = -1;
+// hands count decoded frames (all channels of all roots in each row) to the skeleton
+void Animation::addFrames(std::vector<float> const& rows, unsigned count) {
+	if (count == 0) return;
+	skeleton.addAnimationFrames(&rows[0], count, rows.size() / count);
+}
 
-	// TODO for testing only: setup attachment vectors to have correct size
-	for (unsigned i = 0; i < SkeletonNode::getNumberOfNodes(); ++i) {
-		std::vector<LineSegment> empty;
-		intersectingAtt.push_back(empty);
-		connectedAtt.push_back(empty);
+// writes the loaded clip in the compiled format. Returns false if that failed
+bool Animation::compileClip(std::string const& compiledFile, CompiledClip::Encoding enc) const {
+	std::vector<CompiledClip::Joint> joints;
+	std::string names;
+	skeleton.compile(joints, names);
+	std::string source = CompiledClip::isCompiledName(filename) ? "" : filename;
+	if (stream) { // the frames are not all here, but the stream can give them
+		return CompiledClip::write(compiledFile, source, joints, names, stdFrameTime, *stream, enc);
 	}
+	return CompiledClip::write(compiledFile, source, joints, names, stdFrameTime,
+			SkeletonFrames(skeleton, frameNum), enc);
 }
 
-Animation::~Animation() {
-	// because of shared_ptr the node that root is pointed to gets deleted.
-}
 
 // calculates the axis-aligned (roughly) smallest box that will fit the animation
 void Animation::closestFit(float& xMin, float& xMax,
@@ -112,12 +241,14 @@ void Animation::closestFit(float& xMin, float& xMax,
 	xMin = yMin = zMin = -figBoxSize;
 	xMax = yMax = zMax = figBoxSize;
 
-	// initialize the vars
-	for (unsigned f = 0; f < frameNum; ++f) {
-		for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-											rootIt != roots.end(); ++rootIt) {
-			rootIt->closestAnimationFit(xMin, xMax, yMin, yMax, zMin, zMax);
+	// each root looks at all of its frames at once
+	if (stream) {
+		for (unsigned start = 0; start < frameNum; start += windowSize) {
+			loadWindow(start);
+			skeleton.closestAnimationFit(xMin, xMax, yMin, yMax, zMin, zMax);
 		}
+	} else {
+		skeleton.closestAnimationFit(xMin, xMax, yMin, yMax, zMin, zMax);
 	}
 }
 
@@ -126,10 +257,7 @@ float Animation::getFigureSizeBox() {
 		// initial value
 		float mins [] = {0, 0, 0}; // we assume the origin is always in the picture
 		float maxs [] = {0, 0, 0}; // we assume the origin is always in the picture
-		for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-											rootIt != roots.end(); ++rootIt) {
-			rootIt->offsetBounds(mins, maxs);
-		}
+		skeleton.offsetBounds(mins, maxs);
 		float diffs[3];
 		for (unsigned i = 0; i < 3; ++i) diffs[i] = (maxs[i] - mins[i]);
 		figureSize = (*std::max_element(diffs, diffs+3)) / 2;
@@ -144,10 +272,138 @@ void Animation::addToTime(double timeDiff) {
 	timeDiff /= SECtoMSEC; // now timeDiff is in seconds
 
 	// calculate which frame we moved ahead to - depends on virtual fps
-	curFrameFrac += timeDiff * virtFPS;
-	while (curFrameFrac > frameNum) curFrameFrac -= frameNum; // TODO make it >= ?
-	while (curFrameFrac < 0) curFrameFrac += frameNum; // so negative case is also handled
+	// (fmod instead of a loop so big jumps cost the same as small ones)
+	curFrameFrac = fmod(curFrameFrac + timeDiff * virtFPS, (double) frameNum);
+	if (curFrameFrac < 0) curFrameFrac += frameNum; // so negative case is also handled
+
+}
+
+void Animation::samplePoses(double const* times, unsigned count, Pose& pose) const throw(WrongStateException) {
+	std::vector<double> frames(count);
+	for (unsigned i = 0; i < count; ++i) {
+		double frame = fmod(times[i] / stdFrameTime, (double) frameNum);
+		if (frame < 0) frame += frameNum;
+		if (stream) {
+			frame = fmod(frame - windowStart + frameNum, (double) frameNum);
+			// we need the frame after it too
+			if (windowSize < frameNum && frame + 1 >= windowSize)
+				throw WrongStateException("Tried to sample a streamed animation outside of the loaded frames");
+		}
+		frames[i] = frame;
+	}
+	samplePoseFrames(&frames[0], count, pose);
+}
+
+/* Like samplePoses, but the times are already positions in the loaded frames.
+ * The rotations of all joints of all poses are interpolated in one go
+ * (see QuatBatch.h), and then turned into matrices.
+ */
+void Animation::samplePoseFrames(double const* frames, unsigned count, Pose& pose) const {
+	std::vector<unsigned> const& animated = skeleton.getAnimatedJoints();
+	const unsigned joints = animated.size();
+	const unsigned n = joints * count;
+	pose.resize(joints, count);
+	if (n == 0) return;
+
+	// the rotations of the frames before and after, and how far we are between them
+	std::vector<float> work(9 * n);
+	float* before[4];
+	float* after[4];
+	for (unsigned c = 0; c < 4; ++c) {
+		before[c] = &work[c * n];
+		after[c] = &work[(4 + c) * n];
+	}
+	float* t = &work[8 * n];
+
+	for (unsigned p = 0; p < count; ++p) {
+		double intPart;
+		float frac = modf(frames[p], &intPart);
+		for (unsigned j = 0; j < joints; ++j) {
+			const unsigned frames = skeleton.getAnimFrameNum(animated[j]);
+			unsigned cur = ((unsigned) intPart) % frames;
+			unsigned next = (cur + 1 < frames) ? cur + 1 : 0;
+			MotionFrame const& a = skeleton.getFrame(animated[j], cur);
+			MotionFrame const& b = skeleton.getFrame(animated[j], next);
+
+			unsigned i = p * joints + j;
+			float q[4];
+			a.getRotation().getComponents(q);
+			for (unsigned c = 0; c < 4; ++c) before[c][i] = q[c];
+			b.getRotation().getComponents(q);
+			for (unsigned c = 0; c < 4; ++c) after[c][i] = q[c];
+			t[i] = frac;
+			// translations are interpolated linearly
+			for (unsigned c = 0; c < 3; ++c) {
+				pose.pos[c][i] = (1 - frac) * a.getValue(ChannelLayout::XPOS + c) +
+						frac * b.getValue(ChannelLayout::XPOS + c);
+			}
+		}
+	}
+
+	float* rot[4];
+	for (unsigned c = 0; c < 4; ++c) rot[c] = &pose.rot[c][0];
+	float const* pos[3];
+	for (unsigned c = 0; c < 3; ++c) pos[c] = &pose.pos[c][0];
+	quatBatch::interpolate(before, after, t, n, rot);
+	eulerBatch::toMatrices(rot, pos, n, &pose.matrices[0]);
+}
+
+// decodes windowSize frames starting at 'start' into the skeleton (streaming mode only)
+void Animation::loadWindow(unsigned start) {
+	TRACE_SCOPE("load window");
+	std::vector<float> channels;
+	stream->decodeFrames(start, windowSize, channels);
+
+	skeleton.clearAnimation();
+	addFrames(channels, windowSize);
+	windowStart = start % frameNum;
+
+	// the playhead usually goes forward, so get the next window off the disk already
+	stream->readAhead(windowStart + windowSize, windowSize);
+}
+
+/* Makes sure the frame frameFrac is in (and the one after it, for interpolation)
+ * is decoded, and returns where frameFrac is inside the window.
+ * We keep a quarter of the window behind the playhead so scrubbing back is cheap too.
+ */
+double Animation::seekWindow(double frameFrac) {
+	unsigned frame = (unsigned) frameFrac;
+	unsigned rel = (frame + frameNum - windowStart) % frameNum;
+	if (windowSize < frameNum && rel + 1 >= windowSize) {
+		unsigned back = windowSize / 4;
+		loadWindow((frame + frameNum - back) % frameNum);
+		rel = back;
+	}
+	return rel + (frameFrac - frame);
+}
 
+/* Converts the animation to targetFPS frames per second, so everything done per
+ * frame (like baking the mesh) is done only as many times as we need it.
+ * Rotations are slerped, the root translations are interpolated linearly.
+ * Has to be called before the model is set (it would have the old frames baked).
+ */
+void Animation::resample(double targetFPS) throw(WrongStateException) {
+	TRACE_SCOPE("resample");
+	if (stream)
+		throw WrongStateException("A streamed animation does not have its frames loaded, it can't be resampled");
+	if (model)
+		throw WrongStateException("Resample the animation before attaching a model to it");
+	if (targetFPS <= 0 || frameNum == 0) return;
+
+	double newFrameTime = 1.0 / targetFPS;
+	double step = newFrameTime / stdFrameTime; // old frames per new frame
+	unsigned newFrameNum = (unsigned) floor((frameNum - 1) / step + EPS) + 1;
+
+	std::cout << "Resampling " << frameNum << " frames at " << stdFPS << " fps to "
+			<< newFrameNum << " frames at " << targetFPS << " fps.." << std::endl;
+
+	skeleton.resample(step, newFrameNum);
+
+	frameNum = newFrameNum;
+	stdFrameTime = newFrameTime;
+	stdFPS = floor((1.0 / stdFrameTime) + 0.5);
+	virtFPS = stdFPS;
+	curFrameFrac = -1;
 }
 
 // reset to initial pose
@@ -162,10 +418,7 @@ void Animation::outputBVH(std::ostream& out) {
 	out.precision(5);
 	// first output the tree
 	out << "HIERARCHY" << std::endl;
-	for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-										rootIt != roots.end(); ++rootIt) {
-		rootIt->printTreeBVH(out, 0);
-	}
+	skeleton.printTreeBVH(out);
 
 	// now output the animation code
 	out.precision(7);
@@ -173,51 +426,97 @@ void Animation::outputBVH(std::ostream& out) {
 	out << "Frames: " << frameNum << std::endl;
 	out << "Frame Time: " << stdFrameTime << std::endl;
 	out.precision(4);
-	for (unsigned f = 0; f < frameNum; ++f) {
-		for (std::vector<SkeletonNode>::iterator rootIt = roots.begin();
-											rootIt != roots.end(); ++rootIt) {
-			rootIt->printFrameBVH(out, f);
+	if (stream) {
+		for (unsigned start = 0; start < frameNum; start += windowSize) {
+			loadWindow(start);
+			for (unsigned f = 0; f < windowSize && start + f < frameNum; ++f) {
+				skeleton.printFrameBVH(out, f);
+				out << std::endl;
+			}
 		}
+		return;
+	}
+	for (unsigned f = 0; f < frameNum; ++f) {
+		skeleton.printFrameBVH(out, f);
 		out << std::endl;
 	}
 }
 
 // return true if succeeded
 bool Animation::tryLoadingAttached() {
+	if (!testFiles) return false;
+	return readAttachWeights("W.out", *model, attachWeight);
+}
 
-	std::ifstream myfile ("W.out");
+bool Animation::readAttachWeights(std::string const& file, Mesh const& mesh, Eigen::MatrixXd& weights) const {
+
+	std::ifstream myfile (file.c_str());
 	if (!myfile.is_open()) return false;
 
 	unsigned verNum = 0;
-	unsigned totBones = SkeletonNode::getNumberOfNodes();
-	unsigned totVers = model->getNumVertices();
+	unsigned totBones = skeleton.getJointNum();
+	unsigned totVers = mesh.getNumVertices();
 	float data;
-	attachWeight.resize(totVers, totBones);
+	weights.resize(totVers, totBones);
 //	while ( myfile.good() )
 	for (unsigned vn = 0; vn < totVers; ++vn)
 	{
-		myfile >> verNum;
-		assert(verNum == vn);
+		myfile >> verNum; // numbered as in the .obj
+		if (!myfile || verNum != vn) return false;
+		const unsigned row = mesh.getIndexOfOriginal(verNum);
 		for (unsigned bn = 0; bn < totBones; ++bn) {
 			myfile >> data;
-			attachWeight(verNum, bn) = data;
+			weights(row, bn) = data;
 		}
 	}
 	myfile.close();
 
-	return true;
+	return (bool) myfile;
+}
+
+/* The weights come from the closest points of the source surface. The
+ * connection matrices only get the strongest bone of each vertex (for showing
+ * them on the mesh), and there are no importances.
+ */
+void Animation::setModelFrom(boost::shared_ptr<Mesh> const & m, Mesh const& source,
+		Eigen::MatrixXd const& sourceWeights, unsigned smoothing, bool bake) {
+	TRACE_SCOPE("transfer weights");
+	model = m;
+	const unsigned verts = model->getNumVertices();
+	importances.setZero(verts);
+
+	std::cout << "Transferring the weights of " << source.getNumVertices() << " vertices to "
+			<< verts << ".." << std::endl;
+	double start = FrameScheduler::now();
+	weightTransfer::transfer(source.getTriangleRecords(), source.getFaceVertices(), source.getNumFaces(),
+			sourceWeights, model->getOrigVertices(), attachWeight);
+	if (smoothing > 0) weightTransfer::smooth(model->getLaplacian(), attachWeight, smoothing);
+	std::cout << "Done in " << FrameScheduler::now() - start << "s" << std::endl;
+
+	typedef Eigen::Triplet<double> Tr;
+	std::vector<Tr> strongest;
+	strongest.reserve(verts);
+	for (unsigned v = 0; v < verts; ++v) {
+		int bone;
+		if (attachWeight.row(v).maxCoeff(&bone) > 0) strongest.push_back(Tr(v, bone, 1.0));
+	}
+	simpleConMat.resize(verts, skeleton.getJointNum());
+	simpleConMat.setFromTriplets(strongest.begin(), strongest.end());
+	visConMat = simpleConMat;
+
+	if (bake) precalculateMesh();
 }
 
 /** calculates an attachment to the bones of the specified model.
  * Note: here we assume there's one root only.
  */
 void Animation::attachBonesToMesh() {
+	TRACE_SCOPE("attach");
 
 	// TODO only for testing..?
 //	if (tryLoadingAttached()) return;
 
 	std::cout << "Starting to attach bones.." << std::endl;
-	time_t start,end;
 
 	typedef Eigen::Triplet<double> Tr;
 	std::vector<Tr> simpleTripletList;
@@ -226,9 +525,9 @@ void Animation::attachBonesToMesh() {
 	simpleTripletList.reserve(numVert*2);
 	visibleTripletList.reserve(numVert*2);
 
-	simpleConMat.resize(numVert, SkeletonNode::getNumberOfNodes());
+	simpleConMat.resize(numVert, skeleton.getJointNum());
 	simpleConMat.reserve(simpleTripletList.size()*1.5);
-	visConMat.resize(numVert, SkeletonNode::getNumberOfNodes());
+	visConMat.resize(numVert, skeleton.getJointNum());
 	visConMat.reserve(visibleTripletList.size()*1.5);
 
 
@@ -240,13 +539,17 @@ void Animation::attachBonesToMesh() {
 	unsigned vNum = 0;
 
 	// TODO these are just for testing
-	std::ofstream logfile("attachments.log");
-	std::ofstream sdistsfile("Sdists.log");
+	std::ofstream logfile;
+	std::ofstream sdistsfile;
+	if (testFiles) {
+		logfile.open("attachments.log");
+		sdistsfile.open("Sdists.log");
+	}
 
-	time (&start);
+	double start = FrameScheduler::now();
 	std::set<Attachment> attachments; // could reserve size too..
-	std::vector<SkeletonNode> closests;
-	std::vector<SkeletonNode> closestsVis;
+	std::vector<int> closests; // bone numbers
+	std::vector<int> closestsVis;
 	while (vertex = model->getOrigVertex(vNum), vertex != NULL	) {
 		if (vNum % 100 == 0 && debug::ison(debug::LITTLE)) {
 			std::cout << vNum << " ";
@@ -256,18 +559,20 @@ void Animation::attachBonesToMesh() {
 		attachments.clear();
 		if (debug::ison(debug::EVERYTHING))
 			std::cout << "+ Studying point " << vNum << " that is " << *vertex << std::endl;
-		roots[0].getClosestBones(Point(*vertex), attachments);
+		skeleton.getClosestBones(skeleton.getRoot(0), Point(*vertex), attachments);
 
-		if (attachments.size()+1 != SkeletonNode::getNumberOfNodes()) {
-			std::cout << "attachments != bones: " << attachments.size() << ", " << SkeletonNode::getNumberOfNodes() << std::endl;
+		if (attachments.size()+1 != skeleton.getJointNum()) {
+			std::cout << "attachments != bones: " << attachments.size() << ", " << skeleton.getJointNum() << std::endl;
 			assert(false);
 		}
 
 		// TODO testing
-		logfile << "---- Vertex " << vNum << ": " << *vertex << " ----" << std::endl;
-		for (std::set<Attachment>::const_iterator setIt = attachments.begin();
-				setIt != attachments.end(); ++setIt) {
-			logfile << *setIt << std::endl;
+		if (testFiles) {
+			logfile << "---- Vertex " << model->getOriginalIndex(vNum) << ": " << *vertex << " ----" << std::endl;
+			for (std::set<Attachment>::const_iterator setIt = attachments.begin();
+					setIt != attachments.end(); ++setIt) {
+				logfile << *setIt << std::endl;
+			}
 		}
 
 		// now find the list of closest attachments (attachments is ordered so easy)
@@ -276,13 +581,13 @@ void Animation::attachBonesToMesh() {
 		for (std::set<Attachment>::const_iterator setIt = attachments.begin();
 				setIt != attachments.end(); ++setIt) {
 			if (setIt->getDistance() > minSimpleDist+EPS) break; // no other can be good
-			closests.push_back(setIt->getEndJoint());
+			closests.push_back(setIt->getBoneNum());
 		}
-		for (std::vector<SkeletonNode>::const_iterator it = closests.begin(); it != closests.end(); ++it) {
-			simpleTripletList.push_back(Tr(vNum, it->getUpperBoneNum(), 1.0/double(closests.size()) ));
+		for (std::vector<int>::const_iterator it = closests.begin(); it != closests.end(); ++it) {
+			simpleTripletList.push_back(Tr(vNum, *it, 1.0/double(closests.size()) ));
 		}
 
-		sdistsfile << vNum << " " << minSimpleDist << std::endl;
+		if (testFiles) sdistsfile << model->getOriginalIndex(vNum) << " " << minSimpleDist << std::endl;
 
 		// now find the list of closest VISIBLE attachments (attachments is ordered so easy)
 		closestsVis.clear();
@@ -290,7 +595,7 @@ void Animation::attachBonesToMesh() {
 		bool distSet = false;
 		for (std::set<Attachment>::const_iterator setIt = attachments.begin();
 				setIt != attachments.end(); ++setIt) {
-			unsigned boneNum = setIt->getEndJoint().getUpperBoneNum();
+			unsigned boneNum = setIt->getBoneNum();
 
 			LineSegment attachLine(setIt->getAttachPoint(), *vertex);
 			if (model->intersects(attachLine)) {
@@ -304,30 +609,28 @@ void Animation::attachBonesToMesh() {
 				minVisDist = setIt->getDistance();
 			}
 			connectedAtt[boneNum].push_back(attachLine); // TODO TESTING
-			closestsVis.push_back(setIt->getEndJoint());
+			closestsVis.push_back(setIt->getBoneNum());
 		}
 		if (closestsVis.size() != 0) {
 			importances(vNum, 0) = 1.0 / sqr(minVisDist);
 		} else {
 			importances(vNum, 0) = 0;
 		}
-		for (std::vector<SkeletonNode>::const_iterator it = closestsVis.begin(); it != closestsVis.end(); ++it) {
-			visibleTripletList.push_back(Tr(vNum, it->getUpperBoneNum(), 1.0/double(closestsVis.size()) ));
+		for (std::vector<int>::const_iterator it = closestsVis.begin(); it != closestsVis.end(); ++it) {
+			visibleTripletList.push_back(Tr(vNum, *it, 1.0/double(closestsVis.size()) ));
 		}
 
 		vNum++;
 	}
 	if (debug::ison(debug::LITTLE)) std::cout << std::endl;
-	time (&end);
-
 	logfile.close();
 	sdistsfile.close();
-	std::cout << "Simple and visible attachment matrices created in " << difftime(end,start) << "s" << std::endl;
+	std::cout << "Simple and visible attachment matrices created in " << FrameScheduler::now() - start << "s" << std::endl;
 
 //	if (debug::ison(debug::EVERYTHING)) {
 //		std::cout << "num of triplets: " << simpleTripletList.size() << std::endl;
 //		for (std::vector<Tr>::const_iterator it = simpleTripletList.begin(); it != simpleTripletList.end(); it++) {
-//			if (it->row() >= numVert || it->col() >= SkeletonNode::getNumberOfNodes()) {
+//			if (it->row() >= numVert || it->col() >= skeleton.getJointNum()) {
 //				std::cerr << "issue with: " << it->row() << ", " << it->col() << std::endl;
 //			}
 //		}
@@ -335,15 +638,14 @@ void Animation::attachBonesToMesh() {
 
 	simpleConMat.setFromTriplets(simpleTripletList.begin(), simpleTripletList.end());
 	visConMat.setFromTriplets(visibleTripletList.begin(), visibleTripletList.end());
-
-	findFinalAttachmentWeights(&simpleConMat);
 }
 
 void Animation::findFinalAttachmentWeights(Eigen::SparseMatrix<double>* connMatrixToUse) {
+	TRACE_SCOPE("solve weights");
 	// we do it for each column separately
 	std::cout << "Calculating W.." << std::endl;
 	int verts = model->getNumVertices();
-	int bones = SkeletonNode::getNumberOfNodes();
+	int bones = skeleton.getJointNum();
 	attachWeight.resize(verts, bones);
 
 	typedef Eigen::SparseMatrix<double> SpMat;
@@ -380,29 +682,41 @@ void Animation::findFinalAttachmentWeights(Eigen::SparseMatrix<double>* connMatr
 
 void Animation::updateMeshSelected() {
 	if (model) {
-		boost::shared_ptr< std::set<unsigned> > sel( new std::set<unsigned> );
-		// want all the i's st (i, selectedBone) is nonzero in simpleConMat
-		Eigen::SparseMatrix<double>* matToUse;
+		// only done when the bone or what is shown changes, display just uses the colours
+		std::vector<float> highlight;
+		Eigen::SparseMatrix<double>* matToUse = NULL;
 		switch (displayOnMeshType) {
-		case NONE_M: model->setSelectedVerts(sel); return; // empty
+		case NONE_M: model->setHighlight(highlight); return; // empty
 		case SIMPLE_M: matToUse = &simpleConMat; break;
 		case VISIBLE_M: matToUse = &visConMat; break;
+		case WEIGHTS_M: break;
 		default: throw(0);
 		}
+		highlight.assign(model->getNumVertices(), 0.0f);
 
-		// not fast way:
-		for (int row = 0; row < matToUse->rows(); ++row) {
-			if (matToUse->coeff(row, selectedBone) != 0) sel->insert((unsigned) row);
+		if (matToUse) {
+			// the i's st (i, selectedBone) is nonzero, straight from the column
+			if (selectedBone < matToUse->cols()) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(*matToUse, selectedBone); it; ++it) {
+					if (it.value() != 0) highlight[it.row()] = 1.0f;
+				}
+			}
+		} else if (selectedBone < attachWeight.cols() && attachWeight.rows() == (int) highlight.size()) {
+			for (unsigned v = 0; v < highlight.size(); ++v) {
+				highlight[v] = std::min(1.0f, std::max(0.0f, (float) attachWeight(v, selectedBone)));
+			}
 		}
 
 		if (debug::ison(debug::EVERYTHING)) {
-			std::cout << sel->size() << " vertices attached to current bone. These are" << std::endl;
-			for (std::set<unsigned>::const_iterator it = sel->begin();
-													it != sel->end(); ++it) {
-				std::cout << "\t" << *it << ": " << *(model->getOrigVertex(*it)) << std::endl;
+			std::cout << "Vertices attached to current bone. These are" << std::endl;
+			for (unsigned v = 0; v < highlight.size(); ++v) {
+				if (highlight[v] == 0) continue;
+				std::cout << "\t" << model->getOriginalIndex(v) << ": " << *(model->getOrigVertex(v));
+				if (!matToUse) std::cout << " (" << highlight[v] << ")";
+				std::cout << std::endl;
 			}
 		}
-		model->setSelectedVerts(sel);
+		model->setHighlight(highlight);
 	}
 }
 
@@ -410,13 +724,15 @@ void Animation::printAttachedMatrix(std::ostream& out, AttachMatrix mType) const
 	if (!model)
 		throw WrongStateException("Tried to print the attached matrix before setting a model for the skeleton");
 
-	for (unsigned v = 0; v < model->getNumVertices(); ++v) {
+	// the rows are numbered as the vertices of the .obj
+	for (unsigned o = 0; o < model->getNumVertices(); ++o) {
+		const unsigned v = model->getIndexOfOriginal(o);
 		switch (mType) {
 		case SIMPLE_M:
-			printSparseRow(out, simpleConMat, v);
+			printSparseRow(out, simpleConMat, v, o);
 			break;
 		case VISIBLE_M:
-			printSparseRow(out, visConMat, v);
+			printSparseRow(out, visConMat, v, o);
 			break;
 		default:
 			throw 0;
@@ -428,8 +744,9 @@ void Animation::printFinalAttachMatrix(std::ostream& out) const throw(WrongState
 	if (!model)
 		throw WrongStateException("Tried to print the attached matrix before setting a model for the skeleton");
 //	out << attachWeight;
-	for (int i = 0; i < attachWeight.rows(); ++i) {
-		out << i;
+	for (int o = 0; o < attachWeight.rows(); ++o) {
+		const int i = model->getIndexOfOriginal(o);
+		out << o;
 		for (int j = 0; j < attachWeight.cols(); ++j) {
 			out << " " << attachWeight(i,j);
 		}
@@ -441,56 +758,48 @@ void Animation::printImportances(std::ostream& out) const throw(WrongStateExcept
 	if (!model)
 		throw WrongStateException("Tried to print the attached matrix before setting a model for the skeleton");
 
-	for (int i = 0; i < importances.rows(); ++i) {
-		out << i << " " << importances(i, 0);
+	for (int o = 0; o < importances.rows(); ++o) {
+		out << o << " " << importances(model->getIndexOfOriginal(o), 0);
 		out << std::endl; //for some reason eclipse does not like it in the previous row
 	}
 }
 
-void Animation::precalculateMesh() {
-	std::cout << "Pre-calculating mesh animation.." << std::endl;
-	flush(std::cout);
-
-	const std::vector<Point> oPoints = model->getOrigVertices();
-	std::vector<Point> newPoints;
-	newPoints.reserve(oPoints.size());
+bool Animation::precalculateMesh() {
+	TRACE_SCOPE("bake");
 	const unsigned bones = attachWeight.cols();
-	if (bones != SkeletonNode::getNumberOfNodes()) {
-		std::cout << "bones vs nodeNum = " << bones << " vs " << SkeletonNode::getNumberOfNodes() << std::endl;
+	if (bones != skeleton.getJointNum()) {
+		std::cout << "bones vs nodeNum = " << bones << " vs " << skeleton.getJointNum() << std::endl;
 		assert(false);
 	}
 
+	if (stream) {
+		// baking would need every frame in memory, so frames are skinned when displayed
+		std::cout << "Streaming animation: mesh frames are calculated on demand." << std::endl;
+		return true;
+	}
+
+	std::cout << "Pre-calculating mesh animation.." << std::endl;
+	flush(std::cout);
+	model->clearFrames();
+
+	std::vector<Point> newPoints;
 	std::vector<Point> newNormals; // fake one
-	Eigen::Vector4f oldLoc;
 
 	std::ofstream precalcMeshFile("meshMotion.out");
 	// for each frame
 	std::cout << "Frames=" << frameNum << ":";
 	for (unsigned f = 0; f < frameNum; ++f) {
+		TRACE_SCOPE("bake frame");
 		if (f % 20 == 0) {
 			std::cout << " " << f; // << ":vertex[";
 			flush(std::cout);
 		}
 
-		precalcMeshFile << "---- Frame " << f << ":";
+		skinFrame(f, newPoints);
 
-		//for each original point
-		// TODO should we handle normals.. seems fine.
-		newPoints.clear();
-		for (unsigned vNum = 0; vNum < oPoints.size(); ++vNum) {
-			Point newPoint(0,0,0);
-
-			// combination of attached matrices
-			for (unsigned cBone = 0; cBone < bones; ++cBone) {
-				if (attachWeight(vNum, cBone) > EPS) {
-					oldLoc = getVectorFormPoint(oPoints[vNum]);
-					roots[0].getLocationRec(oldLoc, (int) cBone, f);
-					newPoint += Point(oldLoc(0), oldLoc(1), oldLoc(2)) * attachWeight(vNum, cBone);
-				}
-			}
-
-			newPoints.push_back(newPoint);
-			precalcMeshFile << "  " << newPoint;
+		precalcMeshFile << "---- Frame " << f << ":";
+		for (unsigned o = 0; o < newPoints.size(); ++o) {
+			precalcMeshFile << "  " << newPoints[model->getIndexOfOriginal(o)];
 		}
 		precalcMeshFile << std::endl;
 		model->addFrame(newPoints, newNormals);
@@ -499,34 +808,75 @@ void Animation::precalculateMesh() {
 	precalcMeshFile.close();
 
 	std::cout << "Done" << std::endl;
+	return (bool) precalcMeshFile;
+}
+
+// puts the vertices of the mesh as they are in frame 'frame' into newPoints
+// (frame indexes the frames the skeleton has, which is a window in streaming mode)
+void Animation::skinFrame(unsigned frame, std::vector<Point>& newPoints) const {
+	const std::vector<Point>& oPoints = model->getOrigVertices();
+	const unsigned bones = attachWeight.cols();
+	Eigen::Vector4f oldLoc;
+
+	//for each original point
+	// TODO should we handle normals.. seems fine.
+	newPoints.clear();
+	newPoints.reserve(oPoints.size());
+	for (unsigned vNum = 0; vNum < oPoints.size(); ++vNum) {
+		Point newPoint(0,0,0);
+
+		// combination of attached matrices
+		for (unsigned cBone = 0; cBone < bones; ++cBone) {
+			if (attachWeight(vNum, cBone) > EPS) {
+				oldLoc = getVectorFormPoint(oPoints[vNum]);
+				skeleton.getLocation(skeleton.getRoot(0), oldLoc, (int) cBone, frame);
+				newPoint += Point(oldLoc(0), oldLoc(1), oldLoc(2)) * attachWeight(vNum, cBone);
+			}
+		}
+
+		newPoints.push_back(newPoint);
+	}
 }
 
 
 // displays the current frame (that has been already calculated from curTime)
 // selectedbone is going to be drawn with red
 void Animation::display(bool showSelBone) {
+	TRACE_SCOPE("display animation");
 
     glLineWidth(WIDTH);
 
-	long curTime = glutGet(GLUT_ELAPSED_TIME);
+	const double curTime = FrameScheduler::now();
 	if (animating) {
-		addToTime( curTime - timeOfPreviousCall ); // automatically converted to double
+		addToTime( (curTime - timeOfPreviousCall) * 1000 ); // in ms
 	}
 	timeOfPreviousCall = curTime;
 
 	int frame = int(curFrameFrac); // should be ok .. handles -1 and positive values?
 	if (debug::ison(debug::EVERYTHING)) std::cout << "Drawing Frame " << curFrameFrac << "->" << frame << std::endl;
 
+	// in streaming mode the skeleton only has the frames of the window
+	double skelFrame = curFrameFrac;
+	if (stream && frame >= 0) {
+		skelFrame = seekWindow(curFrameFrac);
+		skinFrame((unsigned) skelFrame, livePoints);
+		model->setLiveFrame(livePoints);
+		frame = 0;
+	}
+
 	// handles its own color and width etc
 	model->display(frame);
 
 	if (debug::ison(debug::DETAILED)) {
 		// right now don't display skeleton by default
-		glColor3f(1.0, 1.0, 0.1); // make it yellow and thick
+		static const float yellow[3] = {1.0, 1.0, 0.1}; // make it yellow and thick
 	    glLineWidth(3);
-		for (unsigned i = 0; i < roots.size(); ++i) {
-			roots[i].display(curFrameFrac, selectedBone); // TODO perhaps swtich to frame here too??
+		float const* poseMatrices = NULL;
+		if (skelFrame >= 0) {
+			samplePoseFrames(&skelFrame, 1, skelPose);
+			poseMatrices = skelPose.getMatrices(0);
 		}
+		skeleton.display(poseMatrices, selectedBone, yellow);
 	}
 
 	if (debug::ison(debug::EVERYTHING)) {
@@ -551,4 +901,11 @@ void Animation::display(bool showSelBone) {
 
 }
 
-
+void Animation::reportMemory(MemoryUse& use) const {
+	skeleton.reportMemory(use);
+	use.add("attach weights", MemoryUse::bytesOf(attachWeight));
+	use.add("connection matrices", MemoryUse::bytesOf(simpleConMat) + MemoryUse::bytesOf(visConMat)
+			+ MemoryUse::bytesOf(importances));
+	use.add("debug attachments", MemoryUse::bytesOf(intersectingAtt) + MemoryUse::bytesOf(connectedAtt));
+	use.add("animation", MemoryUse::bytesOf(skelPose) + MemoryUse::bytesOf(livePoints));
+}
@@ -14,22 +14,27 @@
 #include <Eigen/Sparse>
 #include <Eigen/Dense>
 
-#include "SkeletonNode.h"
+#include "Skeleton.h"
 #include "Mesh.h"
 #include "myexceptions.h"
+#include "CompiledClip.h"
+#include "Pose.h"
+#include "FrameScheduler.h"
 
 class LineSegment;
+class FrameSource;
+class MemoryUse;
 
 class Animation {
 public:
-	enum AttachMatrix {NONE_M, SIMPLE_M, VISIBLE_M};
-	// TODO allow the attachWeights to be displayed as well, and make stuff as red as high the weight is
+	// WEIGHTS_M shows the final weights of the bone, as red as high the weight is
+	enum AttachMatrix {NONE_M, SIMPLE_M, VISIBLE_M, WEIGHTS_M};
 
 private:
 	static const float WIDTH = 5;
 
 	std::string filename;
-	std::vector<SkeletonNode> roots;
+	Skeleton skeleton;
 
 	// these next 2 should NOT change!
 	unsigned frameNum;
@@ -41,7 +46,16 @@ private:
 	double stdFPS;
 	double virtFPS;
 
-	long timeOfPreviousCall;
+	double timeOfPreviousCall; // seconds, FrameScheduler::now
+
+	// streaming mode: only windowSize frames starting at windowStart are
+	// decoded (into the skeleton), the rest stays in the file
+	boost::shared_ptr<FrameSource> stream;
+	unsigned windowStart;
+	unsigned windowSize;
+	std::vector<Point> livePoints; // mesh of the current frame (not baked in this mode)
+
+	Pose skelPose; // what the skeleton is drawn in
 
 	float figureSize;
 
@@ -60,13 +74,18 @@ private:
 	// TODO for testing
 	std::vector< std::vector<LineSegment> > intersectingAtt;
 	std::vector< std::vector<LineSegment> > connectedAtt;
+	// attachments.log and Sdists.log, and W.out of the current directory as a cache of the weights
+	bool testFiles;
 
 public:
 
-	Animation(char *filename) throw(ParseException);
+	Animation(char *filename, bool streaming = false) throw(ParseException);
 	virtual ~Animation();
 
 	std::string getFileName() {return filename;}
+	bool isStreaming() const { return stream.get() != NULL; }
+	// off: none of the testing files are read or written (the batch mode)
+	void setTestFiles(bool on) { testFiles = on; }
 	double getStdFrameTime() {return stdFrameTime;}
 	float getVirtualFPS() { return virtFPS; }
 	void display(bool showSelBone = false);
@@ -78,41 +97,86 @@ public:
 			// if we are in the inital state get out of it artificially first!
 			curFrameFrac = 0;
 		}
-		timeOfPreviousCall = glutGet(GLUT_ELAPSED_TIME);
+		timeOfPreviousCall = FrameScheduler::now();
 //		lastTime = boost::posix_time::microsec_clock::universal_time();
 	}
 	void stopAnim() {animating = false;}
+	bool isAnimating() const { return animating; }
 	void reset();
 	void addFPS(double diff) {virtFPS += diff;}
 
+	/* Samples the clip at count times (in seconds, any value, the clip loops)
+	 * into pose, one pose after the other, e.g. for a crowd playing this clip.
+	 * When streaming, the times have to be in the loaded window.
+	 */
+	void samplePoses(double const* times, unsigned count, Pose& pose) const throw(WrongStateException);
+	unsigned getPoseJointNum() const { return skeleton.getAnimatedJoints().size(); }
+	// a 3x4 matrix per bone (column of getAttachWeights) for pose p, see Skeleton::skinningMatrices
+	void skinningMatrices(Pose const& pose, unsigned p, float* out, float* scratch) const {
+		skeleton.skinningMatrices(pose.getMatrices(p), out, scratch);
+	}
+	unsigned getBoneNum() const { return skeleton.getJointNum(); }
+	Skeleton const& getSkeleton() const { return skeleton; }
+	// the bones of pose p as lines, see Skeleton::boneLines
+	unsigned getBoneLineNum() const { return skeleton.getBoneLineNum(); }
+	void boneLines(Pose const& pose, unsigned p, float* ends) const { skeleton.boneLines(pose.getMatrices(p), ends); }
+	double getClipLength() const { return frameNum * stdFrameTime; } // seconds
+	void resample(double targetFPS) throw(WrongStateException);
 	void outputBVH(std::ostream&);
+	bool compileClip(std::string const& compiledFile,
+			CompiledClip::Encoding enc = CompiledClip::FLOAT32) const;
 	void closestFit(float&, float&, float&, float&, float&, float&);
 	float getFigureSizeBox();
 
-	void printBoneStruct(std::ostream& out) const { roots[0].getBoneSubTree(out); }
+	void printBoneStruct(std::ostream& out) const { skeleton.getBoneSubTree(out, skeleton.getRoot(0)); }
 	void getBoneDescr(std::ostream& out, int boneNum) const {
-		roots[0].getBoneDescr(out, boneNum);
+		skeleton.getBoneDescr(out, skeleton.getRoot(0), boneNum);
 	}
 
-	void setModel(boost::shared_ptr<Mesh> const & m) {
+	// without bake the frames of the mesh are not calculated (e.g. for a Crowd, which skins its own)
+	void setModel(boost::shared_ptr<Mesh> const & m, bool bake = true) {
+		attachBones(m);
+		solveAttachWeights();
+		if (bake) precalculateMesh();
+	}
+	/* The steps of setModel, e.g. to time them on their own: the connection
+	 * matrices (the closest and the closest visible bones of each vertex),
+	 * then the weights from those.
+	 */
+	void attachBones(boost::shared_ptr<Mesh> const & m) {
 		model = m;
 		importances.resize(model->getNumVertices()); // this does not look like a good place for this..
 		attachBonesToMesh();
-		precalculateMesh();
 	}
+	void solveAttachWeights() { findFinalAttachmentWeights(&simpleConMat); }
+	// skins every frame into the model (and meshMotion.out), what setModel does with bake; frames baked before are dropped
+	// false if meshMotion.out could not be written (the frames are baked anyway)
+	bool precalculateMesh();
+	/* Like setModel, but the weights are taken from another version of the
+	 * mesh (source, with sourceWeights, e.g. read with readAttachWeights)
+	 * instead of being solved for. smoothing is how many smoothing steps are
+	 * done on the new mesh afterwards.
+	 */
+	void setModelFrom(boost::shared_ptr<Mesh> const & m, Mesh const& source,
+			Eigen::MatrixXd const& sourceWeights, unsigned smoothing = 2, bool bake = true);
+	Eigen::MatrixXd const& getAttachWeights() const { return attachWeight; }
+	// reads a W.out written for mesh into weights, false if the file can't be read
+	bool readAttachWeights(std::string const& file, Mesh const& mesh, Eigen::MatrixXd& weights) const;
 	void printAttachedMatrix(std::ostream& out, AttachMatrix mType) const throw(WrongStateException);
 	void printImportances(std::ostream& out) const throw(WrongStateException);
 	void printFinalAttachMatrix(std::ostream& out) const throw(WrongStateException);
+	// the skeleton with its tracks, the weights and connection matrices, the debug attachments (not the model)
+	void reportMemory(MemoryUse& use) const;
 
 	void selectNextBone() {
 		selectedBone++;
-		if (selectedBone+1 >= (int) SkeletonNode::getNumberOfNodes()) selectedBone = 0;
+		if (selectedBone+1 >= (int) skeleton.getJointNum()) selectedBone = 0;
 		printSelectedBone();
 		updateMeshSelected();
 	}
 	void selectPrevBone() {
 		selectedBone--;
-		if (selectedBone < 0) selectedBone = SkeletonNode::getNumberOfNodes()-2; // -1?
+		if (selectedBone < 0) selectedBone = skeleton.getJointNum()-2; // -1?
 		printSelectedBone();
 		updateMeshSelected();
 	}
@@ -125,12 +189,13 @@ public:
 	}
 	void nextConnectionDisplayType() {
 		displayOnMeshType = AttachMatrix ((int) displayOnMeshType + 1);
-		if ((int) displayOnMeshType > (int) VISIBLE_M) displayOnMeshType = (AttachMatrix) 0; // do not forget to update this
+		if ((int) displayOnMeshType > (int) WEIGHTS_M) displayOnMeshType = (AttachMatrix) 0; // do not forget to update this
 		std::cout << "On mesh we are now displaying attachments of type ";
 		switch (displayOnMeshType) {
 		case NONE_M: std::cout << "NONE"; break;
 		case SIMPLE_M: std::cout << "CLOSEST"; break;
 		case VISIBLE_M: std::cout << "CLOSEST VISIBLE"; break;
+		case WEIGHTS_M: std::cout << "WEIGHTS"; break;
 		default: throw(0);
 		}
 		std::cout << std::endl;
@@ -138,12 +203,20 @@ public:
 	}
 
 private:
+	void parseText(char *filename, bool streaming) throw(ParseException);
+	void loadCompiled(std::string const& compiledFile, bool streaming) throw(ParseException);
+	void addFrames(std::vector<float> const& rows, unsigned count);
 	void attachBonesToMesh();
 	void findFinalAttachmentWeights(Eigen::SparseMatrix<double>* connMatrixToUse);
 	void updateMeshSelected();
-	void precalculateMesh();
+	void skinFrame(unsigned frame, std::vector<Point>& newPoints) const;
 	bool tryLoadingAttached();
 
+	void samplePoseFrames(double const* frames, unsigned count, Pose& pose) const;
+
+	void loadWindow(unsigned start);
+	double seekWindow(double frameFrac);
+
 };
 
 #endif /* ANIMATION_H_ */
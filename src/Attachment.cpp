@@ -5,26 +5,23 @@
  *      Author: david
  */
 
-#include "SkeletonNode.h"
+#include "Skeleton.h"
 #include "Attachment.h"
 
-Attachment::Attachment(SkeletonNode const& endJoint_, Point const& attachPoint_, float distance_)
-		: endJoint(new SkeletonNode(endJoint_)), attachPoint(attachPoint_), distance(distance_) {}
+Attachment::Attachment(Skeleton const& skeleton_, unsigned endJoint_, Point const& attachPoint_, float distance_)
+		: skeleton(&skeleton_), endJoint(endJoint_), attachPoint(attachPoint_), distance(distance_) {}
 
 bool Attachment::operator<(Attachment const& o) const {
 	if (distance < o.distance) return true;
 	if (distance > o.distance) return false;
-	return (endJoint->getUpperBoneNum() < o.endJoint->getUpperBoneNum()); // differentiates between each attachment!
+	return (getBoneNum() < o.getBoneNum()); // differentiates between each attachment!
 }
 
 
 std::ostream& operator<<(std::ostream& os, const Attachment& a) {
-	os << "Attach[boneNum=" << a.endJoint->getUpperBoneNum()
-			<< ";endName=" << a.endJoint->getDescr()
+	os << "Attach[boneNum=" << a.getBoneNum()
+			<< ";endName=" << a.skeleton->getDescr(a.endJoint)
 			<< ";attachPoint=" << a.attachPoint
 			<< ";dist=" << a.distance << "]";
 	return os;
 }
-
-
-
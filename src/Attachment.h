@@ -9,23 +9,24 @@
 #define ATTACHMENT_H_
 
 #include "geometry.h"
-#include <VoxBits/StrongPtr.h>
 
-class SkeletonNode;
+class Skeleton;
 
 class Attachment {
 private:
-	VoxBits::strong_ptr<SkeletonNode> endJoint; // TODO think about what happens when this is copied
+	Skeleton const* skeleton; // has to outlive the attachment
+	unsigned endJoint;
 	Point attachPoint;
 	float distance;
 
 public:
-	Attachment(SkeletonNode const& endJoint_, Point const& attachPoint_, float distance_);
+	Attachment(Skeleton const& skeleton_, unsigned endJoint_, Point const& attachPoint_, float distance_);
 	virtual ~Attachment() {};
 
 	bool operator<(Attachment const& o) const;
 
-	SkeletonNode const& getEndJoint() const { return *endJoint; }
+	unsigned getEndJoint() const { return endJoint; }
+	int getBoneNum() const { return (int) endJoint - 1; }
 	Point const& getAttachPoint() const { return attachPoint; }
 	float getDistance() const {return distance;}
 	friend std::ostream& operator<< (std::ostream &out, Attachment const& a);
@@ -0,0 +1,102 @@
+/*
+ * BvhStream.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "BvhStream.h"
+#include "textScan.h"
+#include "tools.h"
+
+#include <sstream>
+#include <algorithm>
+
+/* Builds the frame index. This is one pass over the file that only looks for
+ * the line breaks, the numbers themselves are not parsed here.
+ * We assume (like every exporter we have seen does) that each frame is on its own line.
+ */
+BvhStream::BvhStream(std::string const& filename, size_t dataOffset, unsigned frameNum_,
+		unsigned channelsPerFrame_, unsigned stride_) throw(ParseException) :
+				file(filename), frameNum(frameNum_),
+				channelsPerFrame(channelsPerFrame_), stride(stride_) {
+	if (stride == 0) stride = 1;
+	// the frames wrap around (decodeFrames), that needs at least one
+	if (frameNum == 0) throw ParseException("at least 1 frame to stream", "Frames: 0 in " + filename);
+	frameOffsets.reserve(frameNum / stride + 1);
+
+	const char* p = file.begin() + std::min(dataOffset, file.size());
+	const char* end = file.end();
+	for (unsigned f = 0; f < frameNum; ++f) {
+		textScan::skipBlanks(p, end);
+		if (p == end) {
+			std::stringstream ss;
+			ss << "only " << f << " frames";
+			std::stringstream exp;
+			exp << "Frames: " << frameNum;
+			throw ParseException(exp.str(), ss.str());
+		}
+		if (f % stride == 0) frameOffsets.push_back(p - file.begin());
+		textScan::skipLine(p, end);
+	}
+
+	// we only needed to look at the bytes, no need to keep them around
+	file.dontNeed(dataOffset, file.size());
+
+	if (debug::ison(debug::LITTLE))
+		std::cout << "Indexed " << frameNum << " frames of " << filename
+				<< " (" << getIndexBytes() << " bytes of index)" << std::endl;
+}
+
+// returns a pointer to the first character of frame 'frame'
+const char* BvhStream::seekFrame(unsigned frame) const {
+	const char* p = file.begin() + frameOffsets[frame / stride];
+	for (unsigned i = frame % stride; i > 0; --i) {
+		textScan::skipLine(p, file.end());
+	}
+	return p;
+}
+
+// byte offset of the end of the index block that contains 'frame'
+size_t BvhStream::blockEnd(unsigned frame) const {
+	unsigned block = frame / stride + 1;
+	return (block < frameOffsets.size()) ? frameOffsets[block] : file.size();
+}
+
+void BvhStream::decodeFrames(unsigned first, unsigned count,
+							std::vector<float>& out) const throw(ParseException) {
+	out.resize(count * channelsPerFrame);
+	if (count == 0) return;
+
+	unsigned f = first % frameNum;
+	const char* p = seekFrame(f);
+	const char* runStart = p;
+	float* dest = &out[0];
+	for (unsigned i = 0; i < count; ++i, ++f) {
+		if (f == frameNum) { // wrap around to the beginning
+			file.dontNeed(runStart - file.begin(), p - file.begin());
+			f = 0;
+			p = runStart = seekFrame(0);
+		}
+		for (unsigned c = 0; c < channelsPerFrame; ++c) {
+			if (!textScan::scanFloat(p, file.end(), *dest++)) {
+				std::stringstream ss;
+				ss << "frame " << f << ": '"
+						<< std::string(p, std::min(p + 20, file.end())) << "'";
+				throw ParseException("a number", ss.str());
+			}
+		}
+	}
+	// the values are copied out, so the pages of the file can go
+	file.dontNeed(runStart - file.begin(), p - file.begin());
+}
+
+void BvhStream::readAhead(unsigned first, unsigned count) const {
+	if (count == 0) return;
+	first %= frameNum;
+	unsigned last = std::min(first + count, frameNum) - 1;
+	file.willNeed(frameOffsets[first / stride], blockEnd(last));
+	if (first + count > frameNum) { // wrapped part
+		file.willNeed(frameOffsets[0], blockEnd(first + count - frameNum - 1));
+	}
+}
@@ -0,0 +1,48 @@
+/*
+ * BvhStream.h
+ * Gives random access to the frames of the MOTION section of a .bvh file
+ * without reading all of them into memory. The file is memory mapped, and
+ * we remember where every stride-th frame line starts, so getting to any
+ * frame means a jump plus skipping at most stride-1 lines.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef BVHSTREAM_H_
+#define BVHSTREAM_H_
+
+#include <string>
+#include <vector>
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include "myexceptions.h"
+
+class BvhStream : public FrameSource {
+private:
+	MappedFile file;
+	unsigned frameNum;
+	unsigned channelsPerFrame; // all channels of all roots
+	unsigned stride;
+	std::vector<size_t> frameOffsets; // byte offset of frame 0, stride, 2*stride, ...
+
+	const char* seekFrame(unsigned frame) const;
+	size_t blockEnd(unsigned frame) const;
+
+public:
+	// dataOffset is where the first frame starts (right after "Frame Time: x")
+	BvhStream(std::string const& filename, size_t dataOffset, unsigned frameNum,
+			unsigned channelsPerFrame, unsigned stride = 32) throw(ParseException);
+	virtual ~BvhStream() {}
+
+	virtual unsigned getFrameNum() const { return frameNum; }
+	virtual unsigned getChannelsPerFrame() const { return channelsPerFrame; }
+	size_t getIndexBytes() const { return frameOffsets.capacity() * sizeof(size_t); }
+
+	virtual void decodeFrames(unsigned first, unsigned count, std::vector<float>& out) const throw(ParseException);
+	// starts reading in the bytes of these frames in the background
+	virtual void readAhead(unsigned first, unsigned count) const;
+};
+
+#endif /* BVHSTREAM_H_ */
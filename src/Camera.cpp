@@ -11,6 +11,7 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <algorithm>
 
 #ifdef __APPLE__
 #  include <GLUT/glut.h>
@@ -23,6 +24,8 @@
 Camera::Camera() {
 	near = 3.0f;
 	far = 150.0f;
+	fovY = 90;
+	screenHeight = 600;
 
 	turnSpeed = 10; /* 5; // FIXME i like these second ones better */
 	moveSpeed = 0.1; /* 0.5; // FIXME i like these second ones better  */
@@ -48,6 +51,21 @@ void Camera::reset() {
 // makes sure that the axis aligned box is visible in the camera (and y is up)
 void Camera::makeVisible(float xMin, float xMax,
 					float yMin, float yMax, float zMin, float zMax) {
+	float eye[3], centre[3];
+	findView(xMin, xMax, yMin, yMax, zMin, zMax, eye, centre, far);
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	gluLookAt(eye[0], eye[1], eye[2], centre[0], centre[1], centre[2], 0, 1.0, 0);
+	glGetDoublev(GL_MODELVIEW_MATRIX, cameraTrans); // initialize it to identity --> move to resetScene()
+	glPopMatrix();
+}
+
+// where makeVisible puts the camera (looking at centre, y is up), no GL needed.
+// far is made bigger if the box wouldn't fit
+void Camera::findView(float xMin, float xMax, float yMin, float yMax, float zMin, float zMax,
+		float* eye, float* centre, float& far) {
 //	float yPos = (yMax + yMin) / 2; // just the average
 	float yPos = (1.0/5.0) * yMin + (4.0/5.0) * yMax; // lift it up a bit
 
@@ -75,12 +93,8 @@ void Camera::makeVisible(float xMin, float xMax,
 		xPos -= 20;
 	}
 
-	glMatrixMode(GL_MODELVIEW);
-	glPushMatrix();
-	glLoadIdentity();
-	gluLookAt(xPos, yPos, zPos, xAvr, yPos, zAvr, 0, 1.0, 0);
-	glGetDoublev(GL_MODELVIEW_MATRIX, cameraTrans); // initialize it to identity --> move to resetScene()
-	glPopMatrix();
+	eye[0] = xPos; eye[1] = yPos; eye[2] = zPos;
+	centre[0] = xAvr; centre[1] = yPos; centre[2] = zAvr;
 }
 
 /* Sets up the view. To be called before any drawing! */
@@ -102,6 +116,12 @@ void Camera::view() {
 
 }
 
+float Camera::pixelsPerUnit(float x, float y, float z) const {
+	// how far in front of the camera (cameraTrans is column major, like GL's)
+	const double depth = -(cameraTrans[2]*x + cameraTrans[6]*y + cameraTrans[10]*z + cameraTrans[14]);
+	return screenHeight * 0.5 / tan(fovY * PI / 360) / std::max(depth, (double) near);
+}
+
 // translate the camera by the given amounts (with respect to its local frame)
 void Camera::translateCamera(double x, double y, double z) {
 
@@ -17,6 +17,8 @@ private:
 
 	double cameraTrans[16];
 	float near, far;
+	float fovY; // degrees
+	int screenHeight; // of the viewport, pixels
 
 public:
 	Camera();
@@ -28,12 +30,20 @@ public:
 	void reset();
 	void makeVisible(float xMin, float xMax,
 						float yMin, float yMax, float zMin, float zMax);
+	static void findView(float xMin, float xMax, float yMin, float yMax, float zMin, float zMax,
+			float* eye, float* centre, float& far);
 
 	void rotateCamera(double angle, double x, double y, double z);
 	void translateCamera(double x, double y, double z);
 
 	float getNear() { return near; }
 	float getFar() { return far; }
+	float getFovY() const { return fovY; }
+
+	// the height of the viewport the projection is for (what resize gets)
+	void setScreenHeight(int height) { screenHeight = height; }
+	// how many pixels a world unit is at the point x y z, from what the camera keeps (no GL state read)
+	float pixelsPerUnit(float x, float y, float z) const;
 
 	float turnSpeed;
 	float moveSpeed;
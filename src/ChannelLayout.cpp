@@ -0,0 +1,176 @@
+/*
+ * ChannelLayout.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "ChannelLayout.h"
+#include "EulerBatch.h"
+#include "tools.h"
+
+#include <string>
+#include <sstream>
+
+static char const* const CHANNEL_NAMES[ChannelLayout::MAX] = {
+		"Xposition", "Yposition", "Zposition", "Xrotation", "Yrotation", "Zrotation"};
+
+static const int NO_AXIS = 3;
+
+/* The rotation composers. Each rotation order gets its own instantiation, so
+ * which axis comes when is known at compile time and there is no looking at
+ * the channels while the frames are converted.
+ */
+template <int Axis>
+struct AxisRotation {
+	static Quaternion make(float const* rotDeg) {
+		return Quaternion(degToRad(rotDeg[Axis]), Axis == 0, Axis == 1, Axis == 2);
+	}
+	static void mulInto(Quaternion& q, float const* rotDeg) {
+		q.mulAxis<Axis>(degToRad(rotDeg[Axis]));
+	}
+	BATCH_INLINE static void mulInto(float& w, float& x, float& y, float& z, float const* deg, unsigned i) {
+		float s, c;
+		eulerBatch::sinCosHalfDeg(deg[i], s, c);
+		Quaternion::mulAxis<Axis>(w, x, y, z, s, c);
+	}
+	// the first one: the same as into the identity, without the multiplying
+	BATCH_INLINE static void setInto(float& w, float& x, float& y, float& z, float const* deg, unsigned i) {
+		float s, c;
+		eulerBatch::sinCosHalfDeg(deg[i], s, c);
+		w = c;
+		x = (Axis == 0) ? s : 0;
+		y = (Axis == 1) ? s : 0;
+		z = (Axis == 2) ? s : 0;
+	}
+};
+
+template <>
+struct AxisRotation<NO_AXIS> {
+	static Quaternion make(float const*) { return Quaternion(); }
+	static void mulInto(Quaternion&, float const*) {}
+	static void mulInto(float&, float&, float&, float&, float const*, unsigned) {}
+	static void setInto(float& w, float& x, float& y, float& z, float const*, unsigned) { w = 1; x = y = z = 0; }
+};
+
+template <int A, int B, int C>
+struct EulerRotation {
+	static Quaternion compose(float const* rotDeg) {
+		Quaternion q = AxisRotation<A>::make(rotDeg);
+		AxisRotation<B>::mulInto(q, rotDeg);
+		AxisRotation<C>::mulInto(q, rotDeg);
+		return q;
+	}
+
+	// everything inlines into one loop of plain arithmetic, which gets vectorized
+	static void composeBatch(float const* const* rotDeg, unsigned n, float* const* quat) {
+		// (the array pointers are taken out first, they could alias the output otherwise)
+		float const* degA = rotDeg[A % 3];
+		float const* degB = rotDeg[B % 3];
+		float const* degC = rotDeg[C % 3];
+		float* qw = quat[0];
+		float* qx = quat[1];
+		float* qy = quat[2];
+		float* qz = quat[3];
+		// (too many arrays for the compiler to prove they don't overlap, so tell it)
+		#pragma omp simd
+		for (unsigned i = 0; i < n; ++i) {
+			float w, x, y, z;
+			AxisRotation<A>::setInto(w, x, y, z, degA, i);
+			AxisRotation<B>::mulInto(w, x, y, z, degB, i);
+			AxisRotation<C>::mulInto(w, x, y, z, degC, i);
+			// only rounding took it off unit length, so one Newton step of
+			// 1/sqrt around 1 is exact enough (and sqrt would stop the vectorizing)
+			float inv = 0.5f * (3.0f - (w*w + x*x + y*y + z*z));
+			qw[i] = w * inv;
+			qx[i] = x * inv;
+			qy[i] = y * inv;
+			qz[i] = z * inv;
+		}
+	}
+};
+
+// rotation axes as they come in the file, NO_AXIS where there are fewer than 3
+static void pickComposer(int a, int b, int c,
+		ChannelLayout::Composer& composer, ChannelLayout::BatchComposer& batchComposer) {
+#define COMPOSER(a, b, c) case (a)*16 + (b)*4 + (c): \
+		composer = &EulerRotation<a, b, c>::compose; \
+		batchComposer = &EulerRotation<a, b, c>::composeBatch; \
+		return;
+	switch (a*16 + b*4 + c) {
+	COMPOSER(3, 3, 3)
+	COMPOSER(0, 3, 3) COMPOSER(1, 3, 3) COMPOSER(2, 3, 3)
+	COMPOSER(0, 1, 3) COMPOSER(0, 2, 3) COMPOSER(1, 0, 3)
+	COMPOSER(1, 2, 3) COMPOSER(2, 0, 3) COMPOSER(2, 1, 3)
+	COMPOSER(0, 1, 2) COMPOSER(0, 2, 1) COMPOSER(1, 0, 2)
+	COMPOSER(1, 2, 0) COMPOSER(2, 0, 1) COMPOSER(2, 1, 0)
+	default: composer = NULL; batchComposer = NULL; // can't happen, the axes are checked before
+	}
+#undef COMPOSER
+}
+
+ChannelLayout::ChannelLayout() : num(0), rotNum(0), position(false) {
+	rotOrder[0] = 0; rotOrder[1] = 1; rotOrder[2] = 2;
+	pickComposer(NO_AXIS, NO_AXIS, NO_AXIS, composer, batchComposer);
+}
+
+ChannelLayout::ChannelLayout(unsigned char const* chans, unsigned num_) throw(ParseException) :
+		num(num_), rotNum(0), position(false) {
+	if (num > MAX) {
+		std::stringstream ss;
+		ss << "CHANNELS " << num;
+		throw ParseException("at most 6 channels", ss.str());
+	}
+
+	bool seen[MAX] = {false, false, false, false, false, false};
+	int axes[3] = {NO_AXIS, NO_AXIS, NO_AXIS};
+	for (unsigned i = 0; i < num; ++i) {
+		if (chans[i] >= MAX || seen[chans[i]]) {
+			throw ParseException("each channel at most once", "a repeated or unknown channel");
+		}
+		seen[chans[i]] = true;
+		channels[i] = chans[i];
+		if (chans[i] >= XROT) {
+			axes[rotNum++] = chans[i] - XROT;
+		} else {
+			position = true;
+		}
+	}
+	pickComposer(axes[0], axes[1], axes[2], composer, batchComposer);
+
+	// for getting angles back the missing axes are put at the end
+	unsigned n = 0;
+	for (; n < rotNum; ++n) rotOrder[n] = axes[n];
+	for (unsigned ax = 0; ax < 3; ++ax) {
+		if (!seen[XROT + ax]) rotOrder[n++] = ax;
+	}
+}
+
+ChannelLayout ChannelLayout::parse(std::istream& in, unsigned num) throw(ParseException) {
+	if (num > MAX) {
+		std::stringstream ss;
+		ss << "CHANNELS " << num;
+		throw ParseException("at most 6 channels", ss.str());
+	}
+	unsigned char chans[MAX];
+	std::string token;
+	for (unsigned i = 0; i < num; ++i) {
+		in >> token;
+		unsigned c = 0;
+		while (c < MAX && token.compare(CHANNEL_NAMES[c]) != 0) ++c;
+		if (c == MAX) throw ParseException("[XYZ]position or [XYZ]rotation", token);
+		chans[i] = c;
+	}
+	return ChannelLayout(chans, num);
+}
+
+char const* ChannelLayout::channelName(unsigned char c) {
+	return (c < MAX) ? CHANNEL_NAMES[c] : "unknown";
+}
+
+void ChannelLayout::print(std::ostream& out) const {
+	out << "CHANNELS " << (unsigned) num;
+	for (unsigned i = 0; i < num; ++i) {
+		out << " " << CHANNEL_NAMES[channels[i]];
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * ChannelLayout.h
+ * Which channels a joint has in a .bvh file and in which order, e.g.
+ * "CHANNELS 6 Xposition Yposition Zposition Zrotation Yrotation Xrotation".
+ * Any subset of the six channels in any order is allowed. The rotations are
+ * applied in the order they are listed (the first one is the outermost).
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef CHANNELLAYOUT_H_
+#define CHANNELLAYOUT_H_
+
+#include <istream>
+#include <ostream>
+
+#include "Quaternion.h"
+#include "myexceptions.h"
+
+class ChannelLayout {
+public:
+	// also the index of the value in MotionFrame::values
+	enum Channel {XPOS = 0, YPOS, ZPOS, XROT, YROT, ZROT};
+	static const unsigned MAX = 6;
+
+	// builds the rotation out of the three angles (in degrees, x y z)
+	typedef Quaternion (*Composer)(float const* rotDeg);
+	// the same for n frames at once: rotDeg has the x, y, z angle arrays (only the
+	// axes the joint has are looked at), quat gets the w, x, y, z arrays
+	typedef void (*BatchComposer)(float const* const* rotDeg, unsigned n, float* const* quat);
+
+private:
+	unsigned char num;
+	unsigned char channels[MAX]; // Channel values in file order
+	unsigned char rotOrder[3]; // axes of the rotations, missing ones at the end
+	unsigned char rotNum;
+	bool position;
+	Composer composer; // specialized for rotOrder, chosen once per joint
+	BatchComposer batchComposer;
+
+public:
+	ChannelLayout(); // no channels (End Sites)
+	ChannelLayout(unsigned char const* chans, unsigned num) throw(ParseException);
+
+	// reads num channel names like "Zrotation"
+	static ChannelLayout parse(std::istream& in, unsigned num) throw(ParseException);
+	static char const* channelName(unsigned char c);
+
+	unsigned getNum() const { return num; }
+	unsigned char const* getChannels() const { return channels; }
+	unsigned char const* getRotationOrder() const { return rotOrder; }
+	unsigned getRotationNum() const { return rotNum; }
+	bool hasPosition() const { return position; }
+	Quaternion compose(float const* rotDeg) const { return composer(rotDeg); }
+	void composeBatch(float const* const* rotDeg, unsigned n, float* const* quat) const {
+		batchComposer(rotDeg, n, quat);
+	}
+
+	void print(std::ostream& out) const; // "CHANNELS n ..." without the newline
+};
+
+#endif /* CHANNELLAYOUT_H_ */
@@ -0,0 +1,236 @@
+/*
+ * CompiledClip.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "CompiledClip.h"
+#include "tools.h"
+#include "ChannelLayout.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <sys/stat.h>
+
+static const char CLIP_MAGIC[8] = {'B', 'V', 'H', 'C', 'L', 'I', 'P', '\0'};
+static const boost::uint32_t CLIP_VERSION = 1;
+static const size_t CLIP_BATCH = 256; // frames converted at once when writing
+
+inline size_t alignUp(size_t v) { return (v + 15) & ~((size_t) 15); }
+
+CompiledClip::CompiledClip(std::string const& filename) throw(ParseException) :
+		file(filename), header(NULL), joints(NULL), names(NULL), quant(NULL), frames(NULL) {
+	if (file.size() < sizeof(Header))
+		throw ParseException("compiled clip header", "a file of " + filename + " that is too short");
+	header = (Header const*) file.begin();
+	if (memcmp(header->magic, CLIP_MAGIC, sizeof(CLIP_MAGIC)) != 0)
+		throw ParseException("BVHCLIP", "something else at the start of " + filename);
+	if (header->version != CLIP_VERSION) {
+		std::stringstream ss;
+		ss << "version " << header->version;
+		throw ParseException("compiled clip version 1", ss.str());
+	}
+
+	if (header->encoding > QUANT16 ||
+			!fits(header->jointsOffset, (boost::uint64_t) header->jointNum * sizeof(Joint)) ||
+			!fits(header->namesOffset, header->namesSize))
+		throw ParseException("consistent compiled clip", "broken file " + filename);
+	joints = (Joint const*) (file.begin() + header->jointsOffset);
+	names = file.begin() + header->namesOffset;
+
+	// everything the skeleton will trust: the names end inside the names, the parents
+	// come first, the channels are known ones and add up to the rows
+	if (header->jointNum > 0 && (header->namesSize == 0 || names[header->namesSize - 1] != '\0'))
+		throw ParseException("consistent compiled clip", "joint names that don't end in " + filename);
+	boost::uint64_t channelSum = 0;
+	for (unsigned i = 0; i < header->jointNum; ++i) {
+		Joint const& j = joints[i];
+		bool ok = (j.nameOffset < header->namesSize && j.parent >= -1 && j.parent < (boost::int32_t) i &&
+				j.channelNum <= ChannelLayout::MAX);
+		for (unsigned c = 0; ok && c < j.channelNum; ++c) ok = (j.channels[c] < ChannelLayout::MAX);
+		if (!ok) {
+			std::stringstream ss;
+			ss << "broken joint " << i << " in " << filename;
+			throw ParseException("consistent compiled clip", ss.str());
+		}
+		channelSum += j.channelNum;
+	}
+	if (channelSum != header->channelsPerFrame)
+		throw ParseException("consistent compiled clip", "rows that don't match the joints in " + filename);
+
+	// (channelsPerFrame is small now, the sizes below can't overflow)
+	if (header->encoding == QUANT16 &&
+			!fits(header->quantOffset, 2 * (boost::uint64_t) header->channelsPerFrame * sizeof(float)))
+		throw ParseException("consistent compiled clip", "broken file " + filename);
+	if (!fits(header->framesOffset, 0) ||
+			(rowBytes() > 0 && header->frameNum > (file.size() - header->framesOffset) / rowBytes()))
+		throw ParseException("consistent compiled clip", "broken file " + filename);
+
+	if (header->encoding == QUANT16) quant = (float const*) (file.begin() + header->quantOffset);
+	frames = file.begin() + header->framesOffset;
+}
+
+// true if bytes from offset are all in the file (and offset is aligned like the writer does it)
+bool CompiledClip::fits(boost::uint64_t offset, boost::uint64_t bytes) const {
+	return offset % 16 == 0 && offset <= file.size() && bytes <= file.size() - offset;
+}
+
+size_t CompiledClip::rowBytes() const {
+	return header->channelsPerFrame *
+			(header->encoding == QUANT16 ? sizeof(boost::uint16_t) : sizeof(float));
+}
+
+void CompiledClip::decodeFrames(unsigned first, unsigned count,
+								std::vector<float>& out) const throw(ParseException) {
+	const unsigned chans = header->channelsPerFrame;
+	out.resize(count * chans);
+	if (count == 0) return;
+
+	float* dest = &out[0];
+	unsigned f = first % header->frameNum;
+	while (count > 0) {
+		// copy as many frames as we can before having to wrap around
+		unsigned run = std::min(count, header->frameNum - f);
+		char const* src = frames + f * rowBytes();
+		if (header->encoding == FLOAT32) {
+			memcpy(dest, src, run * rowBytes());
+		} else {
+			boost::uint16_t const* q = (boost::uint16_t const*) src;
+			for (unsigned i = 0; i < run; ++i) {
+				for (unsigned c = 0; c < chans; ++c) {
+					dest[i*chans + c] = quant[2*c] + quant[2*c+1] * q[i*chans + c];
+				}
+			}
+		}
+		file.dontNeed(src - file.begin(), src - file.begin() + run * rowBytes());
+		dest += run * chans;
+		count -= run;
+		f = 0;
+	}
+}
+
+void CompiledClip::readAhead(unsigned first, unsigned count) const {
+	first %= header->frameNum;
+	size_t from = header->framesOffset + first * rowBytes();
+	file.willNeed(from, from + count * rowBytes());
+	if (first + count > header->frameNum) {
+		file.willNeed(header->framesOffset,
+				header->framesOffset + (first + count - header->frameNum) * rowBytes());
+	}
+}
+
+std::string CompiledClip::siblingOf(std::string const& bvhFile) {
+	return bvhFile + "c";
+}
+
+bool CompiledClip::isCompiledName(std::string const& filename) {
+	return (filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".bvhc") == 0);
+}
+
+bool CompiledClip::isFresh(std::string const& compiled, std::string const& source) {
+	std::ifstream in(compiled.c_str(), std::ios::binary);
+	Header h;
+	if (!in.read((char*) &h, sizeof(Header))) return false;
+	if (memcmp(h.magic, CLIP_MAGIC, sizeof(CLIP_MAGIC)) != 0 || h.version != CLIP_VERSION)
+		return false;
+
+	struct stat st;
+	if (stat(source.c_str(), &st) != 0) return true; // nothing to be stale against
+	return (h.sourceSize == (boost::uint64_t) st.st_size &&
+			h.sourceMTime == (boost::int64_t) st.st_mtime);
+}
+
+inline void writePadding(std::ofstream& out) {
+	static const char zeros[16] = {0};
+	size_t pos = (size_t) out.tellp();
+	out.write(zeros, alignUp(pos) - pos);
+}
+
+bool CompiledClip::write(std::string const& filename, std::string const& source,
+		std::vector<Joint> const& joints, std::string const& names,
+		double frameTime, FrameSource const& frames, Encoding enc) {
+	const unsigned frameNum = frames.getFrameNum();
+	const unsigned chans = frames.getChannelsPerFrame();
+	std::vector<float> rows;
+
+	// for quantizing we need the range of each channel first
+	std::vector<float> quantTable;
+	if (enc == QUANT16) {
+		std::vector<float> mins(chans, std::numeric_limits<float>::max());
+		std::vector<float> maxs(chans, -std::numeric_limits<float>::max());
+		for (unsigned f = 0; f < frameNum; f += CLIP_BATCH) {
+			unsigned count = std::min((unsigned) CLIP_BATCH, frameNum - f);
+			frames.decodeFrames(f, count, rows);
+			for (unsigned i = 0; i < count * chans; ++i) {
+				mins[i % chans] = std::min(mins[i % chans], rows[i]);
+				maxs[i % chans] = std::max(maxs[i % chans], rows[i]);
+			}
+		}
+		quantTable.resize(2 * chans);
+		for (unsigned c = 0; c < chans; ++c) {
+			quantTable[2*c] = (frameNum > 0) ? mins[c] : 0;
+			quantTable[2*c+1] = (frameNum > 0) ? (maxs[c] - mins[c]) / 65535.0f : 0;
+		}
+	}
+
+	Header h;
+	memset(&h, 0, sizeof(Header));
+	memcpy(h.magic, CLIP_MAGIC, sizeof(CLIP_MAGIC));
+	h.version = CLIP_VERSION;
+	h.encoding = enc;
+	struct stat st;
+	if (stat(source.c_str(), &st) == 0) {
+		h.sourceSize = st.st_size;
+		h.sourceMTime = st.st_mtime;
+	}
+	h.jointNum = joints.size();
+	h.frameNum = frameNum;
+	h.channelsPerFrame = chans;
+	h.namesSize = names.size();
+	h.frameTime = frameTime;
+	h.jointsOffset = alignUp(sizeof(Header));
+	h.namesOffset = alignUp(h.jointsOffset + joints.size() * sizeof(Joint));
+	h.quantOffset = alignUp(h.namesOffset + names.size());
+	h.framesOffset = alignUp(h.quantOffset + quantTable.size() * sizeof(float));
+
+	// write next to the final place and rename, so nobody maps a half written clip
+	std::string tmpName = filename + ".tmp";
+	std::ofstream out(tmpName.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) return false;
+
+	out.write((char const*) &h, sizeof(Header));
+	writePadding(out);
+	if (!joints.empty()) out.write((char const*) &joints[0], joints.size() * sizeof(Joint));
+	writePadding(out);
+	out.write(names.data(), names.size());
+	writePadding(out);
+	if (!quantTable.empty()) out.write((char const*) &quantTable[0], quantTable.size() * sizeof(float));
+	writePadding(out);
+
+	std::vector<boost::uint16_t> qRows;
+	for (unsigned f = 0; f < frameNum; f += CLIP_BATCH) {
+		unsigned count = std::min((unsigned) CLIP_BATCH, frameNum - f);
+		frames.decodeFrames(f, count, rows);
+		if (enc == FLOAT32) {
+			out.write((char const*) &rows[0], rows.size() * sizeof(float));
+		} else {
+			qRows.resize(rows.size());
+			for (unsigned i = 0; i < rows.size(); ++i) {
+				float step = quantTable[2*(i % chans)+1];
+				float q = (step > 0) ? (rows[i] - quantTable[2*(i % chans)]) / step : 0;
+				qRows[i] = (boost::uint16_t) std::min(65535.0f, std::max(0.0f, q + 0.5f));
+			}
+			out.write((char const*) &qRows[0], qRows.size() * sizeof(boost::uint16_t));
+		}
+	}
+	out.close();
+	if (!out) {
+		std::remove(tmpName.c_str());
+		return false;
+	}
+	return (std::rename(tmpName.c_str(), filename.c_str()) == 0);
+}
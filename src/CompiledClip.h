@@ -0,0 +1,105 @@
+/*
+ * CompiledClip.h
+ * A binary version of a .bvh file (we name it <file>.bvhc, next to the .bvh).
+ * It has the same information as the text: the hierarchy with the offsets and
+ * channel layout of each joint, the frame time, and all the channel values
+ * of all the frames in one block (either as floats or quantized to 16 bits).
+ * The file is memory mapped and used as it is, there is nothing to parse.
+ *
+ * Layout (every section starts at a 16 byte boundary):
+ *   Header
+ *   Joint[jointNum]         depth first order, parents before children
+ *   char[namesSize]         '\0' terminated joint names
+ *   float[2*channels]       (QUANT16 only) min and step of each channel
+ *   frames                  frameNum rows of channelsPerFrame values
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef COMPILEDCLIP_H_
+#define COMPILEDCLIP_H_
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "FrameSource.h"
+#include "MappedFile.h"
+#include "myexceptions.h"
+
+class CompiledClip : public FrameSource {
+public:
+	enum Encoding {FLOAT32 = 0, QUANT16 = 1};
+
+	static const unsigned MAX_CHANNELS = 8;
+
+	struct Joint {
+		boost::int32_t parent; // -1 for roots
+		boost::uint32_t nameOffset; // into the names
+		boost::uint32_t channelNum; // 0 for End Sites
+		boost::uint8_t channels[MAX_CHANNELS]; // ChannelLayout::Channel values, in file order
+		float offset[3];
+	};
+
+	struct Header {
+		char magic[8];
+		boost::uint32_t version;
+		boost::uint32_t encoding;
+		boost::uint64_t sourceSize; // to tell if the .bvh changed since
+		boost::int64_t sourceMTime;
+		boost::uint32_t jointNum;
+		boost::uint32_t frameNum;
+		boost::uint32_t channelsPerFrame;
+		boost::uint32_t namesSize;
+		double frameTime;
+		boost::uint64_t jointsOffset;
+		boost::uint64_t namesOffset;
+		boost::uint64_t quantOffset;
+		boost::uint64_t framesOffset;
+	};
+
+private:
+	MappedFile file;
+	Header const* header;
+	Joint const* joints;
+	char const* names;
+	float const* quant; // min, step pairs
+	char const* frames;
+
+public:
+	CompiledClip(std::string const& filename) throw(ParseException);
+	virtual ~CompiledClip() {}
+
+	unsigned getJointNum() const { return header->jointNum; }
+	Joint const* getJoints() const { return joints; }
+	char const* getName(Joint const& j) const { return names + j.nameOffset; }
+	double getFrameTime() const { return header->frameTime; }
+	Encoding getEncoding() const { return (Encoding) header->encoding; }
+
+	virtual unsigned getFrameNum() const { return header->frameNum; }
+	virtual unsigned getChannelsPerFrame() const { return header->channelsPerFrame; }
+	virtual void decodeFrames(unsigned first, unsigned count, std::vector<float>& out) const throw(ParseException);
+	virtual void readAhead(unsigned first, unsigned count) const;
+
+	// where the compiled version of bvhFile lives
+	static std::string siblingOf(std::string const& bvhFile);
+	static bool isCompiledName(std::string const& filename);
+	// true if compiled exists, is readable by us, and was made from source as it is now
+	// (if source is gone the compiled file is all we have, so it counts as fresh)
+	static bool isFresh(std::string const& compiled, std::string const& source);
+
+	/* Writes a compiled clip. names has all the '\0' terminated names the joints
+	 * point into, frames gives the channel values. Returns false if the file
+	 * could not be written (e.g. read only directory), this is not fatal.
+	 */
+	static bool write(std::string const& filename, std::string const& source,
+			std::vector<Joint> const& joints, std::string const& names,
+			double frameTime, FrameSource const& frames, Encoding enc = FLOAT32);
+
+private:
+	size_t rowBytes() const;
+	bool fits(boost::uint64_t offset, boost::uint64_t bytes) const;
+};
+
+#endif /* COMPILEDCLIP_H_ */
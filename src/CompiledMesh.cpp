@@ -0,0 +1,227 @@
+/*
+ * CompiledMesh.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "CompiledMesh.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <sys/stat.h>
+
+static const char MESH_MAGIC[8] = {'O', 'B', 'J', 'M', 'E', 'S', 'H', '\0'};
+static const boost::uint32_t MESH_VERSION = 2;
+// the source hash looks at this many blocks of this size
+static const size_t HASH_BLOCKS = 64;
+static const size_t HASH_BLOCK_SIZE = 4096;
+
+inline size_t alignUp(size_t v) { return (v + 15) & ~((size_t) 15); }
+
+// FNV-1a of HASH_BLOCKS blocks spread evenly over the file (and its last bytes)
+static boost::uint64_t sampleHash(std::string const& source) throw(ParseException) {
+	MappedFile file(source);
+	boost::uint64_t h = 14695981039346656037ULL;
+	const size_t size = file.size();
+	for (size_t b = 0; b <= HASH_BLOCKS; ++b) {
+		size_t from = (b < HASH_BLOCKS) ? (size / HASH_BLOCKS) * b :
+				(size > HASH_BLOCK_SIZE ? size - HASH_BLOCK_SIZE : 0);
+		size_t to = std::min(size, from + HASH_BLOCK_SIZE);
+		for (const char* p = file.begin() + from; p < file.begin() + to; ++p) {
+			h ^= (unsigned char) *p;
+			h *= 1099511628211ULL;
+		}
+	}
+	return h;
+}
+
+CompiledMesh::CompiledMesh(std::string const& filename) throw(ParseException) :
+		file(filename), header(NULL) {
+	if (file.size() < sizeof(Header))
+		throw ParseException("compiled mesh header", "a file of " + filename + " that is too short");
+	header = (Header const*) file.begin();
+	if (memcmp(header->magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0)
+		throw ParseException("OBJMESH", "something else at the start of " + filename);
+	if (header->version != MESH_VERSION) {
+		std::stringstream ss;
+		ss << "version " << header->version;
+		throw ParseException("compiled mesh version 2", ss.str());
+	}
+
+	const boost::uint64_t v = header->vertexNum;
+	const boost::uint64_t t = header->triangleNum;
+	const boost::uint64_t nnz = header->laplacianNonZeros;
+	if (!fits(header->verticesOffset, 3 * sizeof(float) * v) ||
+			!fits(header->normalsOffset, 3 * sizeof(float) * header->normalNum) ||
+			!fits(header->faceVerticesOffset, 3 * sizeof(unsigned) * t) ||
+			!fits(header->faceNormalsOffset, 3 * sizeof(unsigned) * t) ||
+			!fits(header->trianglesOffset, sizeof(TriangleRecord) * t) ||
+			!fits(header->laplacianOuterOffset, sizeof(int) * (v + 1)) ||
+			!fits(header->laplacianInnerOffset, sizeof(int) * nnz) ||
+			!fits(header->laplacianValuesOffset, sizeof(double) * nnz) ||
+			v > (boost::uint64_t) INT_MAX || nnz > (boost::uint64_t) INT_MAX || // Eigen's indices are ints
+			(isReordered() &&
+				(!fits(header->originalVertexOfOffset, sizeof(unsigned) * v) ||
+				!fits(header->originalFaceOfOffset, sizeof(unsigned) * t))))
+		throw ParseException("consistent compiled mesh", "broken file " + filename);
+
+	// the mesh indexes with all of these without looking, so they are checked here
+	unsigned const* faceVertices = getFaceVertices();
+	unsigned const* faceNormals = getFaceNormals();
+	for (boost::uint64_t i = 0; i < 3 * t; ++i) {
+		if (faceVertices[i] >= v || faceNormals[i] >= header->normalNum)
+			throw ParseException("consistent compiled mesh", "a corner out of range in " + filename);
+	}
+	// (CSR with the columns of each row in order, like Eigen makes them)
+	int const* outer = getLaplacianOuter();
+	int const* inner = getLaplacianInner();
+	bool ok = (outer[0] == 0 && outer[v] == (int) nnz);
+	for (unsigned r = 0; ok && r < v; ++r) {
+		ok = (outer[r] <= outer[r+1]);
+		for (int k = outer[r]; ok && k < outer[r+1]; ++k)
+			ok = (inner[k] >= 0 && inner[k] < (int) v && (k == outer[r] || inner[k-1] < inner[k]));
+	}
+	if (!ok) throw ParseException("consistent compiled mesh", "a broken Laplacian in " + filename);
+	if (isReordered() && (!isPermutation(getOriginalVertexOf(), v) || !isPermutation(getOriginalFaceOf(), t)))
+		throw ParseException("consistent compiled mesh", "a broken reordering in " + filename);
+}
+
+// true if bytes from offset are all in the file (and offset is aligned like the writer does it)
+bool CompiledMesh::fits(boost::uint64_t offset, boost::uint64_t bytes) const {
+	return offset % 16 == 0 && offset <= file.size() && bytes <= file.size() - offset;
+}
+
+// true if the n numbers are 0 .. n-1, each once
+bool CompiledMesh::isPermutation(unsigned const* numbers, unsigned n) {
+	std::vector<bool> seen(n, false);
+	for (unsigned i = 0; i < n; ++i) {
+		if (numbers[i] >= n || seen[numbers[i]]) return false;
+		seen[numbers[i]] = true;
+	}
+	return true;
+}
+
+std::string CompiledMesh::siblingOf(std::string const& objFile) {
+	return objFile + "c";
+}
+
+bool CompiledMesh::isCompiledName(std::string const& filename) {
+	return (filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".objc") == 0);
+}
+
+bool CompiledMesh::isFresh(std::string const& compiled, std::string const& source, bool reordered) {
+	std::ifstream in(compiled.c_str(), std::ios::binary);
+	Header h;
+	if (!in.read((char*) &h, sizeof(Header))) return false;
+	if (memcmp(h.magic, MESH_MAGIC, sizeof(MESH_MAGIC)) != 0 || h.version != MESH_VERSION)
+		return false;
+	if (((h.flags & REORDERED) != 0) != reordered) return false;
+
+	struct stat st;
+	if (stat(source.c_str(), &st) != 0) return true; // nothing to be stale against
+	if (h.sourceSize != (boost::uint64_t) st.st_size || h.sourceMTime != (boost::int64_t) st.st_mtime)
+		return false;
+	try {
+		return (h.sourceHash == sampleHash(source));
+	} catch (ParseException&) {
+		return false;
+	}
+}
+
+inline void writePadding(std::ofstream& out) {
+	static const char zeros[16] = {0};
+	size_t pos = (size_t) out.tellp();
+	out.write(zeros, alignUp(pos) - pos);
+}
+
+template <class T>
+inline void writeSection(std::ofstream& out, T const* data, size_t count) {
+	if (count > 0) out.write((char const*) data, count * sizeof(T));
+	writePadding(out);
+}
+
+// the x y z of the points one after the other
+static std::vector<float> flatten(std::vector<Point> const& points) {
+	std::vector<float> ret(3 * points.size());
+	for (unsigned i = 0; i < points.size(); ++i) {
+		ret[3*i] = points[i].x();
+		ret[3*i+1] = points[i].y();
+		ret[3*i+2] = points[i].z();
+	}
+	return ret;
+}
+
+bool CompiledMesh::write(std::string const& filename, std::string const& source,
+		ObjData const& obj, TriangleRecord const* triangles,
+		Eigen::SparseMatrix<double> const& laplacian,
+		unsigned const* originalVertexOf, unsigned const* originalFaceOf) {
+	const size_t triangleNum = obj.faceVertices.size() / 3;
+	const size_t nnz = laplacian.nonZeros();
+
+	Header h;
+	memset(&h, 0, sizeof(Header));
+	memcpy(h.magic, MESH_MAGIC, sizeof(MESH_MAGIC));
+	h.version = MESH_VERSION;
+	h.vertexNum = obj.vertices.size();
+	h.normalNum = obj.normals.size();
+	h.triangleNum = triangleNum;
+	h.laplacianNonZeros = nnz;
+	const bool reordered = (originalVertexOf != NULL && originalFaceOf != NULL);
+	if (reordered) h.flags |= REORDERED;
+	struct stat st;
+	if (stat(source.c_str(), &st) == 0) {
+		h.sourceSize = st.st_size;
+		h.sourceMTime = st.st_mtime;
+		try {
+			h.sourceHash = sampleHash(source);
+		} catch (ParseException&) {
+			return false;
+		}
+	}
+	h.verticesOffset = alignUp(sizeof(Header));
+	h.normalsOffset = alignUp(h.verticesOffset + 3 * sizeof(float) * h.vertexNum);
+	h.faceVerticesOffset = alignUp(h.normalsOffset + 3 * sizeof(float) * h.normalNum);
+	h.faceNormalsOffset = alignUp(h.faceVerticesOffset + 3 * sizeof(unsigned) * triangleNum);
+	h.trianglesOffset = alignUp(h.faceNormalsOffset + 3 * sizeof(unsigned) * triangleNum);
+	h.laplacianOuterOffset = alignUp(h.trianglesOffset + sizeof(TriangleRecord) * triangleNum);
+	h.laplacianInnerOffset = alignUp(h.laplacianOuterOffset + sizeof(int) * (h.vertexNum + 1));
+	h.laplacianValuesOffset = alignUp(h.laplacianInnerOffset + sizeof(int) * nnz);
+	h.originalVertexOfOffset = alignUp(h.laplacianValuesOffset + sizeof(double) * nnz);
+	h.originalFaceOfOffset = alignUp(h.originalVertexOfOffset +
+			(reordered ? sizeof(unsigned) * h.vertexNum : 0));
+
+	// write next to the final place and rename, so nobody maps a half written mesh
+	std::string tmpName = filename + ".tmp";
+	std::ofstream out(tmpName.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) return false;
+
+	out.write((char const*) &h, sizeof(Header));
+	writePadding(out);
+	std::vector<float> flat = flatten(obj.vertices);
+	writeSection(out, flat.empty() ? NULL : &flat[0], flat.size());
+	flat = flatten(obj.normals);
+	writeSection(out, flat.empty() ? NULL : &flat[0], flat.size());
+	writeSection(out, obj.faceVertices.empty() ? NULL : &obj.faceVertices[0], obj.faceVertices.size());
+	writeSection(out, obj.faceNormals.empty() ? NULL : &obj.faceNormals[0], obj.faceNormals.size());
+	writeSection(out, triangles, triangleNum);
+	writeSection(out, laplacian.outerIndexPtr(), h.vertexNum + 1);
+	writeSection(out, laplacian.innerIndexPtr(), nnz);
+	writeSection(out, laplacian.valuePtr(), nnz);
+	if (reordered) {
+		writeSection(out, originalVertexOf, h.vertexNum);
+		writeSection(out, originalFaceOf, triangleNum);
+	}
+
+	out.close();
+	if (!out) {
+		std::remove(tmpName.c_str());
+		return false;
+	}
+	return (std::rename(tmpName.c_str(), filename.c_str()) == 0);
+}
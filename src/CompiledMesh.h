@@ -0,0 +1,120 @@
+/*
+ * CompiledMesh.h
+ * A binary version of an .obj file and what we work out from it (we name it
+ * <file>.objc, next to the .obj), like CompiledClip is for a .bvh. The file is
+ * memory mapped and its arrays are used where they are.
+ *
+ * It is only used if the .obj still has the size and modification time it was
+ * made from, and a hash of some of its blocks (spread over the whole file)
+ * matches too, so this doesn't have to read all of a big .obj.
+ *
+ * Layout (every section starts at a 16 byte boundary):
+ *   Header
+ *   float[3*vertexNum]              positions
+ *   float[3*normalNum]              normals (normalized)
+ *   uint32[3*triangleNum]           vertex of each corner, 0 based
+ *   uint32[3*triangleNum]           normal of each corner
+ *   TriangleRecord[triangleNum]
+ *   int32[vertexNum+1], int32[nnz]  Laplacian in CSR form (it is symmetric,
+ *   double[nnz]                     so this is the same as Eigen's CSC)
+ *   uint32[vertexNum]               if REORDERED: the .obj number of each vertex
+ *   uint32[triangleNum]             if REORDERED: the .obj triangle of each triangle
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef COMPILEDMESH_H_
+#define COMPILEDMESH_H_
+
+#include <string>
+#include <boost/cstdint.hpp>
+#include <Eigen/Sparse>
+
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "geometry.h"
+#include "myexceptions.h"
+
+class CompiledMesh {
+public:
+	struct Header {
+		char magic[8];
+		boost::uint32_t version;
+		boost::uint32_t vertexNum;
+		boost::uint32_t normalNum;
+		boost::uint32_t triangleNum;
+		boost::uint32_t laplacianNonZeros;
+		boost::uint32_t flags;
+		boost::uint64_t sourceSize; // to tell if the .obj changed since
+		boost::int64_t sourceMTime;
+		boost::uint64_t sourceHash;
+		boost::uint64_t verticesOffset;
+		boost::uint64_t normalsOffset;
+		boost::uint64_t faceVerticesOffset;
+		boost::uint64_t faceNormalsOffset;
+		boost::uint64_t trianglesOffset;
+		boost::uint64_t laplacianOuterOffset;
+		boost::uint64_t laplacianInnerOffset;
+		boost::uint64_t laplacianValuesOffset;
+		boost::uint64_t originalVertexOfOffset;
+		boost::uint64_t originalFaceOfOffset;
+	};
+	// flags
+	static const boost::uint32_t REORDERED = 1; // see MeshReorder.h
+
+private:
+	MappedFile file;
+	Header const* header;
+
+	template <class T>
+	T const* at(boost::uint64_t offset) const { return (T const*) (file.begin() + offset); }
+	bool fits(boost::uint64_t offset, boost::uint64_t bytes) const;
+	static bool isPermutation(unsigned const* numbers, unsigned n);
+
+public:
+	// checks every index the mesh will use too, a broken file throws
+	CompiledMesh(std::string const& filename) throw(ParseException);
+	virtual ~CompiledMesh() {}
+
+	unsigned getVertexNum() const { return header->vertexNum; }
+	unsigned getNormalNum() const { return header->normalNum; }
+	unsigned getTriangleNum() const { return header->triangleNum; }
+	unsigned getLaplacianNonZeros() const { return header->laplacianNonZeros; }
+	float const* getVertices() const { return at<float>(header->verticesOffset); }
+	float const* getNormals() const { return at<float>(header->normalsOffset); }
+	unsigned const* getFaceVertices() const { return at<unsigned>(header->faceVerticesOffset); }
+	unsigned const* getFaceNormals() const { return at<unsigned>(header->faceNormalsOffset); }
+	TriangleRecord const* getTriangles() const { return at<TriangleRecord>(header->trianglesOffset); }
+	int const* getLaplacianOuter() const { return at<int>(header->laplacianOuterOffset); }
+	int const* getLaplacianInner() const { return at<int>(header->laplacianInnerOffset); }
+	double const* getLaplacianValues() const { return at<double>(header->laplacianValuesOffset); }
+	bool isReordered() const { return (header->flags & REORDERED) != 0; }
+	// NULL unless reordered
+	unsigned const* getOriginalVertexOf() const {
+		return isReordered() ? at<unsigned>(header->originalVertexOfOffset) : NULL;
+	}
+	unsigned const* getOriginalFaceOf() const {
+		return isReordered() ? at<unsigned>(header->originalFaceOfOffset) : NULL;
+	}
+
+	// where the compiled version of objFile lives
+	static std::string siblingOf(std::string const& objFile);
+	static bool isCompiledName(std::string const& filename);
+	// true if compiled exists, is readable by us, was made from source as it is now
+	// and is reordered or not as asked (if source is gone the compiled file is all
+	// we have, so it counts as fresh)
+	static bool isFresh(std::string const& compiled, std::string const& source, bool reordered);
+
+	/* Writes a compiled mesh. laplacian has to be compressed. If obj was
+	 * reordered, originalVertexOf and originalFaceOf are the remaps (else NULL).
+	 * Returns false if the file could not be written (e.g. read only
+	 * directory), this is not fatal.
+	 */
+	static bool write(std::string const& filename, std::string const& source,
+			ObjData const& obj, TriangleRecord const* triangles,
+			Eigen::SparseMatrix<double> const& laplacian,
+			unsigned const* originalVertexOf = NULL, unsigned const* originalFaceOf = NULL);
+};
+
+#endif /* COMPILEDMESH_H_ */
@@ -0,0 +1,161 @@
+/*
+ * Crowd.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include "Crowd.h"
+#include "FrameScheduler.h"
+#include "tools.h"
+#include "Trace.h"
+#include "MemoryUse.h"
+
+#include <cmath>
+#include <cstring>
+
+Crowd::Crowd(boost::shared_ptr<Animation> const& animation_, boost::shared_ptr<Mesh> const& model_)
+		throw(WrongStateException) : clips(1, animation_), model(model_), timeOfPreviousCall(-1) {
+	Animation const* animation = clips[0].get();
+	if (animation->isStreaming())
+		throw WrongStateException("A crowd needs the whole clip, it can't be streamed");
+	Eigen::MatrixXd const& weights = animation->getAttachWeights();
+	if (weights.rows() != (int) model->getNumVertices() || weights.cols() != (int) animation->getBoneNum())
+		throw WrongStateException("Tried to make a crowd before the model was attached to the skeleton");
+
+	// the same test skinFrame does
+	influenceStarts.reserve(weights.rows() + 1);
+	influenceStarts.push_back(0);
+	for (int v = 0; v < weights.rows(); ++v) {
+		for (int b = 0; b < weights.cols(); ++b) {
+			if (weights(v, b) > EPS) {
+				influenceBones.push_back(b);
+				influenceWeights.push_back(weights(v, b));
+			}
+		}
+		influenceStarts.push_back(influenceBones.size());
+	}
+}
+
+unsigned Crowd::addClip(boost::shared_ptr<Animation> const& clip) throw(WrongStateException) {
+	if (clip->isStreaming())
+		throw WrongStateException("A crowd needs the whole clip, it can't be streamed");
+	Skeleton const& a = clips[0]->getSkeleton();
+	Skeleton const& b = clip->getSkeleton();
+	bool same = a.getJointNum() == b.getJointNum() && a.getAnimatedJoints() == b.getAnimatedJoints();
+	for (unsigned j = 0; same && j < a.getJointNum(); ++j) same = strcmp(a.getName(j), b.getName(j)) == 0;
+	if (!same)
+		throw WrongStateException("The clips of a crowd have to have the same skeleton, " + clip->getFileName()
+				+ " has another one than " + clips[0]->getFileName());
+	clips.push_back(clip);
+	return clips.size() - 1;
+}
+
+void Crowd::add(CrowdInstance const& instance) throw(WrongStateException) {
+	if (instance.clip >= clips.size())
+		throw WrongStateException("Tried to add a crowd instance playing a clip the crowd doesn't have");
+	instances.push_back(instance);
+}
+
+void Crowd::addGrid(unsigned count, float spacing) {
+	const unsigned perRow = std::max(1u, (unsigned) std::ceil(std::sqrt((double) count)));
+	for (unsigned i = 0; i < count; ++i) {
+		const float x = ((int) (i % perRow) - (perRow - 1) * 0.5f) * spacing;
+		const float z = -(float) (i / perRow) * spacing;
+		const unsigned clip = i % clips.size();
+		// spread over the clip (golden ratio steps, so neighbours are far apart in time)
+		const double spread = fmod(i * 0.6180339887, 1.0);
+		add(CrowdInstance(spread * clips[clip]->getClipLength(), 0.9 + 0.2 * fmod(i * 0.3819660113, 1.0),
+				Point(x, 0, z), 0, clip));
+	}
+}
+
+void Crowd::advance(double seconds) {
+	// follows the speed of the viewer ('+' and '-')
+	const double rate = clips[0]->getVirtualFPS() * clips[0]->getStdFrameTime();
+	for (unsigned i = 0; i < instances.size(); ++i) instances[i].time += seconds * rate * instances[i].speed;
+}
+
+void Crowd::skin() {
+	TRACE_SCOPE("skin crowd");
+	const unsigned n = instances.size();
+	if (n == 0) return;
+	// the poses of the instances of a clip in one batch
+	poses.resize(clips.size());
+	slots.resize(n);
+	for (unsigned c = 0; c < clips.size(); ++c) {
+		times.clear();
+		for (unsigned i = 0; i < n; ++i) {
+			if (instances[i].clip != c) continue;
+			slots[i] = times.size();
+			times.push_back(instances[i].time);
+		}
+		if (!times.empty()) clips[c]->samplePoses(&times[0], times.size(), poses[c]);
+	}
+
+	const unsigned bones = clips[0]->getBoneNum();
+	boneMatrices.resize(12 * bones * n);
+	jointScratch.resize(12 * bones * n);
+	skinned.resize(n);
+	std::vector<Point> const& points = model->getOrigVertices();
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) n; ++i) {
+		TRACE_SCOPE("skin instance");
+		float const* m0 = &boneMatrices[12 * bones * i];
+		const unsigned c = instances[i].clip;
+		clips[c]->skinningMatrices(poses[c], slots[i], &boneMatrices[12 * bones * i], &jointScratch[12 * bones * i]);
+
+		std::vector<Point>& out = skinned[i];
+		out.resize(points.size());
+		for (unsigned v = 0; v < points.size(); ++v) {
+			const float p[3] = {points[v].x(), points[v].y(), points[v].z()};
+			float q[3] = {0, 0, 0};
+			for (unsigned k = influenceStarts[v]; k < influenceStarts[v+1]; ++k) {
+				float const* m = m0 + 12 * influenceBones[k];
+				const float w = influenceWeights[k];
+				for (unsigned r = 0; r < 3; ++r) q[r] += w * (m[r]*p[0] + m[3 + r]*p[1] + m[6 + r]*p[2] + m[9 + r]);
+			}
+			out[v] = Point(q[0], q[1], q[2]);
+		}
+	}
+}
+
+void Crowd::display(bool animating, Camera const& cam) {
+	TRACE_SCOPE("display crowd");
+	const double curTime = FrameScheduler::now();
+	if (animating && timeOfPreviousCall >= 0) advance(curTime - timeOfPreviousCall);
+	timeOfPreviousCall = curTime;
+
+	skin();
+	Point const& c = model->getBoundCentre();
+	for (unsigned i = 0; i < instances.size(); ++i) {
+		// where the middle of this one is, turned and moved like GL does it below
+		const float a = degToRad(instances[i].heading);
+		Point const& p = instances[i].position;
+		model->setViewScale(cam.pixelsPerUnit(p.x() + cos(a) * c.x() + sin(a) * c.z(), p.y() + c.y(),
+				p.z() - sin(a) * c.x() + cos(a) * c.z()));
+		glPushMatrix();
+		glTranslatef(instances[i].position.x(), instances[i].position.y(), instances[i].position.z());
+		glRotatef(instances[i].heading, 0, 1, 0);
+		model->display(skinned[i]);
+		glPopMatrix();
+	}
+}
+
+void Crowd::reportMemory(MemoryUse& use) const {
+	size_t poseBytes = poses.capacity() * sizeof(Pose);
+	for (unsigned c = 0; c < poses.size(); ++c) poseBytes += MemoryUse::bytesOf(poses[c]);
+	use.add("crowd", MemoryUse::bytesOf(instances) + MemoryUse::bytesOf(influenceStarts)
+			+ MemoryUse::bytesOf(influenceBones) + MemoryUse::bytesOf(influenceWeights) + poseBytes
+			+ MemoryUse::bytesOf(slots) + MemoryUse::bytesOf(times) + MemoryUse::bytesOf(boneMatrices)
+			+ MemoryUse::bytesOf(jointScratch) + MemoryUse::bytesOf(skinned));
+	// the frames of the other clips (the first one's are the animation's)
+	for (unsigned c = 1; c < clips.size(); ++c) clips[c]->reportMemory(use);
+}
@@ -0,0 +1,107 @@
+/*
+ * Crowd.h
+ * Many copies of one character playing one or more clips. The mesh and the
+ * weights are the ones of the first Animation, the frames of each clip are
+ * in its own (all only there once); an instance only has which clip it
+ * plays, its time in it, its speed and where it stands. Every frame the poses
+ * of the instances of each clip are sampled in one batch, and all of them
+ * are skinned together, spread over the cores. The skinned vertices
+ * stay in the space of the model, where an instance stands is applied by GL
+ * when it's drawn.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef CROWD_H_
+#define CROWD_H_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "Animation.h"
+#include "Camera.h"
+#include "Mesh.h"
+#include "Pose.h"
+#include "geometry.h"
+#include "myexceptions.h"
+
+struct CrowdInstance {
+	double time; // in the clip, seconds
+	double speed; // 1 is as recorded
+	Point position;
+	float heading; // about y, degrees
+	unsigned clip; // which of the clips of the crowd, see Crowd::addClip
+
+	CrowdInstance(double time_ = 0, double speed_ = 1, Point const& position_ = Point(), float heading_ = 0,
+			unsigned clip_ = 0) :
+		time(time_), speed(speed_), position(position_), heading(heading_), clip(clip_) {}
+};
+
+class Crowd {
+private:
+	std::vector< boost::shared_ptr<Animation> > clips; // the first one has the model attached
+	boost::shared_ptr<Mesh> model;
+	std::vector<CrowdInstance> instances;
+
+	// the bones that move each vertex and how much (the weights that are not
+	// ~0), vertex after vertex, CSR style
+	std::vector<unsigned> influenceStarts;
+	std::vector<unsigned> influenceBones;
+	std::vector<float> influenceWeights;
+
+	// filled by skin: the poses of each clip (of its instances, in their order) and where each
+	// instance's is in them, a 3x4 matrix per bone per instance, and the vertices of each instance
+	std::vector<Pose> poses;
+	std::vector<unsigned> slots;
+	std::vector<double> times;
+	std::vector<float> boneMatrices;
+	std::vector<float> jointScratch; // for skinningMatrices, as big as boneMatrices (kept, not allocated every frame)
+	std::vector< std::vector<Point> > skinned;
+
+	double timeOfPreviousCall; // FrameScheduler::now, -1 before the first frame
+
+public:
+	// the animation has to have the model set already, and not be streaming
+	Crowd(boost::shared_ptr<Animation> const& animation, boost::shared_ptr<Mesh> const& model) throw(WrongStateException);
+	virtual ~Crowd() {}
+
+	/* Another clip the instances can play, its number is returned. It has to
+	 * have the skeleton of the first (the same joints, by name, animated the
+	 * same), and not be streaming.
+	 */
+	unsigned addClip(boost::shared_ptr<Animation> const& clip) throw(WrongStateException);
+	unsigned getClipNum() const { return clips.size(); }
+
+	// the clip of the instance has to be one of getClipNum
+	void add(CrowdInstance const& instance) throw(WrongStateException);
+	void clear() { instances.clear(); }
+	/* Adds count instances in rows along x (spacing apart) behind the origin,
+	 * taking turns at the clips, each at another time of its clip and a
+	 * slightly different speed.
+	 */
+	void addGrid(unsigned count, float spacing);
+	unsigned getInstanceNum() const { return instances.size(); }
+	// (don't set the clip to one the crowd doesn't have)
+	CrowdInstance& getInstance(unsigned i) { return instances[i]; }
+
+	// moves every instance ahead by seconds (times its speed)
+	void advance(double seconds);
+	// samples the poses and skins the mesh of every instance
+	void skin();
+	std::vector<Point> const& getSkinned(unsigned i) const { return skinned[i]; }
+	// the bones of instance i (as skinned) as lines, see Animation::boneLines
+	unsigned getBoneLineNum() const { return clips[0]->getBoneLineNum(); }
+	void boneLines(unsigned i, float* ends) const {
+		const unsigned c = instances[i].clip;
+		clips[c]->boneLines(poses[c], slots[i], ends);
+	}
+
+	// advances by the time since the last call (if animating), skins and draws all of them
+	// (each at the level of detail for how far from cam it stands)
+	void display(bool animating, Camera const& cam);
+
+	void reportMemory(MemoryUse& use) const;
+};
+
+#endif /* CROWD_H_ */
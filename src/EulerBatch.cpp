@@ -0,0 +1,47 @@
+/*
+ * EulerBatch.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "EulerBatch.h"
+
+#include <cstddef>
+
+// same formulas as Quaternion::getRotation
+template <bool HasPos>
+static void toMatricesLoop(float const* const* wxyz, float const* const* pos, unsigned n, float* m3x4) {
+	float const* qw = wxyz[0];
+	float const* qx = wxyz[1];
+	float const* qy = wxyz[2];
+	float const* qz = wxyz[3];
+	float const* px = HasPos ? pos[0] : NULL;
+	float const* py = HasPos ? pos[1] : NULL;
+	float const* pz = HasPos ? pos[2] : NULL;
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i) {
+		float w = qw[i], x = qx[i], y = qy[i], z = qz[i];
+		float* m = m3x4 + 12*i;
+		m[0] = w*w + x*x - y*y - z*z;
+		m[1] = 2*x*y + 2*w*z;
+		m[2] = 2*x*z - 2*w*y;
+
+		m[3] = 2*x*y - 2*w*z;
+		m[4] = w*w - x*x + y*y - z*z;
+		m[5] = 2*y*z + 2*w*x;
+
+		m[6] = 2*x*z + 2*w*y;
+		m[7] = 2*y*z - 2*w*x;
+		m[8] = w*w - x*x - y*y + z*z;
+
+		m[9] = HasPos ? px[i] : 0;
+		m[10] = HasPos ? py[i] : 0;
+		m[11] = HasPos ? pz[i] : 0;
+	}
+}
+
+void eulerBatch::toMatrices(float const* const* wxyz, float const* const* pos, unsigned n, float* m3x4) {
+	if (pos != NULL) toMatricesLoop<true>(wxyz, pos, n, m3x4);
+	else toMatricesLoop<false>(wxyz, pos, n, m3x4);
+}
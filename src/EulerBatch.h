@@ -0,0 +1,79 @@
+/*
+ * EulerBatch.h
+ * Converts the rotation channels of many frames at once. The inputs and the
+ * quaternions are kept as one array per component (x angles, y angles, ...,
+ * w's, x's, ...), so the loops have no dependencies between frames and
+ * nothing but arithmetic in them, and the compiler turns them into SIMD code
+ * (with -fopenmp at -O2 already, SSE2 is enough, -march only makes the vectors wider).
+ * libm's sin and cos can't be vectorized, so there is a branch free sinCos here
+ * (the single precision polynomials of cephes, good to about 1e-7).
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef EULERBATCH_H_
+#define EULERBATCH_H_
+
+// what the vectorized loops call has to be inlined into them, or they don't get vectorized
+// (at -O2 the inliner would leave sinCos out of a loop that calls it three times)
+#define BATCH_INLINE inline __attribute__((always_inline))
+
+namespace eulerBatch {
+
+	// pi/2 split into three parts so that j * PIO2_1 is exact
+	static const float PIO2_1 = 1.5703125f;
+	static const float PIO2_2 = 4.837512969970703125e-4f;
+	static const float PIO2_3 = 7.54978995489188216e-8f;
+	static const float TWO_OVER_PI = 0.636619772367581343f;
+	static const float HALF_DEG_TO_RAD = 0.00872664625997164788f; // pi / 360
+	static const float ROUNDER = 12582912.0f; // 1.5 * 2^23: adding it and taking it off again rounds a float
+
+	// sin and cos of j * pi/2 + r, with |r| around pi/4 at most.
+	// No branches and no float compares, or the loops using it won't vectorize.
+	BATCH_INLINE void sinCosQuadrant(int j, float r, float& s, float& c) {
+		float z = r * r;
+
+		float ps = r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+		float pc = 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f +
+				z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+
+		// which quadrant: swap sin and cos for the odd ones, then fix the signs
+		// (one of the products is exactly 0, so this is exact)
+		float swap = (float) (j & 1);
+		float ts = ps * (1 - swap) + pc * swap;
+		float tc = pc * (1 - swap) + ps * swap;
+		s = ts * (float) (1 - (j & 2));
+		c = tc * (float) (1 - ((j + 1) & 2));
+	}
+
+	// for |rad| up to about 1e4, e.g. the angles of slerp
+	BATCH_INLINE void sinCosSmall(float rad, float& s, float& c) {
+		// rad = j * pi/2 + r, with |r| <= pi/4 (the bias makes the cast round down)
+		int j = (int) (rad * TWO_OVER_PI + 8192.5f) - 8192;
+		float fj = (float) j;
+		sinCosQuadrant(j, ((rad - fj * PIO2_1) - fj * PIO2_2) - fj * PIO2_3, s, c);
+	}
+
+	/* The sin and cos of half of deg (in degrees), what the quaternion of a
+	 * rotation about an axis is made of. Good for any |deg| below about 6e7 (BVH
+	 * angles can add up over many turns): the angle is reduced in degrees, by the
+	 * closest multiple of 180 (a quarter turn of the half angle), which is exact
+	 * and one step, whole turns and all. (Not with -ffast-math, which would take
+	 * the rounding out.)
+	 */
+	BATCH_INLINE void sinCosHalfDeg(float deg, float& s, float& c) {
+		float fj = (deg * (1.0f / 180) + ROUNDER) - ROUNDER;
+		sinCosQuadrant((int) fj, (deg - fj * 180) * HALF_DEG_TO_RAD, s, c);
+	}
+
+	/* 3x4 matrices (the upper three rows of the OpenGL matrix: the columns of
+	 * the rotation, then the translation, 12 floats per frame) out of n unit
+	 * quaternions. pos has the x, y, z arrays of the translations or is NULL
+	 * for none.
+	 */
+	void toMatrices(float const* const* wxyz, float const* const* pos, unsigned n, float* m3x4);
+
+}
+
+#endif /* EULERBATCH_H_ */
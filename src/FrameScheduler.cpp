@@ -0,0 +1,59 @@
+/*
+ * FrameScheduler.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <time.h>
+
+static const FrameScheduler::Stats NO_FRAMES = {0, 0, 0, 0};
+
+FrameScheduler::FrameScheduler(double refreshRate) :
+		interval(0), nextDeadline(0), frameStart(0), timerPending(false),
+		current(NO_FRAMES), currentStart(-1), lastSecond(NO_FRAMES), total(NO_FRAMES), firstStart(-1) {
+	setRefreshRate(refreshRate);
+}
+
+double FrameScheduler::now() {
+	timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+void FrameScheduler::setRefreshRate(double refreshRate) {
+	interval = (refreshRate > 0) ? 1 / refreshRate : 0;
+}
+
+void FrameScheduler::add(Stats& s, double work, double span) {
+	s.frames++;
+	s.work += work;
+	s.maxWork = std::max(s.maxWork, work);
+	s.span = span;
+}
+
+void FrameScheduler::frameBegin() {
+	frameStart = now();
+	if (firstStart < 0) firstStart = currentStart = frameStart;
+	if (frameStart - currentStart >= 1) {
+		lastSecond = current;
+		current = NO_FRAMES;
+		currentStart = frameStart;
+	}
+}
+
+int FrameScheduler::frameEnd(bool animating) {
+	const double t = now();
+	add(current, t - frameStart, t - currentStart);
+	add(total, t - frameStart, t - firstStart);
+
+	if (!animating || timerPending) return -1;
+	// from the last deadline, unless we fell behind (or were paused)
+	nextDeadline += interval;
+	if (nextDeadline < t) nextDeadline = t;
+	timerPending = true;
+	return (int) ((nextDeadline - t) * 1000 + 0.5);
+}
@@ -0,0 +1,63 @@
+/*
+ * FrameScheduler.h
+ * Decides when the viewer draws. Nothing is drawn while the animation is
+ * paused and nobody touches anything (the window system still asks for a
+ * frame after input or when the window changes). While animating, frames are
+ * asked for at the refresh rate, from deadlines on a monotonic clock so the
+ * rounding of the timer doesn't add up. Also keeps how long the frames took.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef FRAMESCHEDULER_H_
+#define FRAMESCHEDULER_H_
+
+class FrameScheduler {
+public:
+	struct Stats {
+		unsigned frames;
+		double work; // seconds spent drawing, all of them
+		double maxWork; // the longest frame
+		double span; // seconds from the first frame to the last
+	};
+
+private:
+	double interval; // between frames when animating, 0: as fast as it goes
+	double nextDeadline;
+	double frameStart;
+	bool timerPending;
+	// the frames of the current second, the last full second, and all of them
+	Stats current;
+	double currentStart;
+	Stats lastSecond;
+	Stats total;
+	double firstStart;
+
+	static void add(Stats& s, double work, double span);
+
+public:
+	FrameScheduler(double refreshRate = 60);
+	virtual ~FrameScheduler() {}
+
+	// seconds on a monotonic clock (from some arbitrary point)
+	static double now();
+
+	// 0 or less: no pacing
+	void setRefreshRate(double refreshRate);
+
+	// call at the start and at the end of drawing a frame
+	void frameBegin();
+	/* Returns in how many milliseconds the next frame is due if animating
+	 * (the caller sets a timer for it), or -1 if no timer is needed (not
+	 * animating, or there is one already).
+	 */
+	int frameEnd(bool animating);
+	// the timer set after frameEnd went off
+	void timerFired() { timerPending = false; }
+
+	Stats const& getLastSecond() const { return lastSecond; }
+	Stats const& getTotal() const { return total; }
+};
+
+#endif /* FRAMESCHEDULER_H_ */
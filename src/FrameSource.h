@@ -0,0 +1,31 @@
+/*
+ * FrameSource.h
+ * Something that can hand out the channel values of the frames of a clip,
+ * one row of values per frame, in the order the .bvh MOTION section has them.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef FRAMESOURCE_H_
+#define FRAMESOURCE_H_
+
+#include <vector>
+
+#include "myexceptions.h"
+
+class FrameSource {
+public:
+	virtual ~FrameSource() {}
+
+	virtual unsigned getFrameNum() const = 0;
+	virtual unsigned getChannelsPerFrame() const = 0;
+
+	// puts frames first, first+1, ... (wrapping around to 0 at the end)
+	// into out, one row of getChannelsPerFrame() values per frame
+	virtual void decodeFrames(unsigned first, unsigned count, std::vector<float>& out) const throw(ParseException) = 0;
+	// hint that these frames will be needed soon
+	virtual void readAhead(unsigned /*first*/, unsigned /*count*/) const {}
+};
+
+#endif /* FRAMESOURCE_H_ */
@@ -0,0 +1,58 @@
+/*
+ * MappedFile.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(std::string const& filename_) throw(ParseException) :
+		filename(filename_), data(NULL), length(0) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw ParseException("", "__ Unable to open '" + filename + "' __");
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw ParseException("", "__ Unable to stat '" + filename + "' __");
+	}
+	length = (size_t) st.st_size;
+
+	if (length > 0) {
+		void* m = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) {
+			close(fd);
+			throw ParseException("", "__ Unable to map '" + filename + "' into memory __");
+		}
+		data = (const char*) m;
+	}
+	close(fd); // the mapping keeps its own reference to the file
+}
+
+MappedFile::~MappedFile() {
+	if (data != NULL) munmap((void*) data, length);
+}
+
+// madvise wants page aligned addresses, so the range is widened to whole pages
+void MappedFile::advise(size_t from, size_t to, int advice) const {
+	if (data == NULL || from >= to) return;
+	if (to > length) to = length;
+	static const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	size_t alignedFrom = from - (from % page);
+	madvise((void*) (data + alignedFrom), to - alignedFrom, advice);
+}
+
+void MappedFile::willNeed(size_t from, size_t to) const {
+	advise(from, to, MADV_WILLNEED);
+}
+
+void MappedFile::dontNeed(size_t from, size_t to) const {
+	advise(from, to, MADV_DONTNEED);
+}
@@ -0,0 +1,46 @@
+/*
+ * MappedFile.h
+ * A read-only memory mapping of a whole file. The pages are only read in
+ * from the disk when they are touched, and the kernel is free to drop them
+ * again, so even huge files can be "opened" this way.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <string>
+#include <cstddef>
+
+#include "myexceptions.h"
+
+class MappedFile {
+private:
+	std::string filename;
+	const char* data;
+	size_t length;
+
+	// no copying -- the mapping would get unmapped twice
+	MappedFile(MappedFile const&);
+	MappedFile& operator=(MappedFile const&);
+
+	void advise(size_t from, size_t to, int advice) const;
+
+public:
+	MappedFile(std::string const& filename) throw(ParseException);
+	virtual ~MappedFile();
+
+	std::string const& getFileName() const { return filename; }
+	const char* begin() const { return data; }
+	const char* end() const { return data + length; }
+	size_t size() const { return length; }
+
+	// hint that bytes [from, to) will be read soon (starts reading them in)
+	void willNeed(size_t from, size_t to) const;
+	// hint that bytes [from, to) are not needed any more (drops them from our memory)
+	void dontNeed(size_t from, size_t to) const;
+};
+
+#endif /* MAPPEDFILE_H_ */
@@ -0,0 +1,59 @@
+/*
+ * MemoryUse.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "MemoryUse.h"
+#include "MeshSimplify.h"
+#include "Pose.h"
+#include "VertexStream.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void MemoryUse::begin() {
+	for (std::map<std::string, Account>::iterator it = accounts.begin(); it != accounts.end(); ++it) it->second.live = 0;
+	live = 0;
+}
+
+void MemoryUse::add(std::string const& subsystem, size_t bytes) {
+	std::map<std::string, Account>::iterator it = accounts.find(subsystem);
+	if (it == accounts.end()) {
+		it = accounts.insert(std::make_pair(subsystem, Account())).first;
+		order.push_back(subsystem);
+	}
+	it->second.live += bytes;
+	it->second.peak = std::max(it->second.peak, it->second.live);
+	live += bytes;
+	peak = std::max(peak, live);
+}
+
+void MemoryUse::print(std::ostream& out, std::string const& when) const {
+	out << "-- memory after " << when << " (KB, live / peak):" << std::endl;
+	char line[128];
+	for (unsigned i = 0; i < order.size(); ++i) {
+		Account const& a = accounts.find(order[i])->second;
+		snprintf(line, sizeof(line), "  %-22s %10.1f / %10.1f", order[i].c_str(), a.live / 1024.0, a.peak / 1024.0);
+		out << line << std::endl;
+	}
+	snprintf(line, sizeof(line), "  %-22s %10.1f / %10.1f", "total", live / 1024.0, peak / 1024.0);
+	out << line << std::endl;
+}
+
+size_t MemoryUse::bytesOf(Pose const& pose) {
+	size_t bytes = bytesOf(pose.matrices);
+	for (unsigned c = 0; c < 4; ++c) bytes += bytesOf(pose.rot[c]);
+	for (unsigned c = 0; c < 3; ++c) bytes += bytesOf(pose.pos[c]);
+	return bytes;
+}
+
+size_t MemoryUse::bytesOf(VertexStream const& stream) {
+	return bytesOf(stream.positionOf) + bytesOf(stream.normalOf) + bytesOf(stream.indices)
+			+ bytesOf(stream.positions) + bytesOf(stream.normals);
+}
+
+size_t MemoryUse::bytesOf(MeshLod const& lod) {
+	return bytesOf(lod.faceVertices) + bytesOf(lod.faceNormals) + bytesOf(lod.lodOf) + bytesOf(lod.stream);
+}
@@ -0,0 +1,73 @@
+/*
+ * MemoryUse.h
+ * How many bytes the big structures hold, by subsystem (the baked frames of
+ * the mesh, the motion tracks, the weights, ...), so it can be seen what a
+ * character costs and a budget set for it. The classes report their sizes
+ * themselves, from the capacities of their containers: what was asked from
+ * the allocator, without its overhead, and not what is only mapped from a
+ * compiled file. Besides what is held now (live), the most a subsystem held
+ * at any of the reports so far is kept (peak).
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef MEMORYUSE_H_
+#define MEMORYUSE_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+struct Pose;
+struct VertexStream;
+struct MeshLod;
+
+class MemoryUse {
+public:
+	struct Account {
+		size_t live, peak;
+		Account() : live(0), peak(0) {}
+	};
+
+private:
+	std::map<std::string, Account> accounts;
+	std::vector<std::string> order; // of the first add, what they are printed in
+	size_t live, peak; // all of them
+
+public:
+	MemoryUse() : live(0), peak(0) {}
+
+	// starts a new report: everything is 0 until added to again
+	void begin();
+	void add(std::string const& subsystem, size_t bytes);
+	size_t getLive() const { return live; }
+	size_t getPeak() const { return peak; }
+	// a table of the subsystems in KB, live and peak, after the stage when
+	void print(std::ostream& out, std::string const& when) const;
+
+	template <class T, class A>
+	static size_t bytesOf(std::vector<T, A> const& v) { return v.capacity() * sizeof(T); }
+	template <class T, class A>
+	static size_t bytesOf(std::vector<std::vector<T, A> > const& v) {
+		size_t bytes = v.capacity() * sizeof(std::vector<T, A>);
+		for (unsigned i = 0; i < v.size(); ++i) bytes += bytesOf(v[i]);
+		return bytes;
+	}
+	template <class T, int R, int C, int O, int MR, int MC>
+	static size_t bytesOf(Eigen::Matrix<T, R, C, O, MR, MC> const& m) { return m.size() * sizeof(T); }
+	template <class T, int O, class I>
+	static size_t bytesOf(Eigen::SparseMatrix<T, O, I> const& m) {
+		size_t bytes = m.data().allocatedSize() * (sizeof(T) + sizeof(I)) + (m.outerSize() + 1) * sizeof(I);
+		if (!m.isCompressed()) bytes += m.outerSize() * sizeof(I);
+		return bytes;
+	}
+	static size_t bytesOf(Pose const& pose);
+	static size_t bytesOf(VertexStream const& stream);
+	static size_t bytesOf(MeshLod const& lod);
+};
+
+#endif /* MEMORYUSE_H_ */
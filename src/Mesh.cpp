@@ -7,9 +7,16 @@
 
 #include "Mesh.h"
 #include "sparseMatrixHelp.h"
+#include "ObjLoader.h"
+#include "CompiledMesh.h"
+#include "MeshReorder.h"
+#include "Trace.h"
+#include "MemoryUse.h"
+#include "FrameScheduler.h"
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #ifdef __APPLE__
 #  include <GLUT/glut.h>
@@ -19,114 +26,129 @@
 #include <Eigen/Dense>
 
 
-void Mesh::loadModel(char* modelFile) throw (ParseException) {
-	// each vertex is consecutive 3 coord
-	std::vector<float> vertexCoords; // translated and scaled
+/* If there is an up to date compiled version of the file (file.objc) we use
+ * that, otherwise we parse the text and write the compiled version for next time.
+ */
+void Mesh::loadModel(char* modelFile, bool reorder) throw (ParseException) {
+	TRACE_SCOPE("load mesh");
+	if (debug::ison(debug::LITTLE)) std::cout << "Loading " << modelFile << std::endl;
 
-	std::vector<Point> vertices;
-	std::vector<Point> normals;
+	std::string compiledFile = CompiledMesh::siblingOf(modelFile);
+	if (CompiledMesh::isCompiledName(modelFile)) {
+		loadCompiled(modelFile);
+	} else if (CompiledMesh::isFresh(compiledFile, modelFile, reorder)) {
+		if (debug::ison(debug::LITTLE)) std::cout << "Using compiled mesh " << compiledFile << std::endl;
+		loadCompiled(compiledFile);
+	} else {
+		parseModel(modelFile, compiledFile, reorder);
+	}
+	if (debug::ison(debug::LITTLE))
+		std::cout << getNumVertices() << " vertices, " << normalsList[0].size()
+				<< " normals, " << getNumFaces() << " triangles" << std::endl;
+}
 
-	if (debug::ison(debug::LITTLE)) std::cout << "Loading " << modelFile << std::endl;
-	std::string line, lineType;
-	unsigned int vertex, normal;
-	float x, y, z;
-	std::ifstream myfile(modelFile);
-	if (myfile.is_open()) {
-		while (myfile.good()) {
-			getline(myfile, line);
-
-			if (line.size() == 0)
-				break;
-
-			// parse each line
-			std::stringstream ss(line);
-			ss >> lineType;
-			if (lineType.compare("v") == 0) {
-				ss >> x >> y >> z;
-				if (debug::ison(debug::EVERYTHING))
-					std::cout << "Created vertex " << x << " " << y << " " << z << std::endl;
-				vertices.push_back(Point(x, y, z));
-//				vertices.push_back(x);
-//				vertices.push_back(y);
-//				vertices.push_back(z);
-			} else if (lineType.compare("vn") == 0) {
-				ss >> x >> y >> z;
-				if (debug::ison(debug::EVERYTHING))
-					std::cout << "Created normal vector " << x << " " << y << " " << z << std::endl;
-				normalize(&x, &y, &z);
-				normals.push_back(Point(x, y, z));
-//				normals.push_back(x);
-//				normals.push_back(y);
-//				normals.push_back(z);
-			} else if (lineType.compare("f") == 0) {
-
-				Face oneFace;
-				std::string term;
-				if (debug::ison(debug::EVERYTHING))
-					std::cout << "face ";
-//				std::cout << ss.str();
-				while (ss >> term) {
-					// this should happen exactly 3 times here..
-					// now vertex looks like verNum//norNum
-					std::istringstream termStr(term);
-					std::string v, t, n;
-					std::getline(termStr, v, '/');
-					std::getline(termStr, t, '/');
-					std::getline(termStr, n, ' ');
-//					std::cout << "v=" << v << ", t=" << t << ", n=" << n << " ---->" ;
-					std::istringstream verStr(v), norStr(n);
-					verStr >> vertex;
-					norStr >> normal;
-					vertex--; normal--; // uses 1 based indices..
-					if (debug::ison(debug::EVERYTHING))
-						std::cout << "v" << vertex << " n" << normal << ", ";
-//					if (vertex*3 > vertices.size() || normal*3 > normals.size()) {
-					if (vertex > vertices.size() || normal > normals.size()) {
-						std::stringstream ss;
-						ss		<< std::endl
-								<< "__ The face '" << std::endl << "\t" << line
-								<< "' is referencing vertex " << vertex
-								<< "and normal " << normal
-								<< ", one of which has not been defined yet. (normals="
-								<< normals.size() << ", vertices="
-								<< vertices.size() << ") __"
-								<< std::endl;
-						throw ParseException("", ss.str());
-					}
-					oneFace.push_back(std::make_pair(vertex, normal));
-				}
-				faces.push_back(oneFace);
-				if (debug::ison(debug::EVERYTHING))
-					std::cout << std::endl;
-
-			} else {
-				if (debug::ison(debug::EVERYTHING))
-					std::cout << "Ignoring line: " << line << std::endl;
-			}
+void Mesh::parseModel(std::string const& modelFile, std::string const& compiledFile, bool reorder)
+		throw (ParseException) {
+	TRACE_SCOPE("parse obj");
+	ObjData obj;
+	objLoader::load(modelFile, obj);
+	if (reorder) {
+		TRACE_SCOPE("reorder");
+		const unsigned cache = meshReorder::DEFAULT_CACHE_SIZE;
+		float before = meshReorder::missRatio(obj.faceVertices.empty() ? NULL : &obj.faceVertices[0],
+				obj.faceVertices.size() / 3, obj.vertices.size(), cache);
+		meshReorder::apply(obj, originalVertexOfStore, originalFaceOfStore, cache);
+		if (debug::ison(debug::LITTLE)) {
+			std::cout << "Reordered the mesh: vertex cache misses per triangle "
+					<< before << " -> " << meshReorder::missRatio(obj.faceVertices.empty() ? NULL :
+							&obj.faceVertices[0], obj.faceVertices.size() / 3, obj.vertices.size(), cache)
+					<< std::endl;
 		}
-		myfile.close();
+	}
+	std::vector<Point> const& vertices = obj.vertices;
+	const unsigned faces = obj.faceVertices.size() / 3;
+
+	trianglesStore.reserve(faces);
+	for (unsigned f = 0; f < faces; ++f) {
+		unsigned const* vNums = &obj.faceVertices[3*f];
+		// create the triangles corresponding to the faces;
+		trianglesStore.push_back(TriangleRecord(vertices[vNums[0]],
+												vertices[vNums[1]],
+												vertices[vNums[2]]));
+	}
+	buildLaplacian(obj.faceVertices.empty() ? NULL : &obj.faceVertices[0], faces, vertices.size(), laplacianStore);
+
+	if (reorder) {
+		originalVertexOf = originalVertexOfStore.empty() ? NULL : &originalVertexOfStore[0];
+		originalFaceOf = originalFaceOfStore.empty() ? NULL : &originalFaceOfStore[0];
+	}
+	if (CompiledMesh::write(compiledFile, modelFile, obj,
+			trianglesStore.empty() ? NULL : &trianglesStore[0], laplacianStore,
+			originalVertexOf, originalFaceOf)) {
+		if (debug::ison(debug::LITTLE)) std::cout << "Wrote compiled mesh " << compiledFile << std::endl;
 	} else {
-		throw ParseException("", "__ Unable to open the specified .obj file __");
+		std::cerr << "Could not write compiled mesh " << compiledFile << " (continuing without)" << std::endl;
 	}
 
 	// actually save it
-	verticesList.push_back(vertices);
-	normalsList.push_back(normals);
+	verticesList.push_back(std::vector<Point>());
+	verticesList.back().swap(obj.vertices);
+	normalsList.push_back(std::vector<Point>());
+	normalsList.back().swap(obj.normals);
+	faceVerticesStore.swap(obj.faceVertices);
+	faceNormalsStore.swap(obj.faceNormals);
+
+	faceNum = faces;
+	if (faces > 0) {
+		faceVertices = &faceVerticesStore[0];
+		faceNormals = &faceNormalsStore[0];
+		triangles = &trianglesStore[0];
+	}
+	laplacian.reset(new Eigen::MappedSparseMatrix<double>(laplacianStore.rows(), laplacianStore.cols(),
+			laplacianStore.nonZeros(), laplacianStore.outerIndexPtr(),
+			laplacianStore.innerIndexPtr(), laplacianStore.valuePtr()));
+	findVertexOfOriginal();
+	stream.build(verticesList[0], normalsList[0], faceVertices, faceNormals, faceNum);
+}
+
+// the arrays are used where they are in the file, only the points get copied
+// (the rest of the program wants them as Points, and adds frames after them)
+void Mesh::loadCompiled(std::string const& compiledFile) throw (ParseException) {
+	TRACE_SCOPE("load compiled mesh");
+	compiled.reset(new CompiledMesh(compiledFile));
+	CompiledMesh const& c = *compiled;
+
+	float const* v = c.getVertices();
+	verticesList.push_back(std::vector<Point>(c.getVertexNum()));
+	for (unsigned i = 0; i < c.getVertexNum(); ++i)
+		verticesList.back()[i] = Point(v[3*i], v[3*i+1], v[3*i+2]);
+	float const* n = c.getNormals();
+	normalsList.push_back(std::vector<Point>(c.getNormalNum()));
+	for (unsigned i = 0; i < c.getNormalNum(); ++i)
+		normalsList.back()[i] = Point(n[3*i], n[3*i+1], n[3*i+2]);
+
+	faceNum = c.getTriangleNum();
+	faceVertices = c.getFaceVertices();
+	faceNormals = c.getFaceNormals();
+	triangles = c.getTriangles();
+	originalVertexOf = c.getOriginalVertexOf();
+	originalFaceOf = c.getOriginalFaceOf();
+	findVertexOfOriginal();
+	// (mapped read only; Eigen wants non const pointers but never writes through a const matrix)
+	laplacian.reset(new Eigen::MappedSparseMatrix<double>(c.getVertexNum(), c.getVertexNum(),
+			c.getLaplacianNonZeros(), const_cast<int*>(c.getLaplacianOuter()),
+			const_cast<int*>(c.getLaplacianInner()), const_cast<double*>(c.getLaplacianValues())));
+	stream.build(verticesList[0], normalsList[0], faceVertices, faceNormals, faceNum);
+}
 
+void Mesh::buildLaplacian(unsigned const* faceVertices, unsigned faceNum, unsigned vertexNum,
+		Eigen::SparseMatrix<double>& laplacian) {
+	TRACE_SCOPE("laplacian");
 	typedef Eigen::Triplet<double> Tr;
 	std::vector<Tr> adjTripletList;
-	adjTripletList.reserve(getNumVertices()*4);
-
-	for (std::vector<Face>::const_iterator it = faces.begin(); it != faces.end(); ++it) {
-		unsigned vNums[3];
-		vNums[0] = (*it)[0].first;
-		vNums[1] = (*it)[1].first;
-		vNums[2] = (*it)[2].first;
-		// create the triangles corresponding to the faces;
-		facesTr.push_back(Triangle(	vertices[vNums[0]],
-									vertices[vNums[1]],
-									vertices[vNums[2]]));
-
+	adjTripletList.reserve(faceNum*6);
+	for (unsigned f = 0; f < faceNum; ++f) {
+		unsigned const* vNums = &faceVertices[3*f];
 		// create  adjacency matrix; for each pair of i,j adj(vNums[i], vNums[j]) = 1;
 		for (unsigned i = 0; i < 3; ++i) {
 			for (unsigned j = 0; j < 3; ++j) {
@@ -135,42 +157,99 @@ void Mesh::loadModel(char* modelFile) throw (ParseException) {
 			}
 		}
 	}
+	Eigen::SparseMatrix<double> adjacency(vertexNum, vertexNum);
+	adjacency.setFromTriplets(adjTripletList.begin(), adjTripletList.end());
 
-	adjacencyMatrix.resize(getNumVertices(), getNumVertices());
-	adjacencyMatrix.reserve(adjTripletList.size()*1.5);
-	adjacencyMatrix.setFromTriplets(adjTripletList.begin(), adjTripletList.end());
+	Eigen::VectorXd ones = Eigen::VectorXd::Ones(adjacency.rows());
+	Eigen::VectorXd res = adjacency*ones;
 
-	findLaplacian();
+	Eigen::SparseMatrix<double> deltaM = delta(res);
 
+	laplacian = deltaM - adjacency;
+	laplacian.makeCompressed();
 }
 
-void Mesh::findLaplacian() {
-	Eigen::VectorXd ones = Eigen::VectorXd::Ones(getNumVertices());
-	Eigen::VectorXd res = adjacencyMatrix*ones;
+void Mesh::buildLods(unsigned levels, float ratio) {
+	TRACE_SCOPE("lods");
+	std::vector<Point> const& points = verticesList[0];
+	// the size on the screen is measured at the middle of the bounding box
+	Point lo = points.empty() ? Point() : points[0], hi = lo;
+	for (unsigned v = 0; v < points.size(); ++v) {
+		lo = Point(std::min(lo.x(), points[v].x()), std::min(lo.y(), points[v].y()), std::min(lo.z(), points[v].z()));
+		hi = Point(std::max(hi.x(), points[v].x()), std::max(hi.y(), points[v].y()), std::max(hi.z(), points[v].z()));
+	}
+	boundCentre = (lo + hi) * 0.5f;
+
+	const double start = FrameScheduler::now();
+	lods.clear();
+	buffers.clear();
+	colorsStream = NULL;
+	meshSimplify::buildChain(points, faceVertices, faceNormals, faceNum, levels, ratio, lods);
+	for (unsigned i = 0; i < lods.size(); ++i) {
+		MeshLod& lod = lods[i];
+		lod.stream.build(points, normalsList[0], &lod.faceVertices[0], &lod.faceNormals[0], lod.getTriangleNum());
+	}
+	const double took = FrameScheduler::now() - start;
+	if (debug::ison(debug::LITTLE)) {
+		std::cout << "Made " << lods.size() << " levels of detail in " << took << "s:";
+		for (unsigned i = 0; i < lods.size(); ++i)
+			std::cout << " " << lods[i].getTriangleNum() << " (error " << lods[i].error << ")";
+		std::cout << std::endl;
+	}
+}
 
-	Eigen::SparseMatrix<double> deltaM = delta(res);
+unsigned Mesh::pickLod(float worldPerPixel) const {
+	unsigned level = 0;
+	while (level < lods.size() && lods[level].error <= worldPerPixel) level++;
+	return level;
+}
 
-	laplacian = deltaM - adjacencyMatrix;
+void Mesh::nextLod() {
+	forcedLod++;
+	if (forcedLod >= (int) getLodNum()) forcedLod = -1;
+	if (forcedLod < 0) {
+		std::cout << "Level of detail picked by size" << std::endl;
+	} else {
+		std::cout << "Level of detail " << forcedLod << " ("
+				<< (forcedLod == 0 ? getNumFaces() : lods[forcedLod-1].getTriangleNum()) << " triangles)" << std::endl;
+	}
+}
+
+void Mesh::findVertexOfOriginal() {
+	vertexOfOriginal.clear();
+	if (!originalVertexOf) return;
+	vertexOfOriginal.resize(verticesList[0].size());
+	for (unsigned v = 0; v < vertexOfOriginal.size(); ++v) vertexOfOriginal[originalVertexOf[v]] = v;
 }
 
 
+// the adjacency is the Laplacian without its diagonal (and negated)
 void Mesh::printAdjMatrix(std::ostream& out) const {
-	// TODO slow way -- see online tutorial on sparse matrices "Iterating over the nonzero coefficients"
-	for (int i = 0; i < adjacencyMatrix.rows(); ++i) {
-		out << i;
-		for (int j = 0; j < adjacencyMatrix.cols(); ++j) {
-			if (abs(adjacencyMatrix.coeff(i,j)) > EPS) out << " " << j;
+	Eigen::MappedSparseMatrix<double> const& lap = *laplacian;
+	std::vector<unsigned> adjacent;
+	for (int o = 0; o < lap.rows(); ++o) {
+		const int i = getIndexOfOriginal(o);
+		out << o;
+		// symmetric, so column i has the entries of row i
+		adjacent.clear();
+		for (Eigen::MappedSparseMatrix<double>::InnerIterator it(lap, i); it; ++it) {
+			if (it.index() != i && abs(it.value()) > EPS) adjacent.push_back(getOriginalIndex(it.index()));
 		}
+		std::sort(adjacent.begin(), adjacent.end());
+		for (unsigned k = 0; k < adjacent.size(); ++k) out << " " << adjacent[k];
 		out << std::endl;
 	}
 }
 
 void Mesh::printLaplacian(std::ostream& out) const {
 	// TODO slow way -- see online tutorial on sparse matrices "Iterating over the nonzero coefficients"
-	for (int i = 0; i < laplacian.rows(); ++i) {
-		out << i;
-		for (int j = 0; j < laplacian.cols(); ++j) {
-			if (abs(laplacian.coeff(i,j)) > EPS) out << " " << j << " " << laplacian.coeff(i,j);
+	Eigen::MappedSparseMatrix<double> const& lap = *laplacian;
+	for (int o = 0; o < lap.rows(); ++o) {
+		const int i = getIndexOfOriginal(o);
+		out << o;
+		for (int oj = 0; oj < lap.cols(); ++oj) {
+			const int j = getIndexOfOriginal(oj);
+			if (abs(lap.coeff(i,j)) > EPS) out << " " << oj << " " << lap.coeff(i,j);
 		}
 		out << std::endl;
 	}
@@ -179,18 +258,25 @@ void Mesh::printLaplacian(std::ostream& out) const {
 void Mesh::printOrigMesh(std::ostream& out) const {
 	out << std::fixed;
 	out.precision(6);
-	for (std::vector<Point>::const_iterator it = verticesList[0].begin(); it != verticesList[0].end(); ++it) {
-		out << "v " << it->x() << " " << it->y() << " " << it->z() << std::endl;
+	for (unsigned o = 0; o < verticesList[0].size(); ++o) {
+		Point const& v = verticesList[0][getIndexOfOriginal(o)];
+		out << "v " << v.x() << " " << v.y() << " " << v.z() << std::endl;
 	}
 	for (std::vector<Point>::const_iterator it = normalsList[0].begin(); it != normalsList[0].end(); ++it) {
 		out << "v " << it->x() << " " << it->y() << " " << it->z() << std::endl;
 	}
 
-	for (std::vector<Face>::const_iterator it = faces.begin(); it != faces.end(); ++it) {
+	// in the order of the file, if the mesh was reordered
+	std::vector<unsigned> faceOfOriginal;
+	if (originalFaceOf) {
+		faceOfOriginal.resize(getNumFaces());
+		for (unsigned f = 0; f < getNumFaces(); ++f) faceOfOriginal[originalFaceOf[f]] = f;
+	}
+	for (unsigned o = 0; o < getNumFaces(); ++o) {
+		const unsigned f = originalFaceOf ? faceOfOriginal[o] : o;
 		out << "f";
-		// std::vector< std::pair<unsigned, unsigned> >
-		for (unsigned i = 0; i < it->size(); ++i) {
-			out << " " << (*it)[i].first + 1 << "//" << (*it)[i].second + 1;
+		for (unsigned i = 3*f; i < 3*f + 3; ++i) {
+			out << " " << getOriginalIndex(faceVertices[i]) + 1 << "//" << faceNormals[i] + 1;
 			// need to add those 1s because it's 1 indexed!
 		}
 		out << std::endl;
@@ -198,10 +284,10 @@ void Mesh::printOrigMesh(std::ostream& out) const {
 }
 
 bool Mesh::intersects(LineSegment const & l) {
-	for (std::vector<Triangle>::const_iterator it = facesTr.begin();
-							it != facesTr.end(); ++it) {
-		if (intersectLineSegWithTriangle(l, *it)) {
-			intersections.push_back(std::make_pair(l, *it));
+	for (unsigned f = 0; f < faceNum; ++f) {
+		Triangle t = triangles[f].toTriangle();
+		if (intersectLineSegWithTriangle(l, t)) {
+			intersections.push_back(std::make_pair(l, t));
 			nextIntersection(false);
 			return true;
 		}
@@ -211,8 +297,16 @@ bool Mesh::intersects(LineSegment const & l) {
 
 
 void Mesh::display(int frame) const { // note default -1
-	frame++;
+	draw(frame + 1, NULL);
+}
+
+void Mesh::display(std::vector<Point> const& points) const {
+	draw(-1, &points);
+}
 
+// frame is the index into verticesList, or the positions are the points given
+void Mesh::draw(int frame, std::vector<Point> const* points) const {
+	TRACE_SCOPE("draw mesh");
 	glLineWidth(1);
 	glColor3f(1.0, 1.0, 1.0);
 	if (!wireFrame) {
@@ -225,40 +319,55 @@ void Mesh::display(int frame) const { // note default -1
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	}
 
-	// TODO optimize the selected stuff! maybe boost unordered_set
-//	unsigned fCount = 0;
-	for (std::vector<Face>::const_iterator it = faces.begin(); it != faces.end(); ++it) {
-//		if (frame != 0) std::cout << "face " << fCount++ << std::endl;
-		glBegin(GL_TRIANGLES);
-			for (unsigned vn = 0; vn < 3; ++vn) { // each face is a triangle
-				Point n = normalsList[0][(*it)[vn].second]; // TODO later make this based on frame too? normals not calculated now.. see Animation.cpp precalculate..
-				Point v = verticesList[frame][(*it)[vn].first];
-				if (selected->find( (*it)[vn].first ) != selected->end() ) {
-					glColor4f(1.0, 0.0, 0.0, 0.5); // red
-				} else {
-					glColor4f(1.0, 1.0, 1.0, 0.5);
-				}
-				glNormal3f(n.x(), n.y(), n.z());
-				glVertex3f(v.x(), v.y(), v.z());
-			}
-		glEnd();
-		if (debug::ison(debug::EVERYTHING)) {
-			// now also draw the normals..
-			glColor3f(0.0, 0.0, 1.0);
-			for (unsigned vn = 0; vn < 3; ++vn) { // each face is a triangle
-				Point n = normalsList[0][(*it)[vn].second];// TODO later make this based on frame too? normals not calculated now.. see Animation.cpp precalculate..
-				Point v = verticesList[frame][(*it)[vn].first];
-				glBegin(GL_LINES);
-					glVertex3f(v.x(), v.y(), v.z());
-					glVertex3f(v.x()+n.x(), v.y()+n.y(), v.z()+n.z());
-				glEnd();
-			}
+	// which level of detail: the coarsest that is off by less than a pixel
+	// where the middle of the mesh is (no GL state is read for it, that would stall)
+	int level = forcedLod;
+	if (level < 0 && !lods.empty() && viewScale > 0) level = pickLod(1.0f / viewScale);
+	if (level < 0) level = 0;
+	VertexStream const& stream = (level > 0) ? lods[level-1].stream : this->stream;
+
+	if (stream.getTriangleNum() > 0 && MeshBuffers::supported()) {
+		if (buffers.size() != getLodNum()) buffers.assign(getLodNum(), boost::shared_ptr<MeshBuffers>());
+		if (!buffers[level]) buffers[level].reset(new MeshBuffers(stream));
+		MeshBuffers& b = *buffers[level];
+		// only what changed goes to the card
+		if (points || !b.hasPositionsOf(frame, framesVersion)) {
+			b.setPositions(findPositions(stream, frame, points), frame, framesVersion);
 		}
+		if (!b.hasColorsOf(highlightVersion)) b.setColors(findColors(stream), highlightVersion);
+		b.draw();
+	} else if (stream.getTriangleNum() > 0) {
+		// no buffer objects: from our memory, all of it every time
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, findPositions(stream, frame, points));
+		// TODO later make the normals based on frame too? normals not calculated now.. see Animation.cpp precalculate..
+		glNormalPointer(GL_FLOAT, 0, &stream.normals[0]);
+		glColorPointer(4, GL_FLOAT, 0, findColors(stream));
+		glDrawElements(GL_TRIANGLES, stream.indices.size(), GL_UNSIGNED_INT, &stream.indices[0]);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		MeshBuffers::stats.drawCalls++;
+		MeshBuffers::countUpload(stream.indices.size() * sizeof(unsigned) + 10 * stream.getVertexNum() * sizeof(float));
+	}
+
+	if (debug::ison(debug::EVERYTHING)) {
+		// now also draw the normals..
+		glColor3f(0.0, 0.0, 1.0);
+		float const* positions = findPositions(stream, frame, points);
+		glBegin(GL_LINES);
+		for (unsigned r = 0; r < stream.getVertexNum(); ++r) {
+			float const* v = &positions[3*r];
+			float const* n = &stream.normals[3*r];
+			glVertex3f(v[0], v[1], v[2]);
+			glVertex3f(v[0]+n[0], v[1]+n[1], v[2]+n[2]);
+		}
+		glEnd();
 	}
 
 	if (selectedIntersection < intersections.size()) {
-		GLint polyMode;
-		glGetIntegerv(GL_POLYGON_MODE, &polyMode);
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		Triangle t = intersections[selectedIntersection].second;
 		LineSegment l = intersections[selectedIntersection].first;
@@ -279,10 +388,54 @@ void Mesh::display(int frame) const { // note default -1
 			glVertex3f(e2.x(), e2.y(), e2.z());
 		glEnd();
 		glLineWidth(1);
-		glPolygonMode(GL_FRONT_AND_BACK, polyMode);
+		glPolygonMode(GL_FRONT_AND_BACK, wireFrame ? GL_LINE : GL_FILL); // as set above
 	}
 }
 
+// the positions of the original pose are in the stream already, for the
+// other frames (or points) the render vertices pick up their skinning vertex
+float const* Mesh::findPositions(VertexStream const& stream, int frame, std::vector<Point> const* points) const {
+	if ((frame == 0 && !points) || stream.positions.empty()) return stream.positions.empty() ? NULL : &stream.positions[0];
+	framePositions.resize(stream.positions.size());
+	stream.gatherPositions(points ? *points : verticesList[frame], &framePositions[0]);
+	return &framePositions[0];
+}
+
+// only filled again when the highlight (or the level drawn) changes
+float const* Mesh::findColors(VertexStream const& stream) const {
+	if (colorsStream != &stream || colorsVersion != highlightVersion) {
+		colors.resize(4 * stream.getVertexNum());
+		for (unsigned r = 0; r < stream.getVertexNum(); ++r) {
+			const float h = highlight.empty() ? 0.0f : highlight[stream.positionOf[r]];
+			colors[4*r] = 1.0;
+			colors[4*r+1] = colors[4*r+2] = 1.0f - h; // the redder the higher
+			colors[4*r+3] = 0.5;
+		}
+		colorsStream = &stream;
+		colorsVersion = highlightVersion;
+	}
+	return colors.empty() ? NULL : &colors[0];
+}
+
+void Mesh::reportMemory(MemoryUse& use) const {
+	// frame 0 is the mesh as read, the ones after it are baked (or the live one)
+	size_t frames = (verticesList.capacity() + normalsList.capacity()) * sizeof(std::vector<Point>);
+	for (unsigned f = 1; f < verticesList.size(); ++f) frames += MemoryUse::bytesOf(verticesList[f]);
+	for (unsigned f = 1; f < normalsList.size(); ++f) frames += MemoryUse::bytesOf(normalsList[f]);
+	use.add("mesh frames", frames);
+	size_t mesh = MemoryUse::bytesOf(faceVerticesStore) + MemoryUse::bytesOf(faceNormalsStore)
+			+ MemoryUse::bytesOf(trianglesStore) + MemoryUse::bytesOf(originalVertexOfStore)
+			+ MemoryUse::bytesOf(originalFaceOfStore) + MemoryUse::bytesOf(vertexOfOriginal) + MemoryUse::bytesOf(highlight);
+	if (!verticesList.empty()) mesh += MemoryUse::bytesOf(verticesList[0]);
+	if (!normalsList.empty()) mesh += MemoryUse::bytesOf(normalsList[0]);
+	use.add("mesh", mesh);
+	use.add("laplacian", MemoryUse::bytesOf(laplacianStore));
+	use.add("mesh drawing", MemoryUse::bytesOf(stream) + MemoryUse::bytesOf(framePositions) + MemoryUse::bytesOf(colors));
+	size_t lodBytes = MemoryUse::bytesOf(lods);
+	for (unsigned l = 0; l < lods.size(); ++l) lodBytes += MemoryUse::bytesOf(lods[l]);
+	use.add("lods", lodBytes);
+	use.add("intersections", MemoryUse::bytesOf(intersections));
+}
 
 Mesh::~Mesh() {
 }
@@ -15,9 +15,12 @@
 
 #include "tools.h"
 #include "geometry.h"
+#include "VertexStream.h"
+#include "MeshSimplify.h"
+#include "MeshBuffers.h"
 
-// each face is a list of vertex//normal pairs
-typedef std::vector< std::pair< unsigned, unsigned> > Face;
+class CompiledMesh;
+class MemoryUse;
 
 class Mesh {
 private:
@@ -25,23 +28,68 @@ private:
 
 	std::vector< std::vector<Point> > verticesList; // as read from the file
 	std::vector< std::vector<Point> > normalsList; // as read from the file
-	std::vector<Face> faces;
 
-	bool wireFrame;
-
-	// for speeding things up
-	std::vector<Triangle> facesTr; // the original ones!
+	// the triangles (3 vertex//normal index pairs each), the triangle records
+	// and the Laplacian are used right from the compiled mesh if we have one,
+	// otherwise they point into the stores below
+	boost::shared_ptr<CompiledMesh> compiled;
+	unsigned faceNum;
+	unsigned const* faceVertices;
+	unsigned const* faceNormals;
+	TriangleRecord const* triangles; // the original ones!
+	boost::shared_ptr< Eigen::MappedSparseMatrix<double> > laplacian;
+
+	std::vector<unsigned> faceVerticesStore;
+	std::vector<unsigned> faceNormalsStore;
+	std::vector<TriangleRecord> trianglesStore;
+	Eigen::SparseMatrix<double> laplacianStore;
+
+	// if the mesh was reordered (see MeshReorder.h): the .obj number of each
+	// vertex and triangle, else NULL. vertexOfOriginal goes the other way
+	unsigned const* originalVertexOf;
+	unsigned const* originalFaceOf;
+	std::vector<unsigned> originalVertexOfStore;
+	std::vector<unsigned> originalFaceOfStore;
+	std::vector<unsigned> vertexOfOriginal;
+
+	// what gets drawn: the unique vertex//normal pairs of the faces
+	VertexStream stream;
+	// the positions of the frame being drawn and the colour of each render vertex,
+	// kept around so display doesn't allocate
+	mutable std::vector<float> framePositions;
+	mutable std::vector<float> colors;
+	mutable VertexStream const* colorsStream; // what colors was filled for
+	mutable unsigned colorsVersion;
+	// the buffer objects of each level (made when first drawn), and what tells
+	// if the frames or the selection changed since they were filled
+	mutable std::vector< boost::shared_ptr<MeshBuffers> > buffers;
+	unsigned framesVersion;
+	unsigned highlightVersion;
+
+	// coarser versions of the mesh, lods[0] is the finest of them
+	std::vector<MeshLod> lods;
+	int forcedLod; // -1: picked by the size on the screen, 0: the full mesh, i: lods[i-1]
+	float viewScale; // pixels per world unit where the mesh is drawn, 0: not known (the full mesh)
+	Point boundCentre; // of the bounding box, where the size on the screen is measured
 
-	Eigen::SparseMatrix<double> adjacencyMatrix;
-	Eigen::SparseMatrix<double> laplacian;
+	bool wireFrame;
 
-	// optional
-	boost::shared_ptr< std::set<unsigned> > selected;
+	// how much each vertex is highlighted (0: not, 1: all red), empty if none is
+	std::vector<float> highlight;
 
 	// TODO only for testing
 	std::vector<std::pair<LineSegment, Triangle> > intersections;
 
-	void findLaplacian();
+	// no copying -- the arrays would point into the other one
+	Mesh(Mesh const&);
+	Mesh& operator=(Mesh const&);
+
+	void parseModel(std::string const& modelFile, std::string const& compiledFile, bool reorder) throw (ParseException);
+	void loadCompiled(std::string const& compiledFile) throw (ParseException);
+	void findVertexOfOriginal();
+	float const* findPositions(VertexStream const& stream, int frame, std::vector<Point> const* points) const;
+	void draw(int frame, std::vector<Point> const* points) const;
+	float const* findColors(VertexStream const& stream) const;
 public:
 	unsigned selectedIntersection; // == intersections.size() means none
 	void nextIntersection(bool message = true) {
@@ -57,24 +105,61 @@ public:
 		}
 	}
 
-	Mesh() : wireFrame(true), selectedIntersection(0) {
+	Mesh() : faceNum(0), faceVertices(NULL), faceNormals(NULL), triangles(NULL),
+			originalVertexOf(NULL), originalFaceOf(NULL), colorsStream(NULL), colorsVersion(0),
+			framesVersion(0), highlightVersion(0),
+			forcedLod(-1), viewScale(0), wireFrame(true), selectedIntersection(0) {
 		lightPos[0] = 0.0;
 		lightPos[1] = 10.5;
 		lightPos[2] = 13.0;
 		lightPos[3] = 1.0;
-
-		selected.reset( new std::set<unsigned> );
 	}
-	void loadModel(char* inputfile) throw (ParseException);
+	// with reorder the triangles and vertices are put in a cache friendly order
+	void loadModel(char* inputfile, bool reorder = false) throw (ParseException);
 	void display(int = -1) const;
+	// draws the mesh with its vertices at points (e.g. one of a crowd, skinned elsewhere)
+	void display(std::vector<Point> const& points) const;
+
+	/* Makes up to levels coarser versions of the mesh, each with about ratio
+	 * times the triangles of the one before. display picks one of them
+	 * depending on how big the mesh is on the screen.
+	 */
+	void buildLods(unsigned levels, float ratio = 0.25);
+	unsigned getLodNum() const { return lods.size() + 1; } // with the full mesh
+	// the coarsest level (0 is the full mesh) that is off by less than worldPerPixel
+	unsigned pickLod(float worldPerPixel) const;
+	// cycles through the levels (and picking by size)
+	void nextLod();
+	/* How big the mesh is on the screen for the next displays, in pixels per
+	 * world unit at getBoundCentre (see Camera::pixelsPerUnit). The level of
+	 * detail is picked by it; set it once per frame (or per copy of the mesh).
+	 */
+	void setViewScale(float pixelsPerUnit) { viewScale = pixelsPerUnit; }
+	Point const& getBoundCentre() const { return boundCentre; }
 	void printOrigMesh(std::ostream& out) const;
 	void printAdjMatrix(std::ostream& out) const;
 	void printLaplacian(std::ostream& out) const;
-	Eigen::SparseMatrix<double> const& getLaplacian() const { return laplacian; }
+	Eigen::MappedSparseMatrix<double> const& getLaplacian() const { return *laplacian; }
+	// the Laplacian of the adjacency of faceNum triangles (3 vertices each), what loading a mesh builds
+	static void buildLaplacian(unsigned const* faceVertices, unsigned faceNum, unsigned vertexNum,
+			Eigen::SparseMatrix<double>& laplacian);
 	virtual ~Mesh();
 	unsigned getNumVertices() const { return verticesList[0].size(); }
-	void setSelectedVerts(boost::shared_ptr< std::set<unsigned> > const& sel) {
-		selected = sel;
+	unsigned getNumFaces() const { return faceNum; }
+	unsigned const* getFaceVertices() const { return faceVertices; } // 3 per triangle
+	TriangleRecord const* getTriangleRecords() const { return triangles; }
+	VertexStream const& getStream() const { return stream; } // of the full mesh
+	// the vertex numbers of the .obj file, which is what the outputs use
+	bool isReordered() const { return originalVertexOf != NULL; }
+	unsigned getOriginalIndex(unsigned v) const { return originalVertexOf ? originalVertexOf[v] : v; }
+	unsigned getIndexOfOriginal(unsigned o) const { return originalVertexOf ? vertexOfOriginal[o] : o; }
+	/* A value in [0, 1] per vertex, the higher the redder it's drawn (the
+	 * vertices of a bone get 1, weights are shown as they are). Takes the
+	 * contents of values, an empty one switches the highlighting off.
+	 */
+	void setHighlight(std::vector<float>& values) {
+		highlight.swap(values);
+		highlightVersion++;
 	}
 
 	bool intersects(LineSegment const & l);
@@ -90,12 +175,37 @@ public:
 	void addFrame(std::vector<Point> const& verts, std::vector<Point> const& normals) {
 		verticesList.push_back(verts);
 		normalsList.push_back(normals);
+		framesVersion++;
 		if (debug::ison(debug::EVERYTHING)) {
 			std::cout << "Now " << verticesList.size() << "," << normalsList.size() << " frames in the Mesh." << std::endl;
 		}
 	}
 
+	// the original (0) and the baked frames after it
+	unsigned getFrameNum() const { return verticesList.size(); }
+	std::vector<Point> const& getFrame(unsigned f) const { return verticesList[f]; }
+	// drops the frames after the original
+	void clearFrames() {
+		if (verticesList.size() < 2) return;
+		verticesList.resize(1);
+		normalsList.resize(1);
+		framesVersion++;
+	}
+
+	// for when frames are not baked: the one frame after the original is overwritten each time
+	void setLiveFrame(std::vector<Point> const& verts) {
+		if (verticesList.size() < 2) {
+			addFrame(verts, std::vector<Point>());
+		} else {
+			verticesList[1] = verts;
+			framesVersion++;
+		}
+	}
+
 	void setWireFrame(bool val) { wireFrame = val; }
+
+	// adds the bytes of the frames, the geometry, the Laplacian, ... to use
+	void reportMemory(MemoryUse& use) const;
 };
 
 #endif /* MESH_H_ */
@@ -0,0 +1,98 @@
+/*
+ * MeshBuffers.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+// the buffer object functions are in glext.h
+#define GL_GLEXT_PROTOTYPES
+#include "MeshBuffers.h"
+
+#include <cstdlib>
+
+MeshBuffers::Stats MeshBuffers::stats = {0, 0, 0};
+bool MeshBuffers::disabled = false;
+
+bool MeshBuffers::supported() {
+	static int answer = -1; // don't know yet
+	if (answer < 0) {
+		const char* version = (const char*) glGetString(GL_VERSION);
+		if (version == NULL) return false; // no context yet, ask again later
+		const char* dot = version;
+		while (*dot != '\0' && *dot != '.') ++dot;
+		const int major = atoi(version);
+		const int minor = (*dot == '.') ? atoi(dot + 1) : 0;
+		answer = (!disabled && (major > 1 || (major == 1 && minor >= 5))) ? 1 : 0;
+	}
+	return answer == 1;
+}
+
+MeshBuffers::MeshBuffers(VertexStream const& stream) :
+		indexNum(stream.indices.size()), vertexNum(stream.getVertexNum()),
+		positionsFrame(-1), positionsVersion(0), hasColors(false), colorsVersion(0) {
+	GLuint ids[4];
+	glGenBuffers(4, ids);
+	indexBuffer = ids[0];
+	normalBuffer = ids[1];
+	positionBuffer = ids[2];
+	colorBuffer = ids[3];
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexNum * sizeof(unsigned),
+			indexNum ? &stream.indices[0] : NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	countUpload(indexNum * sizeof(unsigned));
+
+	glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+	glBufferData(GL_ARRAY_BUFFER, 3 * vertexNum * sizeof(float),
+			vertexNum ? &stream.normals[0] : NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	countUpload(3 * vertexNum * sizeof(float));
+}
+
+MeshBuffers::~MeshBuffers() {
+	GLuint ids[4] = {indexBuffer, normalBuffer, positionBuffer, colorBuffer};
+	glDeleteBuffers(4, ids);
+}
+
+void MeshBuffers::setPositions(float const* positions, int frame, unsigned version) {
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+	// a new store each time (orphaning the old one), then filled
+	glBufferData(GL_ARRAY_BUFFER, 3 * vertexNum * sizeof(float), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * vertexNum * sizeof(float), positions);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	countUpload(3 * vertexNum * sizeof(float));
+	positionsFrame = frame;
+	positionsVersion = version;
+}
+
+void MeshBuffers::setColors(float const* colors, unsigned version) {
+	glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+	glBufferData(GL_ARRAY_BUFFER, 4 * vertexNum * sizeof(float), colors, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	countUpload(4 * vertexNum * sizeof(float));
+	hasColors = true;
+	colorsVersion = version;
+}
+
+void MeshBuffers::draw() const {
+	if (indexNum == 0) return;
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+	glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+	glNormalPointer(GL_FLOAT, 0, NULL);
+	glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+	glColorPointer(4, GL_FLOAT, 0, NULL);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glDrawElements(GL_TRIANGLES, indexNum, GL_UNSIGNED_INT, NULL);
+	stats.drawCalls++;
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
@@ -0,0 +1,74 @@
+/*
+ * MeshBuffers.h
+ * The buffer objects a VertexStream is drawn from, if the GL has them (1.5
+ * and up). The indices and the normals are put on the card once, the colours
+ * when the selection changes and the positions when the frame does. The
+ * positions go into a fresh store every time (the old one is orphaned), so the
+ * driver doesn't have to wait for the draw that still uses it. Drawing is one
+ * glDrawElements.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef MESHBUFFERS_H_
+#define MESHBUFFERS_H_
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include "VertexStream.h"
+
+class MeshBuffers {
+public:
+	// what was sent to the GL since the last reset (by all meshes, either way of drawing)
+	struct Stats {
+		unsigned drawCalls;
+		unsigned uploads;
+		unsigned long uploadedBytes;
+	};
+	static Stats stats;
+	static void resetStats() { stats.drawCalls = stats.uploads = 0; stats.uploadedBytes = 0; }
+	static void countUpload(unsigned long bytes) { stats.uploads++; stats.uploadedBytes += bytes; }
+
+	// true if buffer objects can be used (a GL context has to be current)
+	static bool supported();
+	// to draw from client memory even if there are buffer objects (call before drawing)
+	static void disable() { disabled = true; }
+
+private:
+	static bool disabled;
+
+	GLuint indexBuffer, normalBuffer, positionBuffer, colorBuffer;
+	unsigned indexNum;
+	unsigned vertexNum;
+	// what is in the position and colour buffers
+	int positionsFrame;
+	unsigned positionsVersion;
+	bool hasColors;
+	unsigned colorsVersion;
+
+	// the buffers belong to this one
+	MeshBuffers(MeshBuffers const&);
+	MeshBuffers& operator=(MeshBuffers const&);
+
+public:
+	// uploads the indices and the normals
+	MeshBuffers(VertexStream const& stream);
+	virtual ~MeshBuffers();
+
+	// frame and version tell the positions apart (see Mesh)
+	bool hasPositionsOf(int frame, unsigned version) const {
+		return (positionsFrame == frame && positionsVersion == version);
+	}
+	void setPositions(float const* positions, int frame, unsigned version);
+	bool hasColorsOf(unsigned version) const { return (hasColors && colorsVersion == version); }
+	void setColors(float const* colors, unsigned version);
+
+	void draw() const;
+};
+
+#endif /* MESHBUFFERS_H_ */
@@ -0,0 +1,143 @@
+/*
+ * MeshReorder.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "MeshReorder.h"
+
+static const unsigned NONE = ~0u;
+
+// the triangles around each vertex, in CSR form (a triangle with a repeated
+// vertex is listed once for each of its corners there)
+static void findVertexTriangles(unsigned const* faceVertices, unsigned triangleNum, unsigned vertexNum,
+		std::vector<unsigned>& starts, std::vector<unsigned>& tris) {
+	starts.assign(vertexNum + 1, 0);
+	for (unsigned c = 0; c < 3 * triangleNum; ++c) starts[faceVertices[c] + 1]++;
+	for (unsigned v = 0; v < vertexNum; ++v) starts[v+1] += starts[v];
+	tris.resize(3 * triangleNum);
+	std::vector<unsigned> fill(starts.begin(), starts.end() - 1);
+	for (unsigned c = 0; c < 3 * triangleNum; ++c) tris[fill[faceVertices[c]]++] = c / 3;
+}
+
+void meshReorder::orderTriangles(unsigned const* faceVertices, unsigned triangleNum, unsigned vertexNum,
+		unsigned cacheSize, std::vector<unsigned>& order) {
+	std::vector<unsigned> starts, tris;
+	findVertexTriangles(faceVertices, triangleNum, vertexNum, starts, tris);
+
+	std::vector<unsigned> live(vertexNum); // corners not emitted yet
+	for (unsigned v = 0; v < vertexNum; ++v) live[v] = starts[v+1] - starts[v];
+	std::vector<unsigned> cacheTime(vertexNum, 0);
+	std::vector<bool> emitted(triangleNum, false);
+	std::vector<unsigned> deadEnds; // recently used vertices, to go back to
+	std::vector<unsigned> candidates;
+	unsigned time = cacheSize + 1;
+	unsigned cursor = 0;
+
+	order.clear();
+	order.reserve(triangleNum);
+	unsigned fan = 0;
+	while (fan != NONE && vertexNum > 0) {
+		// emit all the triangles around fan
+		candidates.clear();
+		for (unsigned i = starts[fan]; i < starts[fan+1]; ++i) {
+			const unsigned t = tris[i];
+			if (emitted[t]) continue;
+			emitted[t] = true;
+			order.push_back(t);
+			for (unsigned k = 0; k < 3; ++k) {
+				const unsigned v = faceVertices[3*t + k];
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+			}
+		}
+
+		// next: the candidate that will still be in the cache after its fan,
+		// and has been there the longest
+		fan = NONE;
+		int best = -1;
+		for (unsigned i = 0; i < candidates.size(); ++i) {
+			const unsigned v = candidates[i];
+			if (live[v] == 0) continue;
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize) priority = time - cacheTime[v];
+			if (priority > best) {
+				best = priority;
+				fan = v;
+			}
+		}
+		if (fan != NONE) continue;
+
+		// dead end: the latest used vertex with triangles left, or the next in the input
+		while (!deadEnds.empty() && fan == NONE) {
+			if (live[deadEnds.back()] > 0) fan = deadEnds.back();
+			deadEnds.pop_back();
+		}
+		while (fan == NONE && cursor < vertexNum) {
+			if (live[cursor] > 0) fan = cursor;
+			cursor++;
+		}
+	}
+}
+
+void meshReorder::orderVertices(unsigned const* faceVertices, unsigned triangleNum, unsigned vertexNum,
+		std::vector<unsigned>& order) {
+	std::vector<bool> used(vertexNum, false);
+	order.clear();
+	order.reserve(vertexNum);
+	for (unsigned c = 0; c < 3 * triangleNum; ++c) {
+		const unsigned v = faceVertices[c];
+		if (used[v]) continue;
+		used[v] = true;
+		order.push_back(v);
+	}
+	for (unsigned v = 0; v < vertexNum; ++v) {
+		if (!used[v]) order.push_back(v);
+	}
+}
+
+float meshReorder::missRatio(unsigned const* faceVertices, unsigned triangleNum, unsigned vertexNum,
+		unsigned cacheSize) {
+	if (triangleNum == 0) return 0;
+	std::vector<unsigned> cachedAt(vertexNum, NONE); // when it went into the cache
+	unsigned misses = 0;
+	for (unsigned c = 0; c < 3 * triangleNum; ++c) {
+		const unsigned v = faceVertices[c];
+		if (cachedAt[v] != NONE && misses - cachedAt[v] < cacheSize) continue;
+		// (FIFO: it's in the cache if fewer than cacheSize others went in since)
+		cachedAt[v] = ++misses;
+	}
+	return float(misses) / triangleNum;
+}
+
+void meshReorder::apply(ObjData& obj, std::vector<unsigned>& originalVertexOf,
+		std::vector<unsigned>& originalFaceOf, unsigned cacheSize) {
+	const unsigned vertexNum = obj.vertices.size();
+	const unsigned triangleNum = obj.faceVertices.size() / 3;
+	unsigned const* faces = obj.faceVertices.empty() ? NULL : &obj.faceVertices[0];
+
+	orderTriangles(faces, triangleNum, vertexNum, cacheSize, originalFaceOf);
+	std::vector<unsigned> faceVertices(3 * triangleNum), faceNormals(3 * triangleNum);
+	for (unsigned f = 0; f < triangleNum; ++f) {
+		for (unsigned k = 0; k < 3; ++k) {
+			faceVertices[3*f + k] = obj.faceVertices[3 * originalFaceOf[f] + k];
+			faceNormals[3*f + k] = obj.faceNormals[3 * originalFaceOf[f] + k];
+		}
+	}
+
+	orderVertices(faceVertices.empty() ? NULL : &faceVertices[0], triangleNum, vertexNum, originalVertexOf);
+	std::vector<unsigned> newOf(vertexNum);
+	std::vector<Point> vertices(vertexNum);
+	for (unsigned v = 0; v < vertexNum; ++v) {
+		newOf[originalVertexOf[v]] = v;
+		vertices[v] = obj.vertices[originalVertexOf[v]];
+	}
+	for (unsigned c = 0; c < faceVertices.size(); ++c) faceVertices[c] = newOf[faceVertices[c]];
+
+	obj.vertices.swap(vertices);
+	obj.faceVertices.swap(faceVertices);
+	obj.faceNormals.swap(faceNormals);
+}
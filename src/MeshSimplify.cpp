@@ -0,0 +1,440 @@
+/*
+ * MeshSimplify.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "MeshSimplify.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <iterator>
+#include <queue>
+#include <cmath>
+
+// about how many triangles go into one part
+static const unsigned PART_SIZE = 32768;
+// how much more a boundary edge holds on to its place than a face does
+static const double BOUNDARY_WEIGHT = 100.0;
+// a collapse is not done if it turns a triangle by more than about 80 degrees
+static const double MIN_NORMAL_COS = 0.2;
+
+static const unsigned NONE = ~0u;
+
+// the plane distances summed up: v^T Q v with v = (x y z 1), upper triangle of the symmetric Q
+struct Quadric {
+	double q[10];
+
+	Quadric() { std::fill(q, q + 10, 0.0); }
+
+	void addPlane(double a, double b, double c, double d, double w) {
+		q[0] += w*a*a; q[1] += w*a*b; q[2] += w*a*c; q[3] += w*a*d;
+		q[4] += w*b*b; q[5] += w*b*c; q[6] += w*b*d;
+		q[7] += w*c*c; q[8] += w*c*d;
+		q[9] += w*d*d;
+	}
+
+	Quadric& operator+=(Quadric const& o) {
+		for (unsigned i = 0; i < 10; ++i) q[i] += o.q[i];
+		return *this;
+	}
+
+	double error(Point const& p) const {
+		const double x = p.x(), y = p.y(), z = p.z();
+		return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+				+ q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+				+ q[7]*z*z + 2*q[8]*z
+				+ q[9];
+	}
+};
+
+struct Vec {
+	double x, y, z;
+	Vec(double x_, double y_, double z_) : x(x_), y(y_), z(z_) {}
+	Vec(Point const& p) : x(p.x()), y(p.y()), z(p.z()) {}
+	Vec operator-(Vec const& o) const { return Vec(x - o.x, y - o.y, z - o.z); }
+	double dot(Vec const& o) const { return x*o.x + y*o.y + z*o.z; }
+	Vec cross(Vec const& o) const { return Vec(y*o.z - z*o.y, z*o.x - x*o.z, x*o.y - y*o.x); }
+};
+
+// collapsing from into to (from goes away)
+struct Candidate {
+	double cost;
+	unsigned from, to;
+	unsigned fromStamp, toStamp;
+	// (for a priority_queue that gives the cheapest first)
+	bool operator<(Candidate const& o) const { return cost > o.cost; }
+};
+
+// what simplifying one part gives
+struct PartResult {
+	std::vector<unsigned> faceVertices; // the triangles left, full numbering
+	std::vector<unsigned> faceNormals;
+	std::vector<std::pair<unsigned, unsigned> > collapses; // (from, to), full numbering
+	double maxCost;
+
+	PartResult() : maxCost(0) {}
+};
+
+/* Simplifies the triangles tris of the current mesh (faceVertices) down to
+ * about target. Vertices marked in locked are not moved.
+ */
+class PartSimplifier {
+private:
+	std::vector<Point> const& points;
+	std::vector<unsigned> verts; // local vertex -> full vertex (sorted)
+	std::vector<unsigned> corners; // 3 local vertices per local triangle
+	std::vector<unsigned> normals; // normal of each corner
+	std::vector<bool> alive;
+	std::vector< std::vector<unsigned> > trisOf; // alive (mostly) triangles of each vertex
+	std::vector<Quadric> quadrics;
+	std::vector<unsigned> stamp; // goes up when a vertex changes
+	std::vector<bool> dead;
+	std::vector<bool> fixed;
+	std::priority_queue<Candidate> queue;
+	unsigned aliveNum;
+	// scratch for canCollapse and collapse
+	mutable std::vector<unsigned> aroundFrom, aroundTo, common;
+
+	unsigned local(unsigned v) const {
+		return std::lower_bound(verts.begin(), verts.end(), v) - verts.begin();
+	}
+	Vec pos(unsigned l) const { return Vec(points[verts[l]]); }
+	bool has(unsigned t, unsigned l) const {
+		return (corners[3*t] == l || corners[3*t+1] == l || corners[3*t+2] == l);
+	}
+	Vec normalOf(unsigned a, unsigned b, unsigned c) const {
+		return (pos(b) - pos(a)).cross(pos(c) - pos(a));
+	}
+
+	void neighbours(unsigned l, std::vector<unsigned>& out) const;
+	bool canCollapse(unsigned from, unsigned to) const;
+	void push(unsigned a, unsigned b);
+	void collapse(unsigned from, unsigned to, PartResult& result);
+
+public:
+	PartSimplifier(std::vector<Point> const& points_, unsigned const* faceVertices, unsigned const* faceNormals,
+			std::vector<unsigned> const& tris, std::vector<bool> const& locked);
+
+	void run(unsigned target, std::vector<unsigned> const& vertexNormal, PartResult& result);
+};
+
+PartSimplifier::PartSimplifier(std::vector<Point> const& points_, unsigned const* faceVertices,
+		unsigned const* faceNormals, std::vector<unsigned> const& tris, std::vector<bool> const& locked) :
+		points(points_), aliveNum(tris.size()) {
+	verts.reserve(3 * tris.size());
+	for (unsigned i = 0; i < tris.size(); ++i) {
+		verts.insert(verts.end(), faceVertices + 3*tris[i], faceVertices + 3*tris[i] + 3);
+	}
+	std::sort(verts.begin(), verts.end());
+	verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+	const unsigned n = verts.size();
+	corners.resize(3 * tris.size());
+	normals.resize(3 * tris.size());
+	alive.assign(tris.size(), true);
+	trisOf.resize(n);
+	quadrics.resize(n);
+	stamp.assign(n, 0);
+	dead.assign(n, false);
+	fixed.resize(n);
+	for (unsigned l = 0; l < n; ++l) fixed[l] = locked[verts[l]];
+
+	std::vector<std::pair<unsigned, unsigned> > edges;
+	edges.reserve(3 * tris.size());
+	for (unsigned t = 0; t < tris.size(); ++t) {
+		for (unsigned k = 0; k < 3; ++k) {
+			corners[3*t + k] = local(faceVertices[3*tris[t] + k]);
+			normals[3*t + k] = faceNormals[3*tris[t] + k];
+			trisOf[corners[3*t + k]].push_back(t);
+		}
+		unsigned const* c = &corners[3*t];
+		// the plane of the triangle, for each of its vertices
+		Vec nrm = normalOf(c[0], c[1], c[2]);
+		double len = std::sqrt(nrm.dot(nrm));
+		if (len > 0) {
+			nrm = Vec(nrm.x / len, nrm.y / len, nrm.z / len);
+			const double d = -nrm.dot(pos(c[0]));
+			for (unsigned k = 0; k < 3; ++k) quadrics[c[k]].addPlane(nrm.x, nrm.y, nrm.z, d, 1.0);
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			edges.push_back(std::make_pair(std::min(c[k], c[(k+1)%3]), std::max(c[k], c[(k+1)%3])));
+		}
+	}
+
+	// edges with only one triangle are on the border of the surface: keep them
+	// in place with a plane through them, perpendicular to the triangle
+	std::vector<std::pair<unsigned, unsigned> > sorted(edges);
+	std::sort(sorted.begin(), sorted.end());
+	for (unsigned t = 0; t < tris.size(); ++t) {
+		unsigned const* c = &corners[3*t];
+		const Vec nrm = normalOf(c[0], c[1], c[2]);
+		for (unsigned k = 0; k < 3; ++k) {
+			std::pair<unsigned, unsigned> e = edges[3*t + k];
+			std::pair<std::vector<std::pair<unsigned, unsigned> >::iterator,
+					std::vector<std::pair<unsigned, unsigned> >::iterator> range =
+					std::equal_range(sorted.begin(), sorted.end(), e);
+			if (range.second - range.first != 1) continue;
+			Vec side = (pos(e.second) - pos(e.first)).cross(nrm);
+			double len = std::sqrt(side.dot(side));
+			if (len <= 0) continue;
+			side = Vec(side.x / len, side.y / len, side.z / len);
+			const double d = -side.dot(pos(e.first));
+			quadrics[e.first].addPlane(side.x, side.y, side.z, d, BOUNDARY_WEIGHT);
+			quadrics[e.second].addPlane(side.x, side.y, side.z, d, BOUNDARY_WEIGHT);
+		}
+	}
+
+	for (unsigned i = 0; i < sorted.size(); ++i) {
+		if (i > 0 && sorted[i] == sorted[i-1]) continue;
+		push(sorted[i].first, sorted[i].second);
+	}
+}
+
+void PartSimplifier::neighbours(unsigned l, std::vector<unsigned>& out) const {
+	out.clear();
+	for (unsigned i = 0; i < trisOf[l].size(); ++i) {
+		const unsigned t = trisOf[l][i];
+		if (!alive[t]) continue;
+		for (unsigned k = 0; k < 3; ++k) {
+			if (corners[3*t + k] != l) out.push_back(corners[3*t + k]);
+		}
+	}
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// the edge has to be there, the surface has to stay a manifold around it
+// (the link condition), and no triangle may flip
+bool PartSimplifier::canCollapse(unsigned from, unsigned to) const {
+	unsigned shared = 0;
+	for (unsigned i = 0; i < trisOf[from].size(); ++i) {
+		const unsigned t = trisOf[from][i];
+		if (alive[t] && has(t, to)) shared++;
+	}
+	if (shared == 0 || shared > 2) return false;
+
+	neighbours(from, aroundFrom);
+	neighbours(to, aroundTo);
+	common.clear();
+	std::set_intersection(aroundFrom.begin(), aroundFrom.end(), aroundTo.begin(), aroundTo.end(),
+			std::back_inserter(common));
+	if (common.size() != shared) return false;
+
+	for (unsigned i = 0; i < trisOf[from].size(); ++i) {
+		const unsigned t = trisOf[from][i];
+		if (!alive[t] || has(t, to)) continue;
+		unsigned c[3];
+		for (unsigned k = 0; k < 3; ++k) c[k] = (corners[3*t + k] == from) ? to : corners[3*t + k];
+		const Vec before = normalOf(corners[3*t], corners[3*t+1], corners[3*t+2]);
+		const Vec after = normalOf(c[0], c[1], c[2]);
+		const double lenSqr = before.dot(before) * after.dot(after);
+		if (lenSqr <= 0) return false;
+		const double d = before.dot(after);
+		if (d <= 0 || d*d < MIN_NORMAL_COS * MIN_NORMAL_COS * lenSqr) return false;
+	}
+	return true;
+}
+
+void PartSimplifier::push(unsigned a, unsigned b) {
+	Quadric q = quadrics[a];
+	q += quadrics[b];
+	Candidate c;
+	c.cost = -1;
+	if (!fixed[a]) {
+		c.cost = q.error(points[verts[b]]);
+		c.from = a;
+		c.to = b;
+	}
+	if (!fixed[b]) {
+		double cost = q.error(points[verts[a]]);
+		if (c.cost < 0 || cost < c.cost) {
+			c.cost = cost;
+			c.from = b;
+			c.to = a;
+		}
+	}
+	if (c.cost < 0) return; // both locked
+	c.fromStamp = stamp[c.from];
+	c.toStamp = stamp[c.to];
+	queue.push(c);
+}
+
+void PartSimplifier::collapse(unsigned from, unsigned to, PartResult& result) {
+	std::vector<unsigned>& target = trisOf[to];
+	for (unsigned i = 0; i < trisOf[from].size(); ++i) {
+		const unsigned t = trisOf[from][i];
+		if (!alive[t]) continue;
+		if (has(t, to)) {
+			alive[t] = false;
+			aliveNum--;
+			continue;
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			if (corners[3*t + k] == from) {
+				corners[3*t + k] = to;
+				normals[3*t + k] = NONE; // filled in at the end
+			}
+		}
+		target.push_back(t);
+	}
+	std::vector<unsigned>().swap(trisOf[from]);
+	// drop the triangles that went away
+	unsigned kept = 0;
+	for (unsigned i = 0; i < target.size(); ++i) {
+		if (alive[target[i]]) target[kept++] = target[i];
+	}
+	target.resize(kept);
+
+	dead[from] = true;
+	quadrics[to] += quadrics[from];
+	stamp[to]++;
+	result.collapses.push_back(std::make_pair(verts[from], verts[to]));
+
+	neighbours(to, aroundTo);
+	for (unsigned i = 0; i < aroundTo.size(); ++i) push(to, aroundTo[i]);
+}
+
+void PartSimplifier::run(unsigned target, std::vector<unsigned> const& vertexNormal, PartResult& result) {
+	while (aliveNum > target && !queue.empty()) {
+		Candidate c = queue.top();
+		queue.pop();
+		if (dead[c.from] || dead[c.to] || stamp[c.from] != c.fromStamp || stamp[c.to] != c.toStamp)
+			continue; // out of date, there is a newer one if it still matters
+		if (!canCollapse(c.from, c.to)) continue;
+		collapse(c.from, c.to, result);
+		result.maxCost = std::max(result.maxCost, c.cost);
+	}
+
+	for (unsigned t = 0; t < alive.size(); ++t) {
+		if (!alive[t]) continue;
+		for (unsigned k = 0; k < 3; ++k) {
+			const unsigned v = verts[corners[3*t + k]];
+			result.faceVertices.push_back(v);
+			result.faceNormals.push_back(normals[3*t + k] != NONE ? normals[3*t + k] : vertexNormal[v]);
+		}
+	}
+}
+
+// orders triangles by where their centres are along an axis
+struct ByCentre {
+	std::vector<Point> const& points;
+	unsigned const* faceVertices;
+	unsigned axis;
+	ByCentre(std::vector<Point> const& p, unsigned const* f, unsigned a) : points(p), faceVertices(f), axis(a) {}
+	float centre(unsigned t) const {
+		float s = 0;
+		for (unsigned k = 0; k < 3; ++k) {
+			Point const& p = points[faceVertices[3*t + k]];
+			s += (axis == 0) ? p.x() : ((axis == 1) ? p.y() : p.z());
+		}
+		return s;
+	}
+	bool operator()(unsigned a, unsigned b) const { return centre(a) < centre(b); }
+};
+
+// cuts tris (triangles of faceVertices) at the median of their centres along
+// the longest side of their box, until the parts are small enough
+static void partition(std::vector<Point> const& points, unsigned const* faceVertices,
+		std::vector<unsigned>& tris, unsigned from, unsigned to,
+		std::vector< std::vector<unsigned> >& parts) {
+	if (to - from <= PART_SIZE) {
+		parts.push_back(std::vector<unsigned>(tris.begin() + from, tris.begin() + to));
+		return;
+	}
+	float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+	for (unsigned i = from; i < to; ++i) {
+		Point const& p = points[faceVertices[3*tris[i]]];
+		const float c[3] = {p.x(), p.y(), p.z()};
+		for (unsigned a = 0; a < 3; ++a) {
+			lo[a] = std::min(lo[a], c[a]);
+			hi[a] = std::max(hi[a], c[a]);
+		}
+	}
+	unsigned axis = 0;
+	for (unsigned a = 1; a < 3; ++a) {
+		if (hi[a] - lo[a] > hi[axis] - lo[axis]) axis = a;
+	}
+
+	const unsigned mid = from + (to - from) / 2;
+	std::nth_element(tris.begin() + from, tris.begin() + mid, tris.begin() + to,
+			ByCentre(points, faceVertices, axis));
+	partition(points, faceVertices, tris, from, mid, parts);
+	partition(points, faceVertices, tris, mid, to, parts);
+}
+
+void meshSimplify::buildChain(std::vector<Point> const& points, unsigned const* faceVertices,
+		unsigned const* faceNormals, unsigned triangleNum, unsigned levels, float ratio,
+		std::vector<MeshLod>& lods) {
+	const unsigned vertexNum = points.size();
+	unsigned const* faces = faceVertices;
+	unsigned const* normals = faceNormals;
+	unsigned triNum = triangleNum;
+	std::vector<unsigned> lodOf(vertexNum);
+	for (unsigned v = 0; v < vertexNum; ++v) lodOf[v] = v;
+	double error = 0;
+
+	for (unsigned level = 0; level < levels; ++level) {
+		if (triNum < 2) return;
+
+		std::vector<unsigned> tris(triNum);
+		for (unsigned t = 0; t < triNum; ++t) tris[t] = t;
+		std::vector< std::vector<unsigned> > parts;
+		partition(points, faces, tris, 0, triNum, parts);
+
+		// a vertex used by more than one part is on a border
+		std::vector<unsigned> partOf(vertexNum, NONE);
+		std::vector<bool> locked(vertexNum, false);
+		std::vector<unsigned> vertexNormal(vertexNum, 0);
+		for (unsigned p = 0; p < parts.size(); ++p) {
+			for (unsigned i = 0; i < parts[p].size(); ++i) {
+				for (unsigned k = 0; k < 3; ++k) {
+					const unsigned v = faces[3*parts[p][i] + k];
+					if (partOf[v] == NONE) {
+						partOf[v] = p;
+						vertexNormal[v] = normals[3*parts[p][i] + k];
+					} else if (partOf[v] != p) {
+						locked[v] = true;
+					}
+				}
+			}
+		}
+
+		std::vector<PartResult> results(parts.size());
+		#pragma omp parallel for schedule(dynamic)
+		for (int p = 0; p < (int) parts.size(); ++p) {
+			TRACE_SCOPE("simplify part");
+			PartSimplifier simplifier(points, faces, normals, parts[p], locked);
+			const unsigned target = std::max(1u, (unsigned) (ratio * parts[p].size()));
+			simplifier.run(target, vertexNormal, results[p]);
+		}
+
+		MeshLod lod;
+		std::vector<unsigned> mergedInto(vertexNum, NONE);
+		for (unsigned p = 0; p < results.size(); ++p) {
+			PartResult const& r = results[p];
+			lod.faceVertices.insert(lod.faceVertices.end(), r.faceVertices.begin(), r.faceVertices.end());
+			lod.faceNormals.insert(lod.faceNormals.end(), r.faceNormals.begin(), r.faceNormals.end());
+			for (unsigned i = 0; i < r.collapses.size(); ++i) mergedInto[r.collapses[i].first] = r.collapses[i].second;
+			error = std::max(error, r.maxCost);
+		}
+		if (lod.getTriangleNum() >= triNum) return; // nothing left to take away
+
+		// (a vertex can be merged into one that is merged later on, follow those)
+		lod.lodOf.resize(vertexNum);
+		for (unsigned v = 0; v < vertexNum; ++v) {
+			unsigned to = lodOf[v];
+			while (mergedInto[to] != NONE) to = mergedInto[to];
+			lod.lodOf[v] = to;
+		}
+		lodOf = lod.lodOf;
+		lod.error = std::sqrt(error);
+
+		lods.push_back(lod);
+		triNum = lods.back().getTriangleNum();
+		if (triNum == 0) return;
+		faces = &lods.back().faceVertices[0];
+		normals = &lods.back().faceNormals[0];
+	}
+}
@@ -0,0 +1,53 @@
+/*
+ * MeshSimplify.h
+ * Makes coarser versions (levels of detail) of a mesh with quadric error
+ * edge collapses (Garland, Heckbert: "Surface Simplification Using Quadric
+ * Error Metrics", 1997). The collapses are half edge collapses: a vertex is
+ * merged into one of its neighbours, so every vertex of a LOD is a vertex of
+ * the full mesh. Its triangles can be drawn with the positions of the full
+ * mesh (skinned or not), and every full vertex knows which LOD vertex took
+ * it over.
+ *
+ * To use more than one core, the triangles are cut into compact parts (by
+ * median splits) that are simplified at the same time. The vertices on the
+ * borders of the parts stay where they are for that level.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef MESHSIMPLIFY_H_
+#define MESHSIMPLIFY_H_
+
+#include <vector>
+
+#include "geometry.h"
+#include "VertexStream.h"
+
+struct MeshLod {
+	// 3 per triangle, numbered as the vertices and normals of the full mesh
+	std::vector<unsigned> faceVertices;
+	std::vector<unsigned> faceNormals;
+	// the full mesh vertex each full mesh vertex was merged into (itself if it's in the LOD)
+	std::vector<unsigned> lodOf;
+	// about how far (in model units) the LOD is from the full mesh
+	float error;
+	VertexStream stream;
+
+	MeshLod() : error(0) {}
+	unsigned getTriangleNum() const { return faceVertices.size() / 3; }
+};
+
+namespace meshSimplify {
+
+	/* Appends up to levels LODs to lods, each with about ratio times the
+	 * triangles of the one before (the first is made from the full mesh).
+	 * Stops early if a level can't get smaller. The streams are not built.
+	 */
+	void buildChain(std::vector<Point> const& points, unsigned const* faceVertices,
+			unsigned const* faceNormals, unsigned triangleNum, unsigned levels, float ratio,
+			std::vector<MeshLod>& lods);
+
+}
+
+#endif /* MESHSIMPLIFY_H_ */
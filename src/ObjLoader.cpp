@@ -0,0 +1,233 @@
+/*
+ * ObjLoader.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "textScan.h"
+#include "tools.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+// the file is cut into pieces of about this many bytes
+static const long PIECE_SIZE = 256 * 1024;
+
+// what one piece of the file has, before it is put together with the others
+struct Piece {
+	const char* begin;
+	const char* end;
+	std::vector<float> vertices; // x y z after each other
+	std::vector<float> normals;
+	std::vector<unsigned> faceVertices;
+	std::vector<unsigned> faceNormals;
+	// the largest (index - number of vertices of this piece before the face) of
+	// all the faces. The faces are fine if this is less than how many vertices
+	// the pieces before have, which is only known once they are all read
+	long long vertexReach;
+	long long normalReach;
+	bool malformed;
+	// where the arrays of this piece start in the whole
+	unsigned vertexStart, normalStart, triangleStart;
+
+	Piece(const char* begin_, const char* end_) : begin(begin_), end(end_),
+			vertexReach(std::numeric_limits<long long>::min()),
+			normalReach(std::numeric_limits<long long>::min()),
+			malformed(false), vertexStart(0), normalStart(0), triangleStart(0) {}
+};
+
+// digits only; nothing there reads as 0 (which is never a good 1 based index)
+static unsigned readIndex(const char*& p, const char* end) {
+	unsigned v = 0;
+	while (p < end && textScan::isDigit(*p)) {
+		v = v*10 + (*p - '0');
+		++p;
+	}
+	return v;
+}
+
+// reads a v, v/t, v//n or v/t/n term
+static void readTerm(const char*& p, const char* end, unsigned& vertex, unsigned& normal) {
+	vertex = readIndex(p, end);
+	normal = 0;
+	if (p < end && *p == '/') {
+		++p;
+		readIndex(p, end); // the texture coordinate, we don't use those
+		if (p < end && *p == '/') {
+			++p;
+			normal = readIndex(p, end);
+		}
+	}
+	while (p < end && !textScan::isBlank(*p)) ++p;
+}
+
+static bool isRecord(const char* p, const char* lineEnd, char const* type, unsigned len) {
+	return (lineEnd - p > (long) len && memcmp(p, type, len) == 0 &&
+			(p[len] == ' ' || p[len] == '\t'));
+}
+
+static bool readPoint(const char*& p, const char* lineEnd, std::vector<float>& to) {
+	float c[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		if (!textScan::scanFloat(p, lineEnd, c[i])) return false;
+	}
+	to.insert(to.end(), c, c + 3);
+	return true;
+}
+
+/* Reads the records of a piece. Whether the faces reference defined vertices
+ * can only be checked if we know how many the pieces before have: if report is
+ * set, those are vertexBase and normalBase, and the first face that is wrong
+ * (or any line that can't be read) is thrown. Otherwise they are just noted in
+ * the piece.
+ */
+static void parsePiece(Piece& piece, long long vertexBase, long long normalBase, bool report)
+		throw(ParseException) {
+	// about how many of each there will be (a face line is around 30 characters)
+	piece.faceVertices.reserve((piece.end - piece.begin) / 10);
+	piece.faceNormals.reserve((piece.end - piece.begin) / 10);
+
+	const char* p = piece.begin;
+	while (p < piece.end) {
+		const char* line = p;
+		const char* lineEnd = (const char*) memchr(p, '\n', piece.end - p);
+		if (lineEnd == NULL) lineEnd = piece.end;
+		bool bad = false;
+
+		textScan::skipSpaces(p, lineEnd);
+		if (isRecord(p, lineEnd, "v", 1)) {
+			p += 1;
+			bad = !readPoint(p, lineEnd, piece.vertices);
+		} else if (isRecord(p, lineEnd, "vn", 2)) {
+			p += 2;
+			bad = !readPoint(p, lineEnd, piece.normals);
+			if (!bad) {
+				float* n = &piece.normals[piece.normals.size() - 3];
+				normalize(n, n+1, n+2);
+			}
+		} else if (isRecord(p, lineEnd, "f", 1)) {
+			p += 1;
+			const long long vertexNum = piece.vertices.size() / 3;
+			const long long normalNum = piece.normals.size() / 3;
+			unsigned first[2] = {0, 0}, prev[2] = {0, 0};
+			unsigned terms = 0;
+			for (;;) {
+				textScan::skipSpaces(p, lineEnd);
+				if (p == lineEnd) break;
+				unsigned vertex, normal;
+				readTerm(p, lineEnd, vertex, normal);
+				vertex--; normal--; // uses 1 based indices..
+
+				long long vReach = (long long) vertex - vertexNum;
+				long long nReach = (long long) normal - normalNum;
+				if (report && (vReach >= vertexBase || nReach >= normalBase)) {
+					std::stringstream ss;
+					ss		<< std::endl
+							<< "__ The face '" << std::endl << "\t" << std::string(line, lineEnd)
+							<< "' is referencing vertex " << vertex
+							<< " and normal " << normal
+							<< ", one of which has not been defined yet. (normals="
+							<< normalBase + normalNum << ", vertices="
+							<< vertexBase + vertexNum << ") __"
+							<< std::endl;
+					throw ParseException("", ss.str());
+				}
+				piece.vertexReach = std::max(piece.vertexReach, vReach);
+				piece.normalReach = std::max(piece.normalReach, nReach);
+
+				// a fan of triangles around the first vertex
+				if (terms >= 2) {
+					unsigned tri[3][2] = { {first[0], first[1]}, {prev[0], prev[1]}, {vertex, normal} };
+					for (unsigned i = 0; i < 3; ++i) {
+						piece.faceVertices.push_back(tri[i][0]);
+						piece.faceNormals.push_back(tri[i][1]);
+					}
+				} else if (terms == 0) {
+					first[0] = vertex;
+					first[1] = normal;
+				}
+				prev[0] = vertex;
+				prev[1] = normal;
+				terms++;
+			}
+			bad = (terms < 3);
+		}
+		// anything else (comments, groups, texture coordinates, ..) is ignored
+
+		if (bad) {
+			if (report) throw ParseException("a v, vn or f record with all its numbers",
+					std::string(line, lineEnd));
+			piece.malformed = true;
+		}
+		p = (lineEnd < piece.end) ? lineEnd + 1 : piece.end;
+	}
+}
+
+void objLoader::load(std::string const& filename, ObjData& data) throw(ParseException) {
+	MappedFile file(filename);
+
+	// cut at line ends
+	std::vector<Piece> pieces;
+	const char* p = file.begin();
+	while (p < file.end()) {
+		const char* cut = (file.end() - p > PIECE_SIZE) ? p + PIECE_SIZE : file.end();
+		textScan::skipLine(cut, file.end());
+		pieces.push_back(Piece(p, cut));
+		p = cut;
+	}
+
+	// exceptions can't leave the parallel loop, so nothing is thrown here
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) pieces.size(); ++i) {
+		TRACE_SCOPE("parse piece");
+		parsePiece(pieces[i], 0, 0, false);
+	}
+
+	// now that the counts are known, check the faces. If a piece has a problem,
+	// it is read again to find (and throw) the first one
+	long long vertexNum = 0, normalNum = 0, triangleNum = 0;
+	for (unsigned i = 0; i < pieces.size(); ++i) {
+		Piece& piece = pieces[i];
+		if (piece.malformed || piece.vertexReach >= vertexNum || piece.normalReach >= normalNum) {
+			Piece again(piece.begin, piece.end);
+			parsePiece(again, vertexNum, normalNum, true);
+		}
+		piece.vertexStart = vertexNum;
+		piece.normalStart = normalNum;
+		piece.triangleStart = triangleNum;
+		vertexNum += piece.vertices.size() / 3;
+		normalNum += piece.normals.size() / 3;
+		triangleNum += piece.faceVertices.size() / 3;
+	}
+
+	data.vertices.resize(vertexNum);
+	data.normals.resize(normalNum);
+	data.faceVertices.resize(3 * triangleNum);
+	data.faceNormals.resize(3 * triangleNum);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int) pieces.size(); ++i) {
+		TRACE_SCOPE("copy piece");
+		Piece& piece = pieces[i];
+		std::vector<float> const& v = piece.vertices;
+		for (unsigned k = 0; k < v.size() / 3; ++k)
+			data.vertices[piece.vertexStart + k] = Point(v[3*k], v[3*k+1], v[3*k+2]);
+		std::vector<float> const& n = piece.normals;
+		for (unsigned k = 0; k < n.size() / 3; ++k)
+			data.normals[piece.normalStart + k] = Point(n[3*k], n[3*k+1], n[3*k+2]);
+		std::copy(piece.faceVertices.begin(), piece.faceVertices.end(),
+				data.faceVertices.begin() + 3 * piece.triangleStart);
+		std::copy(piece.faceNormals.begin(), piece.faceNormals.end(),
+				data.faceNormals.begin() + 3 * piece.triangleStart);
+		// done with this piece
+		std::vector<float>().swap(piece.vertices);
+		std::vector<float>().swap(piece.normals);
+		std::vector<unsigned>().swap(piece.faceVertices);
+		std::vector<unsigned>().swap(piece.faceNormals);
+	}
+}
@@ -0,0 +1,39 @@
+/*
+ * ObjLoader.h
+ * Reads the v, vn and f records of a Wavefront .obj file. The file is memory
+ * mapped and cut into pieces at line ends, the pieces are parsed at the same
+ * time (with the scanners of textScan.h, nothing is allocated per line), and
+ * their arrays are put together in the order of the file.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef OBJLOADER_H_
+#define OBJLOADER_H_
+
+#include <string>
+#include <vector>
+
+#include "geometry.h"
+#include "myexceptions.h"
+
+struct ObjData {
+	std::vector<Point> vertices;
+	std::vector<Point> normals; // normalized
+	// 3 per triangle, 0 based (faces with more vertices are cut into a fan)
+	std::vector<unsigned> faceVertices;
+	std::vector<unsigned> faceNormals;
+};
+
+namespace objLoader {
+
+	/* Fills data from the file. Faces are v//n (or v/t/n) terms, and they can
+	 * only reference vertices and normals defined before them; if one doesn't,
+	 * the first such face in the file is reported in a ParseException.
+	 */
+	void load(std::string const& filename, ObjData& data) throw(ParseException);
+
+}
+
+#endif /* OBJLOADER_H_ */
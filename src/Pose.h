@@ -0,0 +1,38 @@
+/*
+ * Pose.h
+ * The sampled local transformations of the animated joints of one or more
+ * characters, filled by Animation::samplePoses. Joints are in the order of
+ * Skeleton::getAnimatedJoints (the order the skeleton is drawn in),
+ * pose after pose. Every component has its own array, see QuatBatch.h.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef POSE_H_
+#define POSE_H_
+
+#include <vector>
+
+struct Pose {
+	unsigned jointNum;
+	unsigned poseNum;
+	std::vector<float> rot[4]; // w, x, y, z of the rotations
+	std::vector<float> pos[3]; // translations (0 for joints without position channels)
+	std::vector<float> matrices; // 3x4 per joint, like eulerBatch::toMatrices makes them
+
+	Pose() : jointNum(0), poseNum(0) {}
+
+	void resize(unsigned jointNum_, unsigned poseNum_) {
+		jointNum = jointNum_;
+		poseNum = poseNum_;
+		for (unsigned c = 0; c < 4; ++c) rot[c].resize(jointNum * poseNum);
+		for (unsigned c = 0; c < 3; ++c) pos[c].resize(jointNum * poseNum);
+		matrices.resize(12 * jointNum * poseNum);
+	}
+
+	// the 3x4 matrices of all joints of a pose
+	float const* getMatrices(unsigned pose) const { return &matrices[12 * jointNum * pose]; }
+};
+
+#endif /* POSE_H_ */
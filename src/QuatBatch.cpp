@@ -0,0 +1,107 @@
+/*
+ * QuatBatch.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "QuatBatch.h"
+#include "EulerBatch.h"
+
+#include <algorithm>
+#include <cmath>
+
+// acos on [0, 1] (Abramowitz and Stegun 4.4.46, good to 2e-8)
+inline float acosUnit(float d) {
+	float p = -0.0012624911f;
+	p = p * d + 0.0066700901f;
+	p = p * d - 0.0170881256f;
+	p = p * d + 0.0308918810f;
+	p = p * d - 0.0501743046f;
+	p = p * d + 0.0889789874f;
+	p = p * d - 0.2145988016f;
+	p = p * d + 1.5707963050f;
+	float oneMinus = std::abs(1 - d); // rounding can take d a bit over 1
+	return oneMinus * quatBatch::rsqrt(oneMinus) * p;
+}
+
+// the arrays of a block, moved to where the block starts
+struct QuatArrays {
+	float const* a[4];
+	float const* b[4];
+	float const* t;
+	float* ret[4];
+
+	QuatArrays(float const* const* a_, float const* const* b_, float const* t_,
+			float* const* ret_, unsigned start) : t(t_ + start) {
+		for (unsigned c = 0; c < 4; ++c) {
+			a[c] = a_[c] + start;
+			b[c] = b_[c] + start;
+			ret[c] = ret_[c] + start;
+		}
+	}
+};
+
+static float minAbsDot(QuatArrays const& q, unsigned n) {
+	float m = 1;
+	for (unsigned i = 0; i < n; ++i) {
+		float d = q.a[0][i]*q.b[0][i] + q.a[1][i]*q.b[1][i] + q.a[2][i]*q.b[2][i] + q.a[3][i]*q.b[3][i];
+		m = std::min(m, std::abs(d));
+	}
+	return m;
+}
+
+static void nlerp(QuatArrays const& q, unsigned n) {
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i) {
+		float d = q.a[0][i]*q.b[0][i] + q.a[1][i]*q.b[1][i] + q.a[2][i]*q.b[2][i] + q.a[3][i]*q.b[3][i];
+		float t = q.t[i];
+		float sb = (d < 0) ? -t : t;
+		float w = (1 - t) * q.a[0][i] + sb * q.b[0][i];
+		float x = (1 - t) * q.a[1][i] + sb * q.b[1][i];
+		float y = (1 - t) * q.a[2][i] + sb * q.b[2][i];
+		float z = (1 - t) * q.a[3][i] + sb * q.b[3][i];
+		float inv = quatBatch::rsqrt(w*w + x*x + y*y + z*z);
+		q.ret[0][i] = w * inv;
+		q.ret[1][i] = x * inv;
+		q.ret[2][i] = y * inv;
+		q.ret[3][i] = z * inv;
+	}
+}
+
+// same as Quaternion::slerp
+static void slerp(QuatArrays const& q, unsigned n) {
+	#pragma omp simd
+	for (unsigned i = 0; i < n; ++i) {
+		float d = q.a[0][i]*q.b[0][i] + q.a[1][i]*q.b[1][i] + q.a[2][i]*q.b[2][i] + q.a[3][i]*q.b[3][i];
+		float t = q.t[i];
+		float flip = (d < 0) ? -1.0f : 1.0f;
+
+		// Quaternion::slerp switches to sin(a) = a for tiny angles. Here that
+		// would be a branch, so the angle is kept off 0 instead: sin(k*a)/sin(a)
+		// only changes with a^2, so this moves the weights by about 1e-12.
+		float angle = acosUnit(std::abs(d)) + 1e-6f;
+		float sinA, s1, s2, c;
+		// (all in [0, pi], no turns to take off)
+		eulerBatch::sinCosSmall(angle, sinA, c);
+		eulerBatch::sinCosSmall((1 - t) * angle, s1, c);
+		eulerBatch::sinCosSmall(t * angle, s2, c);
+		float sc1 = s1 / sinA;
+		float sc2 = s2 / sinA * flip;
+
+		q.ret[0][i] = sc1 * q.a[0][i] + sc2 * q.b[0][i];
+		q.ret[1][i] = sc1 * q.a[1][i] + sc2 * q.b[1][i];
+		q.ret[2][i] = sc1 * q.a[2][i] + sc2 * q.b[2][i];
+		q.ret[3][i] = sc1 * q.a[3][i] + sc2 * q.b[3][i];
+	}
+}
+
+void quatBatch::interpolate(float const* const* a, float const* const* b, float const* t,
+		unsigned n, float* const* ret) {
+	for (unsigned start = 0; start < n; start += BLOCK) {
+		unsigned count = std::min(BLOCK, n - start);
+		QuatArrays q(a, b, t, ret, start);
+		if (minAbsDot(q, count) >= NLERP_MIN_DOT) nlerp(q, count);
+		else slerp(q, count);
+	}
+}
@@ -0,0 +1,51 @@
+/*
+ * QuatBatch.h
+ * Interpolates many quaternion pairs at once, kept like in EulerBatch.h as
+ * one array per component so the loops vectorize.
+ *
+ * Neighbouring frames are usually only a few degrees apart, and there
+ * normalizing the linear interpolation (nlerp) is as good as slerp: for two
+ * rotations at most 10 degrees apart it is off by less than 2.2e-5 radians.
+ * Blocks where every pair is that close take this path, the others get a slerp
+ * with polynomial acos and sin.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef QUATBATCH_H_
+#define QUATBATCH_H_
+
+#include <cstring>
+
+namespace quatBatch {
+
+	// cos of half of the largest angle (10 degrees) between rotations we nlerp
+	static const float NLERP_MIN_DOT = 0.99619470f;
+	// how many pairs decide together which path they take
+	static const unsigned BLOCK = 64;
+
+	// 1/sqrt(x) for x >= 0 without calling sqrt (that stops the vectorizing):
+	// the usual bit trick guess, then Newton steps to full float precision
+	inline float rsqrt(float x) {
+		int i;
+		std::memcpy(&i, &x, sizeof(float));
+		i = 0x5f3759df - (i >> 1);
+		float y;
+		std::memcpy(&y, &i, sizeof(float));
+		y = y * (1.5f - 0.5f * x * y * y);
+		y = y * (1.5f - 0.5f * x * y * y);
+		y = y * (1.5f - 0.5f * x * y * y);
+		return y;
+	}
+
+	/* ret[i] = a[i] interpolated towards b[i] by t[i], for n pairs. a, b and ret
+	 * have the w, x, y, z arrays of unit quaternions. Always takes the short
+	 * way (b is flipped if it is on the other side). ret may be a or b.
+	 */
+	void interpolate(float const* const* a, float const* const* b, float const* t,
+			unsigned n, float* const* ret);
+
+}
+
+#endif /* QUATBATCH_H_ */
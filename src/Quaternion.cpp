@@ -121,6 +121,35 @@ void Quaternion::getRotation(float * matrix) {
 	matrix[15] = 1;
 }
 
+/* Finds the Euler angles of this rotation. order has the three axes (0, 1, 2
+ * for x, y, z) so that the rotation is R_order[0] * R_order[1] * R_order[2].
+ * The angles are put into radByAxis[0..2] by axis (x, y, z).
+ */
+void Quaternion::getEuler(unsigned char const* order, float* radByAxis) const {
+	Quaternion q(*this);
+	float m[16];
+	q.getRotation(m);
+	// R(row, col) -- remember opengl matrix is column first
+	#define R(r, c) m[(c)*4 + (r)]
+
+	const int a = order[0], b = order[1], c = order[2];
+	// +1 for xyz, yzx, zxy, -1 for the others
+	const float sign = ((b - a + 3) % 3 == 1) ? 1 : -1;
+
+	float sinB = sign * R(a, c);
+	if (sinB > 1) sinB = 1;
+	if (sinB < -1) sinB = -1;
+	radByAxis[b] = asin(sinB);
+	if (std::abs(sinB) < 1 - EPS) {
+		radByAxis[a] = atan2(-sign * R(b, c), R(c, c));
+		radByAxis[c] = atan2(-sign * R(a, b), R(a, a));
+	} else { // gimbal lock: only a+c (or a-c) matters, put it all in a
+		radByAxis[c] = 0;
+		radByAxis[a] = atan2(sign * R(c, b), R(b, b));
+	}
+	#undef R
+}
+
 // normalizes this quaternion if needed
 void Quaternion::printRotMatrix() {
 	float temp[16];
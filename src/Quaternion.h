@@ -8,6 +8,8 @@
 #ifndef QUATERNION_H_
 #define QUATERNION_H_
 
+#include <cmath>
+
 class Quaternion {
 private:
 	float w, x, y, z; // q = w + xi + yj + zk
@@ -41,7 +43,36 @@ public:
 		return n;
 	}
 
+	// *this *= Quaternion(angleRad, axis), but only doing the multiplications that are not by 0.
+	// Axis is 0, 1 or 2 for x, y, z.
+	template <int Axis> void mulAxis(float angleRad) {
+		mulAxis<Axis>(w, x, y, z, sin(angleRad/2), cos(angleRad/2));
+	}
+	// the same on loose components, s and c are the sin and cos of the half angle
+	// (this is what the batched conversions in EulerBatch.h run on)
+	template <int Axis> static void mulAxis(float& w, float& x, float& y, float& z, float s, float c) {
+		float tw, tx, ty, tz;
+		if (Axis == 0) {
+			tw = w*c - x*s; tx = x*c + w*s; ty = y*c + z*s; tz = z*c - y*s;
+		} else if (Axis == 1) {
+			tw = w*c - y*s; tx = x*c - z*s; ty = y*c + w*s; tz = z*c + x*s;
+		} else {
+			tw = w*c - z*s; tx = x*c + y*s; ty = y*c - x*s; tz = z*c + w*s;
+		}
+		w = tw; x = tx; y = ty; z = tz;
+	}
+
+	void getComponents(float* wxyz) const {
+		wxyz[0] = w; wxyz[1] = x; wxyz[2] = y; wxyz[3] = z;
+	}
+	static Quaternion fromComponents(float w, float x, float y, float z) {
+		Quaternion q;
+		q.w = w; q.x = x; q.y = y; q.z = z;
+		return q;
+	}
+
 	void getRotation(float * matrix);
+	void getEuler(unsigned char const* order, float* radByAxis) const;
 	void printRotMatrix();
 
 	static float dotProd(Quaternion const &a, Quaternion const &b) {
@@ -0,0 +1,649 @@
+/*
+ * Skeleton.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+
+#ifdef __APPLE__
+#  include <GLUT/glut.h>
+#else
+#  include <GL/glut.h>
+#endif
+
+#include "Skeleton.h"
+#include "tools.h"
+#include "sparseMatrixHelp.h"
+#include "EulerBatch.h"
+#include "Trace.h"
+#include "MemoryUse.h"
+
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+/* Reads the part of a joint before its children:
+ * BoneName
+ * {
+ *     OFFSET f f f
+ *     CHANNELS ----
+ */
+static void parseJointHead(std::istream& descr, std::string& name, Point& offset,
+		ChannelLayout& layout) throw(ParseException) {
+	std::string token;
+	descr >> token;
+	if (token.compare("{") != 0) {
+		name = token;
+		descr >> token;
+		confirmParse(token, "{");
+	} else {
+		name = "no-name";
+	}
+
+	descr >> token;
+	confirmParse(token, "OFFSET");
+	float offs[3];
+	descr >> offs[0] >> offs[1] >> offs[2];
+	offset = Point(offs[0], offs[1], offs[2]);
+
+	descr >> token;
+	confirmParse(token, "CHANNELS");
+
+	unsigned channelNum;
+	descr >> channelNum;
+	// any of the 6 channels, in any order
+	layout = ChannelLayout::parse(descr, channelNum);
+}
+
+/* Reads a root and all the joints under it. Reads out just as much info from
+ * the stream as needed. Joints have the head above, then JOINTs (the same
+ * again) or an
+ *     End Site
+ *     {
+ *         OFFSET f f f
+ *     }
+ * and a closing }. The joints still open are kept on a stack.
+ */
+void Skeleton::parseRoot(std::istream& descr) throw(ParseException) {
+	std::string name;
+	Point offset;
+	ChannelLayout layout;
+	parseJointHead(descr, name, offset, layout);
+	std::vector<unsigned> open(1, addJoint(-1, name, offset, layout));
+
+	std::string token;
+	while (!open.empty()) {
+		descr >> token;
+		if (token.compare("}") == 0) {
+			open.pop_back();
+		} else if (token.compare("End") == 0) {
+			descr >> token;
+			confirmParse(token, "Site");
+			descr >> token;
+			confirmParse(token, "{");
+			descr >> token;
+			confirmParse(token, "OFFSET");
+			float offs[3];
+			descr >> offs[0] >> offs[1] >> offs[2];
+			addJoint(open.back(), "End Site", Point(offs[0], offs[1], offs[2]), ChannelLayout());
+			descr >> token;
+			confirmParse(token, "}");
+		} else if (token.compare("JOINT") == 0) {
+			parseJointHead(descr, name, offset, layout);
+			open.push_back(addJoint(open.back(), name, offset, layout));
+		} else {
+			throw ParseException("JOINT, End or }", token);
+		}
+	}
+	findAnimated();
+}
+
+// the joints of a compiled clip are already in our order
+void Skeleton::loadCompiled(CompiledClip const& clip) throw(ParseException) {
+	const unsigned first = getJointNum();
+	for (unsigned i = 0; i < clip.getJointNum(); ++i) {
+		CompiledClip::Joint const& j = clip.getJoints()[i];
+		if (j.parent >= (int) i) throw ParseException("a parent before its child", "a later one");
+		addJoint(j.parent < 0 ? -1 : (int) first + j.parent, clip.getName(j),
+				Point(j.offset[0], j.offset[1], j.offset[2]),
+				ChannelLayout(j.channels, j.channelNum));
+	}
+	findAnimated();
+}
+
+// adds a joint after all the others (so after its parent's subtree so far)
+unsigned Skeleton::addJoint(int parent, std::string const& name, Point const& offset,
+		ChannelLayout const& layout) {
+	const unsigned me = getJointNum();
+	parents.push_back(parent);
+	subtreeEnds.push_back(me + 1);
+	for (int a = parent; a >= 0; a = parents[a]) subtreeEnds[a] = me + 1;
+	depths.push_back(parent < 0 ? 0 : depths[parent] + 1);
+	if (parent < 0) roots.push_back(me);
+
+	offsets.push_back(offset);
+	worldOffsets.push_back(parent < 0 ? offset : worldOffsets[parent] + offset);
+	worldOffsetsE.push_back(getVectorFormDirection(worldOffsets[me]));
+
+	Eigen::Matrix3f b = Eigen::Matrix3f::Zero();
+	b(0,0) = offset.x();
+	b(1,0) = offset.y(),
+	b(2,0) = offset.z();
+	// so now it's like a column vector and 0s after it
+	if (offset.getLengthSqr() > EPS) {
+		projToBones.push_back(Eigen::Matrix3f::Identity() - (b * b.transpose()) * (1/ offset.getLengthSqr()));
+	} else {
+		projToBones.push_back(Eigen::Matrix3f::Zero()); // never used, there is nothing to project onto
+	}
+
+	layouts.push_back(layout);
+	nameOffsets.push_back(names.size());
+	names.append(name);
+	names.push_back('\0');
+	motion.push_back(std::vector<MotionFrame>());
+
+	if (debug::ison(debug::DETAILED))
+		std::cout << "Added joint " << getDescr(me) << std::endl;
+	return me;
+}
+
+void Skeleton::findAnimated() {
+	animated.clear();
+	for (unsigned j = 0; j < getJointNum(); ++j) {
+		if (!isLeaf(j)) animated.push_back(j);
+	}
+}
+
+std::string Skeleton::getDescr(unsigned joint) const {
+	std::stringstream ss;
+	ss << getName(joint) << "-" << joint;
+	return ss.str();
+}
+
+void Skeleton::getBoneSubTree(std::ostream& out, unsigned root) const {
+	for (unsigned j = root + 1; j < subtreeEnds[root]; ++j) {
+		out << getUpperBoneNum(j) << " " << getName(parents[j]) << " " << getName(j) << std::endl;
+	}
+}
+
+void Skeleton::getBoneDescr(std::ostream& out, unsigned root, int boneNum) const {
+	unsigned j = boneNum + 1;
+	if (boneNum < 0 || j <= root || j >= subtreeEnds[root]) return;
+	out << boneNum << " " << getName(parents[j]) << " " << getName(j);
+}
+
+/* Adds count frames to the joints. rows has the frames like they are in the
+ * file, rowLength values each, the channels of the joints one after the other.
+ * Each joint gathers its channels of all the frames into one array per
+ * channel and converts all the rotations in one go, that is many times faster
+ * than building the frames one by one.
+ */
+void Skeleton::addAnimationFrames(float const* rows, unsigned count, unsigned rowLength) {
+	if (count == 0) return;
+
+	// channels by channel, then the w x y z of the quaternions, then the matrices
+	std::vector<float> work((ChannelLayout::MAX + 4 + 12) * count);
+	float* byChannel[ChannelLayout::MAX];
+	for (unsigned c = 0; c < ChannelLayout::MAX; ++c) byChannel[c] = &work[c * count];
+	float* quat[4];
+	for (unsigned c = 0; c < 4; ++c) quat[c] = &work[(ChannelLayout::MAX + c) * count];
+	float* mats = &work[(ChannelLayout::MAX + 4) * count];
+
+	unsigned column = 0;
+	for (unsigned a = 0; a < animated.size(); ++a) {
+		const unsigned j = animated[a];
+		ChannelLayout const& layout = layouts[j];
+		std::fill(work.begin(), work.begin() + ChannelLayout::MAX * count, 0.0f);
+
+		unsigned char const* chans = layout.getChannels();
+		for (unsigned f = 0; f < count; ++f) {
+			float const* row = rows + f * rowLength + column;
+			for (unsigned i = 0; i < layout.getNum(); ++i) byChannel[chans[i]][f] = row[i];
+		}
+		column += layout.getNum();
+
+		layout.composeBatch(byChannel + ChannelLayout::XROT, count, quat);
+		eulerBatch::toMatrices(quat, layout.hasPosition() ? byChannel : NULL, count, mats);
+
+		for (unsigned f = 0; f < count; ++f) {
+			float values[ChannelLayout::MAX];
+			for (unsigned c = 0; c < ChannelLayout::MAX; ++c) values[c] = byChannel[c][f];
+			motion[j].push_back(MotionFrame(values,
+					Quaternion::fromComponents(quat[0][f], quat[1][f], quat[2][f], quat[3][f]),
+					mats + 12 * f));
+		}
+	}
+}
+
+// forgets all the frames
+void Skeleton::clearAnimation() {
+	for (unsigned j = 0; j < getJointNum(); ++j) motion[j].clear();
+}
+
+// makes room for this many frames, so adding them doesn't reallocate
+void Skeleton::reserveAnimation(unsigned frames) {
+	for (unsigned a = 0; a < animated.size(); ++a) motion[animated[a]].reserve(frames);
+}
+
+// how many numbers describe one frame
+unsigned Skeleton::getChannelNum() const {
+	unsigned sum = 0;
+	for (unsigned j = 0; j < getJointNum(); ++j) sum += layouts[j].getNum();
+	return sum;
+}
+
+
+/* Where the bones are in a pose sampled by Animation::samplePoses:
+ * poseMatrices has the 3x4 matrices of the animated joints, in order (NULL
+ * for the initial pose). ends gets the two ends of a bone per animated joint
+ * (6 floats), the bone to its first child. The joints are put together here,
+ * a parent always comes first.
+ */
+void Skeleton::boneLines(float const* poseMatrices, float* ends) const {
+	displayGlobal.resize(getJointNum(), Eigen::Matrix4f::Identity());
+	for (unsigned a = 0; a < animated.size(); ++a) {
+		const unsigned j = animated[a];
+		Eigen::Matrix4f local = Eigen::Matrix4f::Identity();
+		if (poseMatrices != NULL) {
+			float const* m = poseMatrices + 12 * a;
+			for (unsigned col = 0; col < 4; ++col) {
+				for (unsigned r = 0; r < 3; ++r) local(r, col) = m[col*3 + r];
+			}
+		}
+		local(0,3) += offsets[j].x();
+		local(1,3) += offsets[j].y();
+		local(2,3) += offsets[j].z();
+		displayGlobal[j] = (parents[j] < 0) ? local : Eigen::Matrix4f(displayGlobal[parents[j]] * local);
+
+		// the bone goes to the first child
+		Eigen::Vector4f from = displayGlobal[j].col(3);
+		Eigen::Vector4f to = displayGlobal[j] * getVectorFormPoint(offsets[j + 1]);
+		for (unsigned i = 0; i < 3; ++i) {
+			ends[6*a + i] = from(i);
+			ends[6*a + 3 + i] = to(i);
+		}
+	}
+}
+
+/* Displays the skeletons in a pose (see boneLines). All the bones are drawn
+ * as one array of lines, with color (rgb) and selectedBone in red.
+ * */
+void Skeleton::display(float const* poseMatrices, int selectedBone, float const* color) const {
+	if (animated.empty()) return;
+	lineVertices.resize(6 * animated.size());
+	lineColors.resize(6 * animated.size());
+	static const float red[3] = {1.0, 0, 0};
+
+	boneLines(poseMatrices, &lineVertices[0]);
+	for (unsigned a = 0; a < animated.size(); ++a) {
+		float const* c = (selectedBone == getBoneOfLine(a)) ? red : color;
+		for (unsigned i = 0; i < 3; ++i) lineColors[6*a + i] = lineColors[6*a + 3 + i] = c[i];
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, &lineVertices[0]);
+	glColorPointer(3, GL_FLOAT, 0, &lineColors[0]);
+	glDrawArrays(GL_LINES, 0, 2 * animated.size());
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+
+// x, y, z in both cases; this is a large upper bound!!
+void Skeleton::offsetBounds(float * mins, float * maxs) const {
+	for (unsigned j = 0; j < getJointNum(); ++j) {
+		float o[3] = {offsets[j].x(), offsets[j].y(), offsets[j].z()};
+		for (unsigned i = 0; i < 3; ++i) {
+			if (o[i] < 0) {
+				mins[i] += o[i];
+			} else {
+				maxs[i] += o[i];
+			}
+		}
+	}
+}
+
+inline void printRepeated(std::ostream& out, unsigned reps, char const * pattern) {
+	for (unsigned i = 0; i < reps; ++i) out << pattern;
+}
+
+/* Prints the names of the subtree of root, with as many "- " thingies in front
+ * of each as deep it is.
+ */
+void Skeleton::printNames(unsigned root) const {
+	for (unsigned j = root; j < subtreeEnds[root]; ++j) {
+		printRepeated(std::cout, depths[j] - depths[root], "- ");
+		std::cout << getName(j) << ": \t "
+				<< offsets[j].x() << ", "
+				<< offsets[j].y() << ", "
+				<< offsets[j].z() << ", " << std::endl;
+	}
+}
+
+/* print the hierarchy in the BVH file format, into 'out'. A joint is
+ * ROOT/JOINT name { .... } (or End Site { OFFSET .. }), and the } of the joints
+ * whose subtree ends with it come right after a leaf
+ * (we assume roots are not leaves! that wouldn't make sense)
+ */
+void Skeleton::printTreeBVH(std::ostream& out) const {
+	for (unsigned j = 0; j < getJointNum(); ++j) {
+		const unsigned level = depths[j];
+		printRepeated(out, level, "\t");
+		if (isLeaf(j)) {
+			out << "End Site" << std::endl;
+		} else {
+			out << (level == 0 ? "ROOT " : "JOINT ") << getName(j) << std::endl;
+		}
+		printRepeated(out, level, "\t");
+		out << "{" << std::endl;
+		printRepeated(out, level + 1, "\t");
+		out << "OFFSET " << offsets[j].x() << " " << offsets[j].y() << " " << offsets[j].z() << std::endl;
+		if (!isLeaf(j)) {
+			printRepeated(out, level + 1, "\t");
+			layouts[j].print(out);
+			out << std::endl;
+			continue;
+		}
+		// close everything down to the level of the next joint
+		const unsigned nextLevel = (j + 1 < getJointNum()) ? depths[j + 1] : 0;
+		for (int l = level; l >= (int) nextLevel; --l) {
+			printRepeated(out, l, "\t");
+			out << "}" << std::endl;
+		}
+	}
+}
+
+
+
+/* Adds the joints to joints (the format of compiled clips), which is the
+ * order we have them in already.
+ */
+void Skeleton::compile(std::vector<CompiledClip::Joint>& joints, std::string& allNames) const {
+	for (unsigned me = 0; me < getJointNum(); ++me) {
+		CompiledClip::Joint j;
+		memset(&j, 0, sizeof(j));
+		j.parent = parents[me];
+		j.nameOffset = allNames.size();
+		allNames.append(getName(me));
+		allNames.push_back('\0');
+		j.channelNum = layouts[me].getNum();
+		memcpy(j.channels, layouts[me].getChannels(), layouts[me].getNum());
+		j.offset[0] = offsets[me].x();
+		j.offset[1] = offsets[me].y();
+		j.offset[2] = offsets[me].z();
+		joints.push_back(j);
+	}
+}
+
+
+/**Returns the list of bones (identified by the end sites) of the subtree of
+ * root that are closest (within EPS distance) to the given point. p is in
+ * world coordinates.
+ */
+void Skeleton::getClosestBones(unsigned root, Point const& p, std::set<Attachment>& bones) const {
+	// p in the frame of each joint, so that the joint is at (0,0)
+	std::vector<Point> rel(subtreeEnds[root] - root);
+
+	for (unsigned j = root; j < subtreeEnds[root]; ++j) {
+		rel[j - root] = ((j == root) ? p : rel[parents[j] - root]) - offsets[j];
+		if (isLeaf(j)) continue;
+		Point const& q = rel[j - root];
+
+		for (unsigned c = j + 1; c < subtreeEnds[j]; c = subtreeEnds[c]) {
+			Point const& bone = offsets[c];
+			Point closestPoint;
+			float pb = q.dot(bone);
+			float dist;
+
+			// if we only want to consider visible connections, need to test whether
+			// shortest line connecting bone to vertex crosses any faces. (see assumptions)
+
+			if (pb <= 0) { // takes care of bonelength = 0 case
+				// connection is from upperjoint to p
+				closestPoint = worldOffsets[j];
+				dist = q.getLength();
+			}
+			else if (pb >= bone.getLengthSqr()) {
+				// connection is from lowerjoint to p
+				closestPoint = worldOffsets[c];
+				dist = (q - bone).getLength();
+			}
+			else {
+				Eigen::Vector3f v(q.x(),q.y(),q.z());
+				Eigen::Vector3f delta = projToBones[c]*v; // vector from attachment point to p
+
+				// connection is from projmatrix*p=delta (have to put it in world coords!) to p
+				closestPoint = q-Point(delta)+worldOffsets[j];
+
+				dist = delta.squaredNorm(); // length
+			}
+
+			if (debug::ison(debug::EVERYTHING)) {
+				std::cout << getUpperBoneNum(c) << " " << getDescr(j) << ":"  << getDescr(c)
+						<< ". Dist=" << dist;
+			}
+
+			// now just put it in the set.. ordered automatically
+			bones.insert(Attachment(*this, c, closestPoint, dist));
+		}
+	}
+}
+
+
+// the joint whose transformation (and its parents' up to root) moves what is
+// attached to bone boneNum of the subtree of root
+unsigned Skeleton::getSkinningJoint(unsigned root, int boneNum) const {
+	// go down towards the bone (since we did dfs bone nums have bracket property):
+	// into the last child whose bone is not after it, until we are at a leaf or
+	// at the joint numbered boneNum
+	unsigned j = root;
+	while (boneNum != (int) j) {
+		int next = -1;
+		for (unsigned c = j + 1; c < subtreeEnds[j] && getUpperBoneNum(c) <= boneNum; c = subtreeEnds[c]) {
+			next = c;
+		}
+		if (next < 0 || isLeaf(next)) break;
+		j = next;
+	}
+	return j;
+}
+
+// Take p in world coordinates and change it to where it would be if it was
+// attached to bone boneNum (of the subtree of root) in frame frameNum
+void Skeleton::getLocation(unsigned root, Eigen::Vector4f & p, int boneNum, unsigned frameNum) const {
+	if (isLeaf(root)) return;
+	const unsigned j = getSkinningJoint(root, boneNum);
+
+	// then the transformations from there up to the root
+	for (unsigned a = j; ; a = parents[a]) {
+		p -= worldOffsetsE[a];
+		p = motion[a][frameNum].getMatrix() * p;
+		p += worldOffsetsE[a];
+		if (a == root) break;
+	}
+}
+
+
+/* What getLocation does for every bone of the first root at once, for a
+ * pose (3x4 matrices of the animated joints, see display) instead of a
+ * frame: out gets a 3x4 matrix per bone (as many as joints) that takes a
+ * point of the initial pose to where it goes with that bone.
+ * joint is scratch of the caller, 12 floats per joint as well.
+ */
+void Skeleton::skinningMatrices(float const* poseMatrices, float* out, float* joint) const {
+	// per joint: its transformation about its initial position, after its parents'
+	std::fill(joint, joint + 12 * getJointNum(), 0.0f);
+	for (unsigned j = 0; j < getJointNum(); ++j) joint[12*j] = joint[12*j + 4] = joint[12*j + 8] = 1;
+	for (unsigned a = 0; a < animated.size(); ++a) {
+		const unsigned j = animated[a];
+		float const* m = poseMatrices + 12 * a;
+		const float w[3] = {worldOffsets[j].x(), worldOffsets[j].y(), worldOffsets[j].z()};
+		// m about w: the rotation of m, the translation m.t + w - R w
+		float local[12];
+		for (unsigned i = 0; i < 9; ++i) local[i] = m[i];
+		for (unsigned r = 0; r < 3; ++r) {
+			local[9 + r] = m[9 + r] + w[r] - (m[r]*w[0] + m[3 + r]*w[1] + m[6 + r]*w[2]);
+		}
+		float* g = &joint[12*j];
+		if (parents[j] < 0) {
+			std::copy(local, local + 12, g);
+			continue;
+		}
+		float const* p = &joint[12*parents[j]];
+		for (unsigned col = 0; col < 4; ++col) {
+			for (unsigned r = 0; r < 3; ++r) {
+				g[3*col + r] = p[r]*local[3*col] + p[3 + r]*local[3*col + 1] + p[6 + r]*local[3*col + 2]
+						+ (col == 3 ? p[9 + r] : 0);
+			}
+		}
+	}
+
+	const unsigned root = getRoot(0);
+	for (unsigned b = 0; b < getJointNum(); ++b) {
+		float* o = out + 12 * b;
+		if (isLeaf(root)) {
+			std::fill(o, o + 12, 0.0f);
+			o[0] = o[4] = o[8] = 1;
+		} else {
+			float const* g = &joint[12 * getSkinningJoint(root, (int) b)];
+			std::copy(g, g + 12, o);
+		}
+	}
+}
+
+// replaces the frames of every joint with newFrameNum frames, new frame i
+// being at old frame i*step
+void Skeleton::resample(double step, unsigned newFrameNum) {
+	// each joint's track is independent of the others
+	#pragma omp parallel for schedule(dynamic)
+	for (int a = 0; a < (int) animated.size(); ++a) {
+		TRACE_SCOPE("resample joint");
+		std::vector<MotionFrame>& frames = motion[animated[a]];
+		ChannelLayout const& layout = layouts[animated[a]];
+		if (frames.empty()) continue;
+
+		std::vector<MotionFrame> newMotion;
+		newMotion.reserve(newFrameNum);
+		for (unsigned i = 0; i < newFrameNum; ++i) {
+			double t = i * step;
+			unsigned f = (unsigned) t;
+			double frac = t - f;
+			if (f + 1 >= frames.size()) { // don't go past the end (no looping here)
+				f = frames.size() - 1;
+				frac = 0;
+			}
+			if (frac < 0.0001) {
+				newMotion.push_back(frames[f]);
+			} else {
+				newMotion.push_back(frames[f].blend(frames[f+1], frac, layout));
+			}
+		}
+		frames.swap(newMotion);
+	}
+}
+
+void Skeleton::reportMemory(MemoryUse& use) const {
+	use.add("motion tracks", MemoryUse::bytesOf(motion));
+	use.add("skeleton", MemoryUse::bytesOf(parents) + MemoryUse::bytesOf(subtreeEnds) + MemoryUse::bytesOf(depths)
+			+ MemoryUse::bytesOf(offsets) + MemoryUse::bytesOf(worldOffsets) + MemoryUse::bytesOf(worldOffsetsE)
+			+ MemoryUse::bytesOf(projToBones) + MemoryUse::bytesOf(layouts) + names.capacity()
+			+ MemoryUse::bytesOf(nameOffsets) + MemoryUse::bytesOf(roots) + MemoryUse::bytesOf(animated)
+			+ MemoryUse::bytesOf(displayGlobal) + MemoryUse::bytesOf(lineVertices) + MemoryUse::bytesOf(lineColors));
+}
+
+
+// enlarges the axis-aligned box defined by the parameters so that each translated
+// point fits into the box
+void MotionFrame::closestFit(std::vector<MotionFrame> const & frames,
+		float& xMin, float& xMax, float& yMin, float& yMax, float& zMin, float& zMax)  {
+	for (std::vector<MotionFrame>::const_iterator it = frames.begin();
+			it != frames.end(); ++it) {
+		float x = it->values[ChannelLayout::XPOS];
+		float y = it->values[ChannelLayout::YPOS];
+		float z = it->values[ChannelLayout::ZPOS];
+		if (x < xMin) xMin = x;
+		if (x > xMax) xMax = x;
+		if (y < yMin) yMin = y;
+		if (y > yMax) yMax = y;
+		if (z < zMin) zMin = z;
+		if (z > zMax) zMax = z;
+	}
+}
+
+
+// interpolates between this frame and nextFrame. We are fracPart into the next frame
+// simply put the calculated new semi-frame into ret
+void MotionFrame::interpolate(MotionFrame const & nextFrame, double fracPart, MotionFrame & ret) const {
+	// first calculate the position:
+	double o = 1-fracPart;
+	for (unsigned i = ChannelLayout::XPOS; i <= ChannelLayout::ZPOS; ++i) {
+		ret.values[i] = fracPart * nextFrame.values[i] + o * values[i];
+	}
+
+	// now calculate the interpolated angle
+	Quaternion::slerp(rotations, nextFrame.rotations, fracPart, ret.rotations);
+
+	// now just update the modelTrans of ret (the position is 0 if the joint has none):
+	ret.rotations.getRotation(ret.modelTrans);
+	ret.modelTrans[12] = ret.values[ChannelLayout::XPOS];
+	ret.modelTrans[13] = ret.values[ChannelLayout::YPOS];
+	ret.modelTrans[14] = ret.values[ChannelLayout::ZPOS];
+}
+
+// like interpolate, but gives a complete frame (angles, matrix and all)
+// that can be stored and printed like the ones read from the file
+MotionFrame MotionFrame::blend(MotionFrame const & nextFrame, double fracPart, ChannelLayout const& layout) const {
+	MotionFrame ret;
+	interpolate(nextFrame, fracPart, ret);
+	// (a joint with less than 3 rotations only keeps the angles it has, which
+	// is exact for one axis and very close for two, since both ends have no third)
+	float rad[3];
+	unsigned char const* order = layout.getRotationOrder();
+	ret.rotations.getEuler(order, rad);
+	for (unsigned i = 0; i < 3; ++i) {
+		ret.values[ChannelLayout::XROT + order[i]] =
+				(i < layout.getRotationNum()) ? radToDeg(rad[order[i]]) : 0;
+	}
+	ret.genMatrix(layout);
+	return ret;
+}
+
+MotionFrame::MotionFrame(float const* byChannel, Quaternion const& rot, float const* m3x4) :
+		rotations(rot) {
+	for (unsigned i = 0; i < ChannelLayout::MAX; ++i) values[i] = byChannel[i];
+	for (unsigned col = 0; col < 4; ++col) {
+		for (unsigned r = 0; r < 3; ++r) modelTrans[col*4 + r] = m3x4[col*3 + r];
+		modelTrans[col*4 + 3] = (col == 3) ? 1 : 0;
+	}
+	for (unsigned i = 0; i < 16; ++i)
+		transf(i%4, i/4) = modelTrans[i];
+}
+
+// generates the transformation matrix for this frame
+void MotionFrame::genMatrix(ChannelLayout const& layout) {
+
+	// Quaternion stuff (composed in the order of the channels)
+	Quaternion rot = layout.compose(values + ChannelLayout::XROT);
+	rot.getRotation(modelTrans);
+	if (layout.hasPosition()) {
+		modelTrans[12] = values[ChannelLayout::XPOS];
+		modelTrans[13] = values[ChannelLayout::YPOS];
+		modelTrans[14] = values[ChannelLayout::ZPOS];
+	}
+	rotations = rot;
+
+	// generate the Eigen matrix
+	for (unsigned i = 0; i < 16; ++i)
+		transf(i%4, i/4) = modelTrans[i];
+
+	if (debug::ison(debug::EVERYTHING)) print4x4Matrix(modelTrans);
+
+}
+
+
+// applies the transformation matrix corresponding to this frame
+void MotionFrame::applyTransformation() const {
+	glMultMatrixf(modelTrans);
+}
@@ -0,0 +1,185 @@
+/*
+ * Skeleton.h
+ * The joints of all the skeletons of a .bvh file and their motion, kept flat:
+ * joints are numbered depth first (a parent comes before its children, and
+ * a subtree is the range of numbers up to subtreeEnds), and everything about a
+ * joint is in arrays indexed by its number. So walking the hierarchy is a loop
+ * over the arrays, and two Skeletons never share anything.
+ *
+ * Leaves are the End Sites; the other joints are the animated ones. The bone
+ * ending at joint j is bone j-1 (bones are numbered as in the attach matrices).
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef SKELETON_H_
+#define SKELETON_H_
+
+#include "myexceptions.h"
+#include "Quaternion.h"
+#include "geometry.h"
+#include "Attachment.h"
+#include "CompiledClip.h"
+#include "ChannelLayout.h"
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <set>
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+class MemoryUse;
+
+class MotionFrame {
+	// these can't be const since they are put in a vector where the elements
+	// need to be assignable, .. but they really should not be changed!
+private:
+	// (the ChannelLayout is the same for all frames of a joint, the Skeleton keeps it)
+	float values[ChannelLayout::MAX]; // indexed by ChannelLayout::Channel, 0 if the joint doesn't have it
+	float modelTrans[16]; // all transformations of model -- in matrix format
+	Eigen::Matrix4f transf; // all transformations of model -- in matrix format
+//	Eigen::Map<const Eigen::Matrix4f> transf; // all transformations of model -- in matrix format
+	Quaternion rotations;
+
+
+public:
+
+	// in general don't use this one.. leaves the frame in undefined state
+	MotionFrame() {};
+
+	// channels has the values in the order of the file (layout.getNum() of them)
+	template <class T>
+	MotionFrame(ChannelLayout const& layout, T const* channels) {
+		for (unsigned i = 0; i < ChannelLayout::MAX; ++i) values[i] = 0;
+		unsigned char const* chans = layout.getChannels();
+		for (unsigned i = 0; i < layout.getNum(); ++i) values[chans[i]] = channels[i];
+		genMatrix(layout);
+	}
+	// for frames converted in a batch (see Skeleton::addAnimationFrames):
+	// values by channel, and the rotation with its 3x4 matrix already made
+	MotionFrame(float const* byChannel, Quaternion const& rot, float const* m3x4);
+
+	// layout is the one of the joint this frame is of (here and below)
+	void genMatrix(ChannelLayout const& layout);
+	Eigen::Matrix4f const& getMatrix() const { return transf; }
+	Quaternion const& getRotation() const { return rotations; }
+	float getValue(unsigned channel) const { return values[channel]; }
+//	Eigen::Map<const Eigen::Matrix4f> const& getMatrix() {return transf;}
+	void applyTransformation() const;
+	void printFrame(std::ostream& out, ChannelLayout const& layout) const {
+		unsigned char const* chans = layout.getChannels();
+		for (unsigned i = 0; i < layout.getNum(); ++i) out << values[chans[i]] << " ";
+	}
+	// same order as printFrame
+	void appendChannels(std::vector<float>& row, ChannelLayout const& layout) const {
+		unsigned char const* chans = layout.getChannels();
+		for (unsigned i = 0; i < layout.getNum(); ++i) row.push_back(values[chans[i]]);
+	}
+	static void closestFit(std::vector<MotionFrame> const & frames,
+			float& xMin, float& xMax, float& yMin, float& yMax, float& zMin, float& zMax);
+
+	void interpolate(MotionFrame const & nextFrame, double fracPart, MotionFrame & ret) const;
+	MotionFrame blend(MotionFrame const & nextFrame, double fracPart, ChannelLayout const& layout) const;
+};
+
+
+
+class Skeleton {
+
+private:
+	std::vector<int> parents; // -1 for roots
+	std::vector<unsigned> subtreeEnds; // one past the last joint under this one
+	std::vector<unsigned> depths; // 0 for roots
+	std::vector<Point> offsets;
+	// where the joints are (with the offset!) in world coordinates in the initial
+	// pose, that is the location of the endpoint of their bone
+	std::vector<Point> worldOffsets;
+	std::vector<Eigen::Vector4f, Eigen::aligned_allocator<Eigen::Vector4f> > worldOffsetsE;
+	// projects onto the incoming bone
+	std::vector<Eigen::Matrix3f, Eigen::aligned_allocator<Eigen::Matrix3f> > projToBones;
+	std::vector<ChannelLayout> layouts;
+	std::string names; // all the names, each ended by a '\0'
+	std::vector<unsigned> nameOffsets;
+	std::vector<unsigned> roots;
+	std::vector<unsigned> animated; // the non-leaves, in order (the joints a Pose has)
+	std::vector< std::vector<MotionFrame> > motion; // empty for leaves
+
+	// what display (and boneLines) fills, kept so it doesn't allocate: the world
+	// matrices of the joints, then the two ends and their colours per bone
+	mutable std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > displayGlobal;
+	mutable std::vector<float> lineVertices;
+	mutable std::vector<float> lineColors;
+
+public:
+	// reads one ROOT (the word ROOT itself already read) from the hierarchy of a .bvh
+	void parseRoot(std::istream& descr) throw(ParseException);
+	// takes all the joints of a compiled clip
+	void loadCompiled(CompiledClip const& clip) throw(ParseException);
+
+	unsigned getJointNum() const { return parents.size(); }
+	unsigned getRootNum() const { return roots.size(); }
+	unsigned getRoot(unsigned i) const { return roots[i]; }
+	std::vector<unsigned> const& getAnimatedJoints() const { return animated; }
+	bool isLeaf(unsigned joint) const { return subtreeEnds[joint] == joint + 1; }
+	char const* getName(unsigned joint) const { return names.c_str() + nameOffsets[joint]; }
+	std::string getDescr(unsigned joint) const;
+	// the boneNum corresponding to the bone ending at this joint
+	static int getUpperBoneNum(unsigned joint) { return (int) joint - 1; }
+
+	void getBoneSubTree(std::ostream& out, unsigned root) const;
+	void getBoneDescr(std::ostream& out, unsigned root, int boneNum) const;
+	void printNames(unsigned root) const;
+
+	void display(float const* poseMatrices, int selectedBone, float const* color) const;
+	void boneLines(float const* poseMatrices, float* ends) const;
+	unsigned getBoneLineNum() const { return animated.size(); }
+	// the boneNum of line a of boneLines
+	int getBoneOfLine(unsigned a) const { return getUpperBoneNum(animated[a] + 1); }
+
+	void addAnimationFrames(float const* rows, unsigned count, unsigned rowLength);
+	void clearAnimation();
+	void reserveAnimation(unsigned frames);
+	unsigned getAnimFrameNum(unsigned joint) const { return motion[joint].size(); }
+	MotionFrame const& getFrame(unsigned joint, unsigned frame) const { return motion[joint][frame]; }
+	ChannelLayout const& getLayout(unsigned joint) const { return layouts[joint]; }
+	unsigned getChannelNum() const;
+
+	void printTreeBVH(std::ostream& out) const;
+	void printFrameBVH(std::ostream& out, unsigned frame) const {
+		for (unsigned a = 0; a < animated.size(); ++a) motion[animated[a]][frame].printFrame(out, layouts[animated[a]]);
+	}
+	void appendFrameChannels(std::vector<float>& row, unsigned frame) const {
+		for (unsigned a = 0; a < animated.size(); ++a) motion[animated[a]][frame].appendChannels(row, layouts[animated[a]]);
+	}
+	void compile(std::vector<CompiledClip::Joint>& joints, std::string& names) const;
+
+	void getClosestBones(unsigned root, Point const& p, std::set<Attachment>& bones) const;
+
+	// enlarges the axis-aligned box defined by the parameters so that each translated
+	// root fits into the box
+	void closestAnimationFit(float& xMin, float& xMax,
+			float& yMin, float& yMax, float& zMin, float& zMax) const {
+		// we assume only roots have translations!
+		for (unsigned r = 0; r < roots.size(); ++r)
+			MotionFrame::closestFit(motion[roots[r]], xMin, xMax, yMin, yMax, zMin, zMax);
+	}
+	void offsetBounds(float * mins, float * maxs) const;
+
+	void getLocation(unsigned root, Eigen::Vector4f & p, int boneNum, unsigned frameNum) const;
+	unsigned getSkinningJoint(unsigned root, int boneNum) const;
+	void skinningMatrices(float const* poseMatrices, float* out, float* joint) const;
+
+	void resample(double step, unsigned newFrameNum);
+
+	// the motion tracks and the rest of the skeleton
+	void reportMemory(MemoryUse& use) const;
+
+private:
+	unsigned addJoint(int parent, std::string const& name, Point const& offset,
+			ChannelLayout const& layout);
+	void findAnimated();
+};
+
+#endif /* SKELETON_H_ */
@@ -0,0 +1,274 @@
+/*
+ * SoftRenderer.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "SoftRenderer.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+
+// the light of the viewer: 0.2 global and 0.5 light ambient, the diffuse of GL_LIGHT0 is 1
+static const float AMBIENT = 0.7f;
+
+SoftRenderer::SoftRenderer(unsigned width_, unsigned height_) :
+		width(width_), height(height_),
+		tilesX((width_ + TILE - 1) / TILE), tilesY((height_ + TILE - 1) / TILE),
+		color(3 * width_ * height_, 0), depth(width_ * height_, 1.0f),
+		mode(SMOOTH), viewProjection(Eigen::Matrix4f::Identity()), tileItems(tilesX * tilesY) {
+	light[0] = 0;
+	light[1] = 10.5;
+	light[2] = 13.0;
+}
+
+void SoftRenderer::setCamera(float const* eye, float const* centre, float const* up,
+		float fovY, float near, float far) {
+	// gluLookAt
+	Eigen::Vector3f e(eye[0], eye[1], eye[2]);
+	Eigen::Vector3f f = (Eigen::Vector3f(centre[0], centre[1], centre[2]) - e).normalized();
+	Eigen::Vector3f s = f.cross(Eigen::Vector3f(up[0], up[1], up[2])).normalized();
+	Eigen::Vector3f u = s.cross(f);
+	Eigen::Matrix4f view = Eigen::Matrix4f::Identity();
+	view.block<1,3>(0,0) = s.transpose();
+	view.block<1,3>(1,0) = u.transpose();
+	view.block<1,3>(2,0) = -f.transpose();
+	view(0,3) = -s.dot(e);
+	view(1,3) = -u.dot(e);
+	view(2,3) = f.dot(e);
+
+	// gluPerspective
+	const float cot = 1 / std::tan(fovY * 0.5f * (float) M_PI / 180);
+	Eigen::Matrix4f projection = Eigen::Matrix4f::Zero();
+	projection(0,0) = cot * height / width;
+	projection(1,1) = cot;
+	projection(2,2) = (far + near) / (near - far);
+	projection(2,3) = 2 * far * near / (near - far);
+	projection(3,2) = -1;
+
+	viewProjection = projection * view;
+}
+
+void SoftRenderer::clear(float r, float g, float b) {
+	const unsigned char rgb[3] = {(unsigned char) (255 * r), (unsigned char) (255 * g), (unsigned char) (255 * b)};
+	for (unsigned p = 0; p < width * height; ++p) std::copy(rgb, rgb + 3, &color[3*p]);
+	std::fill(depth.begin(), depth.end(), 1.0f);
+}
+
+// into pixels: x, y, depth and 1/w per vertex
+void SoftRenderer::transform(float const* positions, unsigned vertexNum) {
+	screen.resize(4 * vertexNum);
+	visible.resize(vertexNum);
+	#pragma omp parallel for schedule(static)
+	for (int v = 0; v < (int) vertexNum; ++v) {
+		Eigen::Vector4f clip = viewProjection * Eigen::Vector4f(positions[3*v], positions[3*v+1], positions[3*v+2], 1);
+		visible[v] = (clip(3) > 1e-6f); // not behind the eye
+		const float invW = visible[v] ? 1 / clip(3) : 0;
+		screen[4*v] = (clip(0) * invW * 0.5f + 0.5f) * width;
+		screen[4*v+1] = (0.5f - clip(1) * invW * 0.5f) * height;
+		screen[4*v+2] = clip(2) * invW * 0.5f + 0.5f;
+		screen[4*v+3] = invW;
+	}
+}
+
+void SoftRenderer::binTriangles(unsigned const* indices, unsigned triangleNum) {
+	for (unsigned t = 0; t < tileItems.size(); ++t) tileItems[t].clear();
+	// a bit more around them for the lines of the wire frame
+	const float extra = (mode == WIREFRAME) ? 1 : 0;
+	for (unsigned t = 0; t < triangleNum; ++t) {
+		unsigned const* v = indices + 3*t;
+		if (!visible[v[0]] || !visible[v[1]] || !visible[v[2]]) continue;
+		float lo[2], hi[2];
+		for (unsigned a = 0; a < 2; ++a) {
+			lo[a] = std::min(screen[4*v[0] + a], std::min(screen[4*v[1] + a], screen[4*v[2] + a])) - extra;
+			hi[a] = std::max(screen[4*v[0] + a], std::max(screen[4*v[1] + a], screen[4*v[2] + a])) + extra;
+		}
+		if (hi[0] < 0 || hi[1] < 0 || lo[0] >= width || lo[1] >= height) continue;
+		const unsigned x0 = (unsigned) std::max(0.0f, lo[0]) / TILE, y0 = (unsigned) std::max(0.0f, lo[1]) / TILE;
+		const unsigned x1 = std::min(tilesX - 1, (unsigned) hi[0] / TILE), y1 = std::min(tilesY - 1, (unsigned) hi[1] / TILE);
+		for (unsigned y = y0; y <= y1; ++y) {
+			for (unsigned x = x0; x <= x1; ++x) tileItems[y * tilesX + x].push_back(t);
+		}
+	}
+}
+
+// the lines are the vertices 2l and 2l+1 of screen
+void SoftRenderer::binLines(unsigned lineNum, unsigned thickness) {
+	for (unsigned t = 0; t < tileItems.size(); ++t) tileItems[t].clear();
+	const float extra = thickness;
+	for (unsigned l = 0; l < lineNum; ++l) {
+		if (!visible[2*l] || !visible[2*l+1]) continue;
+		float lo[2], hi[2];
+		for (unsigned a = 0; a < 2; ++a) {
+			lo[a] = std::min(screen[8*l + a], screen[8*l + 4 + a]) - extra;
+			hi[a] = std::max(screen[8*l + a], screen[8*l + 4 + a]) + extra;
+		}
+		if (hi[0] < 0 || hi[1] < 0 || lo[0] >= width || lo[1] >= height) continue;
+		const unsigned x0 = (unsigned) std::max(0.0f, lo[0]) / TILE, y0 = (unsigned) std::max(0.0f, lo[1]) / TILE;
+		const unsigned x1 = std::min(tilesX - 1, (unsigned) hi[0] / TILE), y1 = std::min(tilesY - 1, (unsigned) hi[1] / TILE);
+		for (unsigned y = y0; y <= y1; ++y) {
+			for (unsigned x = x0; x <= x1; ++x) tileItems[y * tilesX + x].push_back(l);
+		}
+	}
+}
+
+static inline float edge(float const* a, float const* b, float x, float y) {
+	return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+void SoftRenderer::fillTriangles(unsigned tile, unsigned const* indices, float const* colors) {
+	const int tx0 = (tile % tilesX) * TILE, ty0 = (tile / tilesX) * TILE;
+	const int tx1 = std::min(tx0 + (int) TILE, (int) width), ty1 = std::min(ty0 + (int) TILE, (int) height);
+	static const float white[4] = {1, 1, 1, 1};
+
+	std::vector<unsigned> const& items = tileItems[tile];
+	for (unsigned i = 0; i < items.size(); ++i) {
+		unsigned const* v = indices + 3 * items[i];
+		float const* a = &screen[4*v[0]];
+		float const* b = &screen[4*v[1]];
+		float const* c = &screen[4*v[2]];
+		// counter clockwise (in front) is clockwise here, y goes down
+		const float area = edge(a, b, c[0], c[1]);
+		if (area >= 0) continue; // back faces are culled, as in the viewer when shaded
+
+		const int x0 = std::max(tx0, (int) std::floor(std::min(a[0], std::min(b[0], c[0]))));
+		const int x1 = std::min(tx1 - 1, (int) std::ceil(std::max(a[0], std::max(b[0], c[0]))));
+		const int y0 = std::max(ty0, (int) std::floor(std::min(a[1], std::min(b[1], c[1]))));
+		const int y1 = std::min(ty1 - 1, (int) std::ceil(std::max(a[1], std::max(b[1], c[1]))));
+
+		// the colours at the corners (flat: all that of the last one, like GL)
+		float corner[3][3];
+		for (unsigned k = 0; k < 3; ++k) {
+			const unsigned from = (mode == FLAT) ? v[2] : v[k];
+			float const* rgb = colors ? colors + 4*from : white;
+			for (unsigned ch = 0; ch < 3; ++ch) corner[k][ch] = std::min(1.0f, rgb[ch] * lit[from]);
+		}
+
+		const float inv = 1 / area;
+		for (int y = y0; y <= y1; ++y) {
+			for (int x = x0; x <= x1; ++x) {
+				const float px = x + 0.5f, py = y + 0.5f;
+				float w0 = edge(b, c, px, py) * inv;
+				float w1 = edge(c, a, px, py) * inv;
+				float w2 = edge(a, b, px, py) * inv;
+				if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+				const float z = w0 * a[2] + w1 * b[2] + w2 * c[2];
+				const unsigned p = y * width + x;
+				if (z < 0 || z >= depth[p]) continue;
+				depth[p] = z;
+				// perspective correct
+				float p0 = w0 * a[3], p1 = w1 * b[3], p2 = w2 * c[3];
+				const float sum = 1 / (p0 + p1 + p2);
+				p0 *= sum; p1 *= sum; p2 *= sum;
+				for (unsigned ch = 0; ch < 3; ++ch) {
+					color[3*p + ch] = (unsigned char) (255 * (p0 * corner[0][ch] + p1 * corner[1][ch] + p2 * corner[2][ch]) + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+/* The lines of the items of the tile: the edges of the triangles (with
+ * indices, colours per vertex), or the lines of drawLines (colours per line).
+ */
+void SoftRenderer::fillLines(unsigned tile, float const* colors, unsigned thickness, bool ofTriangles,
+		unsigned const* indices) {
+	const int tx0 = (tile % tilesX) * TILE, ty0 = (tile / tilesX) * TILE;
+	const int tx1 = std::min(tx0 + (int) TILE, (int) width), ty1 = std::min(ty0 + (int) TILE, (int) height);
+	const int below = (thickness - 1) / 2; // how far the brush goes left of and above the line
+	static const float white[4] = {1, 1, 1, 1};
+
+	std::vector<unsigned> const& items = tileItems[tile];
+	for (unsigned i = 0; i < items.size(); ++i) {
+		for (unsigned e = 0; e < (ofTriangles ? 3u : 1u); ++e) {
+			unsigned from, to;
+			float const* rgbFrom;
+			float const* rgbTo;
+			if (ofTriangles) {
+				from = indices[3 * items[i] + e];
+				to = indices[3 * items[i] + (e + 1) % 3];
+				rgbFrom = colors ? colors + 4*from : white;
+				rgbTo = colors ? colors + 4*to : white;
+			} else {
+				from = 2 * items[i];
+				to = from + 1;
+				rgbFrom = rgbTo = colors + 3 * items[i];
+			}
+			float const* a = &screen[4*from];
+			float const* b = &screen[4*to];
+			const int steps = std::max(1, (int) std::ceil(std::max(std::abs(b[0] - a[0]), std::abs(b[1] - a[1]))));
+			for (int s = 0; s <= steps; ++s) {
+				const float t = (float) s / steps;
+				const int x = (int) std::floor(a[0] + t * (b[0] - a[0])) - below;
+				const int y = (int) std::floor(a[1] + t * (b[1] - a[1])) - below;
+				if (x + (int) thickness <= tx0 || x >= tx1 || y + (int) thickness <= ty0 || y >= ty1) continue;
+				const float z = a[2] + t * (b[2] - a[2]);
+				if (z < 0) continue;
+				for (int py = std::max(y, ty0); py < std::min(y + (int) thickness, ty1); ++py) {
+					for (int px = std::max(x, tx0); px < std::min(x + (int) thickness, tx1); ++px) {
+						const unsigned p = py * width + px;
+						if (z > depth[p]) continue;
+						depth[p] = z;
+						for (unsigned ch = 0; ch < 3; ++ch) {
+							color[3*p + ch] = (unsigned char) (255 * std::min(1.0f, (1 - t) * rgbFrom[ch] + t * rgbTo[ch]) + 0.5f);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void SoftRenderer::drawMesh(float const* positions, float const* normals, float const* colors,
+		unsigned vertexNum, unsigned const* indices, unsigned triangleNum) {
+	TRACE_SCOPE("draw soft mesh");
+	transform(positions, vertexNum);
+
+	// lit at the vertices (the point light, two sided)
+	lit.resize(vertexNum);
+	if (mode != WIREFRAME) {
+		#pragma omp parallel for schedule(static)
+		for (int v = 0; v < (int) vertexNum; ++v) {
+			float l[3];
+			for (unsigned i = 0; i < 3; ++i) l[i] = light[i] - positions[3*v + i];
+			const float len = std::sqrt(l[0]*l[0] + l[1]*l[1] + l[2]*l[2]);
+			const float d = (len > 0) ? (l[0]*normals[3*v] + l[1]*normals[3*v+1] + l[2]*normals[3*v+2]) / len : 0;
+			lit[v] = AMBIENT + std::max(0.0f, d);
+		}
+	}
+
+	binTriangles(indices, triangleNum);
+	// traced per thread, a tile is too little work for a scope of its own
+	#pragma omp parallel
+	{
+		TRACE_SCOPE("fill tiles");
+		#pragma omp for schedule(dynamic)
+		for (int t = 0; t < (int) tileItems.size(); ++t) {
+			if (mode == WIREFRAME) fillLines(t, colors, 1, true, indices);
+			else fillTriangles(t, indices, colors);
+		}
+	}
+}
+
+void SoftRenderer::drawLines(float const* ends, float const* colors, unsigned lineNum, unsigned thickness) {
+	TRACE_SCOPE("draw soft lines");
+	transform(ends, 2 * lineNum);
+	binLines(lineNum, thickness);
+	#pragma omp parallel
+	{
+		TRACE_SCOPE("fill tiles");
+		#pragma omp for schedule(dynamic)
+		for (int t = 0; t < (int) tileItems.size(); ++t) fillLines(t, colors, thickness, false, NULL);
+	}
+}
+
+bool SoftRenderer::writePPM(std::string const& file) const {
+	TRACE_SCOPE("write ppm");
+	std::ofstream out(file.c_str(), std::ios::binary);
+	out << "P6\n" << width << " " << height << "\n255\n";
+	out.write((char const*) &color[0], color.size());
+	return (bool) out;
+}
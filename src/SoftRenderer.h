@@ -0,0 +1,80 @@
+/*
+ * SoftRenderer.h
+ * Draws the mesh and the skeleton into an image in memory, without GL or a
+ * window, e.g. to render the frames of a clip on a machine without a
+ * display. It works like the viewer's GL setup: a perspective camera, a
+ * depth buffer, the point light of the Mesh (with the same ambient), and
+ * wire frame, flat or smooth shaded triangles.
+ *
+ * The image is cut into tiles. The triangles (and lines) are first sorted
+ * into the tiles they touch, then the tiles are filled at the same time,
+ * each by one thread, so no two threads ever write the same pixel.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef SOFTRENDERER_H_
+#define SOFTRENDERER_H_
+
+#include <vector>
+#include <string>
+#include <Eigen/Dense>
+
+class SoftRenderer {
+public:
+	enum Mode {WIREFRAME, FLAT, SMOOTH};
+	static const unsigned TILE = 32; // pixels
+
+private:
+	unsigned width, height;
+	unsigned tilesX, tilesY;
+	std::vector<unsigned char> color; // rgb, row 0 is the top
+	std::vector<float> depth; // 0 (near) to 1 (far)
+
+	Mode mode;
+	Eigen::Matrix<float, 4, 4, Eigen::DontAlign> viewProjection; // (may be on the heap, unaligned)
+	float light[3];
+
+	// per drawing call, kept so it doesn't allocate: the vertices in pixels
+	// (x, y, depth) and how lit they are, and what is in each tile
+	std::vector<float> screen;
+	std::vector<float> lit;
+	std::vector<unsigned char> visible; // in front of the camera
+	std::vector< std::vector<unsigned> > tileItems;
+
+	void transform(float const* positions, unsigned vertexNum);
+	void binTriangles(unsigned const* indices, unsigned triangleNum);
+	void binLines(unsigned lineNum, unsigned thickness);
+	void fillTriangles(unsigned tile, unsigned const* indices, float const* colors);
+	void fillLines(unsigned tile, float const* colors, unsigned thickness, bool ofTriangles,
+			unsigned const* indices);
+
+public:
+	SoftRenderer(unsigned width, unsigned height);
+	virtual ~SoftRenderer() {}
+
+	unsigned getWidth() const { return width; }
+	unsigned getHeight() const { return height; }
+
+	// like gluLookAt and gluPerspective (fovY in degrees)
+	void setCamera(float const* eye, float const* centre, float const* up, float fovY, float near, float far);
+	void setLight(float const* position) { for (unsigned i = 0; i < 3; ++i) light[i] = position[i]; }
+	void setMode(Mode m) { mode = m; }
+
+	void clear(float r = 0, float g = 0, float b = 0);
+
+	/* Draws triangles (3 indices each) of vertices with positions and normals
+	 * (3 floats per vertex) and colors (4 per vertex, alpha is ignored; NULL
+	 * for white), in the current mode.
+	 */
+	void drawMesh(float const* positions, float const* normals, float const* colors,
+			unsigned vertexNum, unsigned const* indices, unsigned triangleNum);
+	// lineNum lines, ends has the 2 ends of each (6 floats), colors rgb per line
+	void drawLines(float const* ends, float const* colors, unsigned lineNum, unsigned thickness = 1);
+
+	// as binary PPM, false if it can't be written
+	bool writePPM(std::string const& file) const;
+};
+
+#endif /* SOFTRENDERER_H_ */
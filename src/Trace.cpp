@@ -0,0 +1,112 @@
+/*
+ * Trace.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "Trace.h"
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace trace {
+
+bool enabled = false;
+#ifdef ALLOC_PROFILE
+__thread char const* current = NULL;
+#endif
+
+namespace {
+	struct Event {
+		char const* name;
+		uint64_t begin, end;
+	};
+
+	// the events of one thread, only that thread writes into it
+	struct Buffer {
+		unsigned tid; // in the order the threads started recording, the one calling start is 0
+		std::vector<Event> events;
+		uint64_t count; // recorded so far, events[count % size] is the next one
+
+		Buffer(unsigned tid_, unsigned size) : tid(tid_), events(size), count(0) {}
+	};
+
+	std::vector<Buffer*> buffers; // all of them, they live as long as the program (so do the threads)
+	unsigned bufferSize = 0;
+	uint64_t origin = 0; // when start was called
+	__thread Buffer* local = NULL;
+
+	Buffer* localBuffer() {
+		if (!local) {
+			#pragma omp critical (traceBuffers)
+			{
+				local = new Buffer(buffers.size(), bufferSize);
+				buffers.push_back(local);
+			}
+		}
+		return local;
+	}
+}
+
+bool start(unsigned eventsPerThread) {
+	// the other threads may be recording into their buffers
+	if (enabled) return false;
+	#pragma omp critical (traceBuffers)
+	{
+		// threads that recorded before still have their buffer, only emptied
+		for (unsigned i = 0; i < buffers.size(); ++i) {
+			buffers[i]->events.assign(eventsPerThread, Event());
+			buffers[i]->count = 0;
+		}
+		bufferSize = eventsPerThread;
+	}
+	if (bufferSize == 0) return true;
+	localBuffer();
+	origin = now();
+	enabled = true;
+	return true;
+}
+
+void record(char const* name, uint64_t begin, uint64_t end) {
+	Buffer* b = localBuffer();
+	Event& e = b->events[b->count++ % b->events.size()];
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+}
+
+bool write(std::string const& file) {
+	FILE* out = fopen(file.c_str(), "w");
+	if (!out) return false;
+	fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	uint64_t lost = 0;
+	bool first = true;
+	#pragma omp critical (traceBuffers)
+	for (unsigned i = 0; i < buffers.size(); ++i) {
+		Buffer const& b = *buffers[i];
+		char threadName[32] = "main";
+		if (b.tid) snprintf(threadName, sizeof(threadName), "worker %u", b.tid);
+		fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+				first ? "" : ",\n", b.tid, threadName);
+		first = false;
+		const uint64_t size = b.events.size();
+		const uint64_t from = (b.count > size) ? b.count - size : 0;
+		lost += from;
+		for (uint64_t k = from; k < b.count; ++k) {
+			Event const& e = b.events[k % size];
+			if (e.begin < origin) continue; // a scope that was open when start was called
+			// in us, as the format wants them
+			fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+					e.name, b.tid, (e.begin - origin) / 1000.0, (e.end - e.begin) / 1000.0);
+		}
+	}
+	fprintf(out, "\n]}\n");
+	const bool ok = !ferror(out);
+	if (fclose(out) != 0) return false;
+	if (lost > 0) std::cerr << "trace: " << lost << " of the oldest events were overwritten" << std::endl;
+	return ok;
+}
+
+}
@@ -0,0 +1,84 @@
+/*
+ * Trace.h
+ * Where the time goes: TRACE_SCOPE("name") records when the enclosing block
+ * was entered and left, into a ring buffer of the thread it runs on (when it
+ * is full the oldest events are overwritten). Nothing is recorded until
+ * trace::start, then trace::write writes the events as a Chrome trace-event
+ * file (chrome://tracing or ui.perfetto.dev open it).
+ * With NO_TRACE defined the scopes are not compiled in at all. With
+ * ALLOC_PROFILE they also tell the allocation profiler (AllocProfile.h)
+ * what stage each thread is in, traced or not.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+namespace trace {
+	extern bool enabled;
+
+	// ns from a monotonic clock
+	inline uint64_t now() {
+		timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		return (uint64_t) t.tv_sec * 1000000000u + t.tv_nsec;
+	}
+
+	/* eventsPerThread is the size of the ring buffer of each thread. It empties
+	 * the buffers of all the threads, so no other thread may be in a traced
+	 * scope (call it outside of the parallel loops); false if tracing is
+	 * already on, stop first.
+	 */
+	bool start(unsigned eventsPerThread = 1 << 16);
+	inline void stop() { enabled = false; }
+	// false if the file can't be written
+	bool write(std::string const& file);
+
+	// name has to stay around (a literal), it isn't copied
+	void record(char const* name, uint64_t begin, uint64_t end);
+
+#ifdef ALLOC_PROFILE
+	// the innermost scope of this thread, NULL outside of all
+	extern __thread char const* current;
+#endif
+
+	class Scope {
+	private:
+		char const* name;
+		uint64_t begin; // 0: not recording
+#ifdef ALLOC_PROFILE
+		char const* outer;
+#endif
+
+		Scope(Scope const&);
+		Scope& operator=(Scope const&);
+
+	public:
+#ifdef ALLOC_PROFILE
+		explicit Scope(char const* name_) : name(name_), begin(enabled ? now() : 0), outer(current) { current = name; }
+		~Scope() {
+			current = outer;
+			if (begin) record(name, begin, now());
+		}
+#else
+		explicit Scope(char const* name_) : name(name_), begin(enabled ? now() : 0) {}
+		~Scope() { if (begin) record(name, begin, now()); }
+#endif
+	};
+}
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#ifdef NO_TRACE
+#  define TRACE_SCOPE(name)
+#else
+#  define TRACE_SCOPE(name) trace::Scope TRACE_JOIN(traceScope, __LINE__)(name)
+#endif
+
+#endif /* TRACE_H_ */
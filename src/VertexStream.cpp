@@ -0,0 +1,55 @@
+/*
+ * VertexStream.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "VertexStream.h"
+
+static const unsigned NONE = ~0u;
+
+static void putPoint(Point const& p, float* out) {
+	out[0] = p.x();
+	out[1] = p.y();
+	out[2] = p.z();
+}
+
+void VertexStream::build(std::vector<Point> const& meshPositions, std::vector<Point> const& meshNormals,
+		unsigned const* faceVertices, unsigned const* faceNormals, unsigned triangleNum) {
+	positionOf.clear();
+	normalOf.clear();
+	indices.resize(3 * triangleNum);
+
+	// the render vertices of each skinning vertex are chained together; there
+	// are hardly ever more than a few (usually the .obj has one normal per vertex)
+	std::vector<unsigned> firstOf(meshPositions.size(), NONE);
+	std::vector<unsigned> nextOf;
+	positionOf.reserve(meshPositions.size());
+	normalOf.reserve(meshPositions.size());
+	nextOf.reserve(meshPositions.size());
+
+	for (unsigned c = 0; c < 3 * triangleNum; ++c) {
+		const unsigned v = faceVertices[c];
+		const unsigned n = faceNormals[c];
+		unsigned r = firstOf[v];
+		while (r != NONE && normalOf[r] != n) r = nextOf[r];
+		if (r == NONE) {
+			r = positionOf.size();
+			positionOf.push_back(v);
+			normalOf.push_back(n);
+			nextOf.push_back(firstOf[v]);
+			firstOf[v] = r;
+		}
+		indices[c] = r;
+	}
+
+	positions.resize(3 * getVertexNum());
+	normals.resize(3 * getVertexNum());
+	gatherPositions(meshPositions, positions.empty() ? NULL : &positions[0]);
+	for (unsigned r = 0; r < getVertexNum(); ++r) putPoint(meshNormals[normalOf[r]], &normals[3*r]);
+}
+
+void VertexStream::gatherPositions(std::vector<Point> const& points, float* out) const {
+	for (unsigned r = 0; r < getVertexNum(); ++r) putPoint(points[positionOf[r]], out + 3*r);
+}
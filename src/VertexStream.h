@@ -0,0 +1,47 @@
+/*
+ * VertexStream.h
+ * The mesh the way the graphics card wants it: one list of render vertices,
+ * each a unique (position, normal) pair of the faces, and the triangles as
+ * indices into that list. The positions and the normals are in separate
+ * packed arrays (x y z after each other), so they can be handed to
+ * glVertexPointer/glNormalPointer or uploaded into buffers as they are, and
+ * a frame only has to replace the positions.
+ *
+ * Skinning still works on the positions of the .obj (the skinning vertices);
+ * positionOf maps every render vertex back to its skinning vertex, so the
+ * render positions of a frame are just a gather.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef VERTEXSTREAM_H_
+#define VERTEXSTREAM_H_
+
+#include <vector>
+
+#include "geometry.h"
+
+struct VertexStream {
+	std::vector<unsigned> positionOf; // render vertex -> skinning vertex
+	std::vector<unsigned> normalOf; // render vertex -> normal of the .obj
+	std::vector<unsigned> indices; // 3 render vertices per triangle
+	std::vector<float> positions; // 3 per render vertex, of the original pose
+	std::vector<float> normals; // 3 per render vertex
+
+	unsigned getVertexNum() const { return positionOf.size(); }
+	unsigned getTriangleNum() const { return indices.size() / 3; }
+
+	/* Makes the stream from the triangles of the mesh (3 vertex//normal index
+	 * pairs each). Render vertices are numbered in the order their corners
+	 * first come up.
+	 */
+	void build(std::vector<Point> const& meshPositions, std::vector<Point> const& meshNormals,
+			unsigned const* faceVertices, unsigned const* faceNormals, unsigned triangleNum);
+
+	// the positions of all render vertices for the skinning vertices in points
+	// (a frame of the mesh), 3 floats each
+	void gatherPositions(std::vector<Point> const& points, float* out) const;
+};
+
+#endif /* VERTEXSTREAM_H_ */
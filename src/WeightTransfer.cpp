@@ -0,0 +1,214 @@
+/*
+ * WeightTransfer.cpp
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#include "WeightTransfer.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// about how many cells there are per triangle
+static const float CELLS_PER_TRIANGLE = 1.0f;
+
+SurfaceIndex::SurfaceIndex(TriangleRecord const* triangles_, unsigned triangleNum_) :
+		triangles(triangles_), triangleNum(triangleNum_), cellSize(1) {
+	float hi[3];
+	for (unsigned a = 0; a < 3; ++a) {
+		lo[a] = std::numeric_limits<float>::max();
+		hi[a] = -std::numeric_limits<float>::max();
+		cells[a] = 1;
+	}
+	for (unsigned t = 0; t < triangleNum; ++t) {
+		for (unsigned k = 0; k < 3; ++k) {
+			for (unsigned a = 0; a < 3; ++a) {
+				lo[a] = std::min(lo[a], triangles[t].v[k][a]);
+				hi[a] = std::max(hi[a], triangles[t].v[k][a]);
+			}
+		}
+	}
+	if (triangleNum == 0) {
+		cellStarts.assign(2, 0);
+		return;
+	}
+
+	// cubic cells, as many as triangles (a surface only goes through some of them,
+	// so this is still more than one triangle per used cell)
+	const float size[3] = {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]};
+	const float longest = std::max(size[0], std::max(size[1], size[2]));
+	if (longest <= 0) {
+		cellSize = 1;
+	} else {
+		cellSize = std::max(longest / 1024, (float) std::pow(
+				std::max(size[0], longest / 1024) * std::max(size[1], longest / 1024) *
+				std::max(size[2], longest / 1024) / (CELLS_PER_TRIANGLE * triangleNum), 1.0 / 3));
+	}
+	for (unsigned a = 0; a < 3; ++a) cells[a] = std::max(1, (int) std::ceil(size[a] / cellSize));
+
+	// count, then fill
+	const unsigned cellNum = cells[0] * cells[1] * cells[2];
+	cellStarts.assign(cellNum + 1, 0);
+	for (int pass = 0; pass < 2; ++pass) {
+		std::vector<unsigned> fill;
+		if (pass == 1) {
+			for (unsigned c = 0; c < cellNum; ++c) cellStarts[c+1] += cellStarts[c];
+			cellTriangles.resize(cellStarts[cellNum]);
+			fill.assign(cellStarts.begin(), cellStarts.end() - 1);
+		}
+		for (unsigned t = 0; t < triangleNum; ++t) {
+			int from[3], to[3];
+			for (unsigned a = 0; a < 3; ++a) {
+				const float* v0 = triangles[t].v[0];
+				const float* v1 = triangles[t].v[1];
+				const float* v2 = triangles[t].v[2];
+				from[a] = cellOf(std::min(v0[a], std::min(v1[a], v2[a])), a);
+				to[a] = cellOf(std::max(v0[a], std::max(v1[a], v2[a])), a);
+			}
+			for (int z = from[2]; z <= to[2]; ++z) {
+				for (int y = from[1]; y <= to[1]; ++y) {
+					for (int x = from[0]; x <= to[0]; ++x) {
+						const unsigned c = (z * cells[1] + y) * cells[0] + x;
+						if (pass == 0) cellStarts[c+1]++;
+						else cellTriangles[fill[c]++] = t;
+					}
+				}
+			}
+		}
+	}
+}
+
+int SurfaceIndex::cellOf(float c, unsigned axis) const {
+	return std::max(0, std::min(cells[axis] - 1, (int) ((c - lo[axis]) / cellSize)));
+}
+
+// the closest point of the triangle abc to p, as barycentric coordinates
+// (Ericson: Real-Time Collision Detection, 5.1.5). Returns the squared distance
+static double closestOnTriangle(double const* p, float const (*v)[3], float bary[3]) {
+	double a[3], ab[3], ac[3], ap[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		a[i] = v[0][i];
+		ab[i] = v[1][i] - a[i];
+		ac[i] = v[2][i] - a[i];
+		ap[i] = p[i] - a[i];
+	}
+	#define DOT(x, y) (x[0]*y[0] + x[1]*y[1] + x[2]*y[2])
+	double u, w; // weights of b and c
+	const double d1 = DOT(ab, ap), d2 = DOT(ac, ap);
+	const double abab = DOT(ab, ab), abac = DOT(ab, ac), acac = DOT(ac, ac);
+	// p relative to b and c
+	const double d3 = d1 - abab, d4 = d2 - abac; // ab.bp, ac.bp
+	const double d5 = d1 - abac, d6 = d2 - acac; // ab.cp, ac.cp
+	#undef DOT
+	const double va = d3*d6 - d5*d4, vb = d5*d2 - d1*d6, vc = d1*d4 - d3*d2;
+	if (d1 <= 0 && d2 <= 0) { // a
+		u = 0; w = 0;
+	} else if (d3 >= 0 && d4 <= d3) { // b
+		u = 1; w = 0;
+	} else if (vc <= 0 && d1 >= 0 && d3 <= 0) { // ab
+		u = d1 / (d1 - d3); w = 0;
+	} else if (d6 >= 0 && d5 <= d6) { // c
+		u = 0; w = 1;
+	} else if (vb <= 0 && d2 >= 0 && d6 <= 0) { // ac
+		u = 0; w = d2 / (d2 - d6);
+	} else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) { // bc
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6)); u = 1 - w;
+	} else { // inside
+		const double denom = 1 / (va + vb + vc);
+		u = vb * denom; w = vc * denom;
+	}
+	bary[0] = 1 - u - w;
+	bary[1] = u;
+	bary[2] = w;
+	double dist = 0;
+	for (unsigned i = 0; i < 3; ++i) {
+		const double d = a[i] + u*ab[i] + w*ac[i] - p[i];
+		dist += d*d;
+	}
+	return dist;
+}
+
+bool SurfaceIndex::closest(Point const& p, unsigned& triangle, float bary[3]) const {
+	if (triangleNum == 0) return false;
+	const double pd[3] = {p.x(), p.y(), p.z()};
+	const int at[3] = {cellOf(p.x(), 0), cellOf(p.y(), 1), cellOf(p.z(), 2)};
+	// how far p is outside the grid (the cells around it are at least that far)
+	double outside = 0;
+	for (unsigned a = 0; a < 3; ++a) {
+		const double below = lo[a] - pd[a], above = pd[a] - (lo[a] + cells[a] * cellSize);
+		const double d = std::max(0.0, std::max(below, above));
+		outside += d*d;
+	}
+
+	double best = std::numeric_limits<double>::max();
+	float b[3];
+	const int maxRing = std::max(cells[0], std::max(cells[1], cells[2]));
+	// look at the shells of cells around p, until nothing closer can be further out
+	for (int r = 0; r <= maxRing; ++r) {
+		for (int z = at[2] - r; z <= at[2] + r; ++z) {
+			if (z < 0 || z >= cells[2]) continue;
+			for (int y = at[1] - r; y <= at[1] + r; ++y) {
+				if (y < 0 || y >= cells[1]) continue;
+				const bool inside = (std::abs(z - at[2]) < r && std::abs(y - at[1]) < r);
+				for (int x = at[0] - r; x <= at[0] + r; x += (inside ? 2*r : 1)) {
+					if (x >= 0 && x < cells[0]) {
+						const unsigned c = (z * cells[1] + y) * cells[0] + x;
+						for (unsigned i = cellStarts[c]; i < cellStarts[c+1]; ++i) {
+							const unsigned t = cellTriangles[i];
+							const double d = closestOnTriangle(pd, triangles[t].v, b);
+							if (d < best) {
+								best = d;
+								triangle = t;
+								std::copy(b, b + 3, bary);
+							}
+						}
+					}
+					if (r == 0) break;
+				}
+			}
+		}
+		const double reach = r * cellSize;
+		if (best <= reach * reach + outside) break;
+	}
+	return true;
+}
+
+void weightTransfer::transfer(TriangleRecord const* sourceTriangles, unsigned const* sourceFaceVertices,
+		unsigned sourceTriangleNum, Eigen::MatrixXd const& sourceWeights,
+		std::vector<Point> const& targetPoints, Eigen::MatrixXd& targetWeights) {
+	SurfaceIndex index(sourceTriangles, sourceTriangleNum);
+	targetWeights.setZero(targetPoints.size(), sourceWeights.cols());
+
+	#pragma omp parallel for schedule(dynamic, 256)
+	for (int v = 0; v < (int) targetPoints.size(); ++v) {
+		unsigned t;
+		float bary[3];
+		if (!index.closest(targetPoints[v], t, bary)) continue;
+		for (unsigned k = 0; k < 3; ++k) {
+			targetWeights.row(v) += bary[k] * sourceWeights.row(sourceFaceVertices[3*t + k]);
+		}
+	}
+}
+
+void weightTransfer::smooth(Eigen::MappedSparseMatrix<double> const& laplacian, Eigen::MatrixXd& weights,
+		unsigned iterations, double step) {
+	// the diagonal of the Laplacian is the number of neighbours
+	Eigen::VectorXd inverseDegree = Eigen::VectorXd::Zero(laplacian.rows());
+	for (int i = 0; i < laplacian.outerSize(); ++i) {
+		for (Eigen::MappedSparseMatrix<double>::InnerIterator it(laplacian, i); it; ++it) {
+			if (it.index() == i && it.value() > 0) inverseDegree(i) = 1 / it.value();
+		}
+	}
+	for (unsigned k = 0; k < iterations; ++k) {
+		Eigen::MatrixXd change = laplacian * weights;
+		weights -= step * (inverseDegree.asDiagonal() * change);
+	}
+
+	for (int v = 0; v < weights.rows(); ++v) {
+		for (int b = 0; b < weights.cols(); ++b) weights(v, b) = std::max(0.0, weights(v, b));
+		const double sum = weights.row(v).sum();
+		if (sum > 0) weights.row(v) /= sum;
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * WeightTransfer.h
+ * Carries the skinning weights of a mesh that has them over to another mesh
+ * of the same character (a finer or coarser version of it), instead of
+ * attaching and solving for the weights again. Each vertex of the new mesh
+ * takes the weights of the closest point on the old surface, interpolated
+ * from the corners of that triangle. The closest points are found with a
+ * uniform grid over the old triangles.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef WEIGHTTRANSFER_H_
+#define WEIGHTTRANSFER_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "geometry.h"
+
+/* Closest point queries on a triangle soup. Keeps pointers to the triangles,
+ * they have to stay around.
+ */
+class SurfaceIndex {
+private:
+	TriangleRecord const* triangles;
+	unsigned triangleNum;
+	float lo[3]; // the corner of the grid
+	float cellSize;
+	int cells[3];
+	// the triangles whose box touches each cell, in CSR form
+	std::vector<unsigned> cellStarts;
+	std::vector<unsigned> cellTriangles;
+
+	int cellOf(float c, unsigned axis) const;
+
+public:
+	SurfaceIndex(TriangleRecord const* triangles, unsigned triangleNum);
+	virtual ~SurfaceIndex() {}
+
+	/* The triangle closest to p, and the barycentric coordinates of the
+	 * closest point on it. Returns false if there are no triangles.
+	 */
+	bool closest(Point const& p, unsigned& triangle, float bary[3]) const;
+};
+
+namespace weightTransfer {
+
+	/* Row v of targetWeights will be the weights (a row of sourceWeights per
+	 * source vertex) at the point of the source surface closest to target
+	 * vertex v.
+	 */
+	void transfer(TriangleRecord const* sourceTriangles, unsigned const* sourceFaceVertices,
+			unsigned sourceTriangleNum, Eigen::MatrixXd const& sourceWeights,
+			std::vector<Point> const& targetPoints, Eigen::MatrixXd& targetWeights);
+
+	/* A few steps of w -= step * D^-1 L w with the Laplacian of the mesh (L = D - A),
+	 * then every row is made to add up to 1 again.
+	 */
+	void smooth(Eigen::MappedSparseMatrix<double> const& laplacian, Eigen::MatrixXd& weights,
+			unsigned iterations, double step = 0.5);
+
+}
+
+#endif /* WEIGHTTRANSFER_H_ */
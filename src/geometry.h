@@ -138,6 +138,9 @@ private:
 public:
 	Triangle(Point const& e1, Point const& e2, Point const& e3) :
 		v1(e1), v2(e2), v3(e3), bounding(v1, std::sqrt((v1-v2).getLengthSqr()+(v2-v3).getLengthSqr())) {};
+	// when the radius of the bounding sphere (around e1) is known already
+	Triangle(Point const& e1, Point const& e2, Point const& e3, float boundRadius) :
+		v1(e1), v2(e2), v3(e3), bounding(v1, boundRadius) {};
 	virtual ~Triangle() {};
 	friend bool intersectLineSegWithTriangle(LineSegment const & l, Triangle const & t);
 	friend std::ostream& operator<< (std::ostream &out, Triangle const& t);
@@ -158,6 +161,25 @@ inline std::ostream& operator<< (std::ostream &out, Triangle const& t) {
 	return out;
 }
 
+// a Triangle as plain numbers, so it can be kept in a file and used from there
+struct TriangleRecord {
+	float v[3][3];
+	float boundRadius;
+
+	TriangleRecord() {}
+	TriangleRecord(Point const& e1, Point const& e2, Point const& e3) {
+		Point const* e[3] = {&e1, &e2, &e3};
+		for (unsigned i = 0; i < 3; ++i) {
+			v[i][0] = e[i]->x();
+			v[i][1] = e[i]->y();
+			v[i][2] = e[i]->z();
+		}
+		boundRadius = std::sqrt((e1-e2).getLengthSqr()+(e2-e3).getLengthSqr()); // as in Triangle
+	}
+	Point getPoint(unsigned i) const { return Point(v[i][0], v[i][1], v[i][2]); }
+	Triangle toTriangle() const { return Triangle(getPoint(0), getPoint(1), getPoint(2), boundRadius); }
+};
+
 
 namespace interSectMatr {
 	static Eigen::Matrix3f A;
@@ -12,6 +12,12 @@
 #endif
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
 #include <boost/shared_ptr.hpp>
 
 #include "Animation.h"
@@ -19,18 +25,85 @@
 #include "Camera.h"
 #include "tools.h"
 #include "Mesh.h"
+#include "MeshBuffers.h"
+#include "FrameScheduler.h"
+#include "Crowd.h"
+#include "SoftRenderer.h"
+#include "Trace.h"
+#include "MemoryUse.h"
+#include "AllocProfile.h"
 
 #include "Quaternion.h"
 
 using namespace std;
 
-unsigned SkeletonNode::nodeCounter=0;
+static const unsigned SCR_WIDTH = 800, SCR_HEIGHT = 600;
+
 static boost::shared_ptr<Animation> anim;
 static Camera cam;
 static boost::shared_ptr<Mesh> model;
+static FrameScheduler scheduler;
+static boost::shared_ptr<Crowd> crowd; // only in crowd mode
+
+// rendering a clip into image files, without a window (--render)
+struct RenderJob {
+	bool on;
+	double from, to, fps; // seconds of the clip, frames per second
+	std::string prefix; // the frames are <prefix>0000.ppm, ...
+	unsigned width, height;
+	SoftRenderer::Mode mode;
+	bool skeleton;
+	float box[6]; // what the camera has to see (xMin, xMax, yMin, ...)
+
+	RenderJob() : on(false), from(0), to(0), fps(30), width(SCR_WIDTH), height(SCR_HEIGHT),
+			mode(SoftRenderer::SMOOTH), skeleton(false) {}
+};
+static RenderJob renderJob;
+
+// what 'w' writes, and what the batch mode can write
+enum Output {
+	OUT_WEIGHTS = 1, // W.out
+	OUT_FRAMES = 2, // meshMotion.out (written while baking)
+	OUT_BVH = 4, // motionout.bvh
+	OUT_MATRICES = 8, // meshout.obj, S.out, C.out, h.out, A.out, L.out
+	OUT_ALL = 15
+};
+
+// running the pipeline without a window and exiting (--batch)
+struct BatchJob {
+	bool on;
+	unsigned outputs; // Output flags
+	double loading, attaching, baking, writing; // seconds
+
+	BatchJob() : on(false), outputs(0), loading(0), attaching(0), baking(0), writing(0) {}
+};
+static BatchJob batchJob;
+
+static std::string traceFile; // --trace
+
+static MemoryUse memoryUse;
+
+// at exit, with --alloc-profile
+void printAllocations() {
+	allocProfile::print(cout);
+}
 
+// what the structures hold now (and held at most), after each stage and with 'm'; batch is the one of a render
+void reportMemory(std::string const& when, Crowd const* batch = NULL) {
+	memoryUse.begin();
+	if (model) model->reportMemory(memoryUse);
+	if (anim) anim->reportMemory(memoryUse);
+	if (crowd) crowd->reportMemory(memoryUse);
+	if (batch) batch->reportMemory(memoryUse);
+	memoryUse.print(cout, when);
+}
+
+// at exit, however the program ends
+void writeTrace() {
+	if (trace::write(traceFile)) cout << "Wrote the trace into " << traceFile << endl;
+	else cerr << "ERROR: could not write the trace into " << traceFile << endl;
+}
 
-static const unsigned SCR_WIDTH = 800, SCR_HEIGHT = 600;
 
 
 void drawText(float x, float y, float z, char const *string) {
@@ -42,31 +115,176 @@ void drawText(float x, float y, float z, char const *string) {
 
 void loadThings(int argc, char **argv) throw (int) {
 
-	if (argc != 3) {
-		cerr << "ERROR: this program takes exactly 2 argument: first a wavefront .obj file, then a .bvh file to load." << endl;
+	if (argc < 3) {
+		cerr << "ERROR: this program takes at least 2 arguments: first a wavefront .obj file, then a .bvh file to load." << endl;
+		cerr << "Options after those: --stream to play the .bvh from the disk, --fps <n> to resample the .bvh to n fps," << endl;
+		cerr << "--reorder to put the mesh in a cache friendly order, --lods <n> to make n coarser versions of the mesh," << endl;
+		cerr << "--weights-from <mesh.obj> <W.out> to take the skinning weights from another version of the mesh," << endl;
+		cerr << "--no-vbo to draw the mesh without buffer objects, --refresh <hz> to draw at most that often while playing (0: no limit)," << endl;
+		cerr << "--crowd <n> to play the clip on n copies of the mesh at once (--crowd-clip <file.bvh> for another clip" << endl;
+		cerr << "of the same skeleton that some of them play, can be given more than once)," << endl;
+		cerr << "--render <from> <to> <fps> <prefix> to render seconds from to to of the clip into <prefix>0000.ppm, ... without a window" << endl;
+		cerr << "(with --render-size <w> <h>, --render-mode wire|flat|smooth and --render-skeleton)," << endl;
+		cerr << "--batch <outputs> to attach and bake without a window, write the outputs and exit;" << endl;
+		cerr << "outputs is a comma separated list of weights, frames, bvh, matrices or all," << endl;
+		cerr << "--trace <file.json> to write where the time went as a Chrome trace (chrome://tracing) at exit," << endl;
+		cerr << "--alloc-profile to print the heap allocations of each stage at exit (built with ALLOC_PROFILE)" << endl;
+		throw 1;
+	}
+	bool streaming = false;
+	bool reorder = false;
+	unsigned lodLevels = 0;
+	char* weightsMesh = NULL;
+	char* weightsFile = NULL;
+	double targetFPS = 0;
+	unsigned crowdSize = 0;
+	float crowdSpacing = 0;
+	std::vector<char*> crowdClips;
+	for (int i = 3; i < argc; ++i) {
+		std::string opt(argv[i]);
+		if (opt.compare("--stream") == 0) {
+			streaming = true;
+		} else if (opt.compare("--no-vbo") == 0) {
+			MeshBuffers::disable();
+		} else if (opt.compare("--reorder") == 0) {
+			reorder = true;
+		} else if (opt.compare("--lods") == 0 && i+1 < argc) {
+			lodLevels = atoi(argv[++i]);
+		} else if (opt.compare("--weights-from") == 0 && i+2 < argc) {
+			weightsMesh = argv[++i];
+			weightsFile = argv[++i];
+		} else if (opt.compare("--render") == 0 && i+4 < argc) {
+			renderJob.on = true;
+			renderJob.from = atof(argv[++i]);
+			renderJob.to = atof(argv[++i]);
+			renderJob.fps = atof(argv[++i]);
+			renderJob.prefix = argv[++i];
+		} else if (opt.compare("--render-size") == 0 && i+2 < argc) {
+			renderJob.width = atoi(argv[++i]);
+			renderJob.height = atoi(argv[++i]);
+		} else if (opt.compare("--render-mode") == 0 && i+1 < argc) {
+			std::string mode(argv[++i]);
+			if (mode.compare("wire") == 0) renderJob.mode = SoftRenderer::WIREFRAME;
+			else if (mode.compare("flat") == 0) renderJob.mode = SoftRenderer::FLAT;
+			else if (mode.compare("smooth") == 0) renderJob.mode = SoftRenderer::SMOOTH;
+			else {
+				cerr << "ERROR: unknown render mode " << mode << endl;
+				throw 1;
+			}
+		} else if (opt.compare("--render-skeleton") == 0) {
+			renderJob.skeleton = true;
+		} else if (opt.compare("--batch") == 0 && i+1 < argc) {
+			batchJob.on = true;
+			std::stringstream list(argv[++i]);
+			std::string out;
+			while (std::getline(list, out, ',')) {
+				if (out.compare("weights") == 0) batchJob.outputs |= OUT_WEIGHTS;
+				else if (out.compare("frames") == 0) batchJob.outputs |= OUT_FRAMES;
+				else if (out.compare("bvh") == 0) batchJob.outputs |= OUT_BVH;
+				else if (out.compare("matrices") == 0) batchJob.outputs |= OUT_MATRICES;
+				else if (out.compare("all") == 0) batchJob.outputs |= OUT_ALL;
+				else {
+					cerr << "ERROR: unknown output " << out << endl;
+					throw 1;
+				}
+			}
+		} else if (opt.compare("--trace") == 0 && i+1 < argc) {
+			traceFile = argv[++i];
+		} else if (opt.compare("--alloc-profile") == 0) {
+			if (!allocProfile::available()) {
+				cerr << "ERROR: --alloc-profile needs a build with ALLOC_PROFILE defined" << endl;
+				throw 1;
+			}
+			allocProfile::start();
+			atexit(printAllocations);
+		} else if (opt.compare("--crowd") == 0 && i+1 < argc) {
+			crowdSize = atoi(argv[++i]);
+		} else if (opt.compare("--crowd-clip") == 0 && i+1 < argc) {
+			crowdClips.push_back(argv[++i]);
+		} else if (opt.compare("--refresh") == 0 && i+1 < argc) {
+			scheduler.setRefreshRate(atof(argv[++i]));
+		} else if (opt.compare("--fps") == 0 && i+1 < argc) {
+			targetFPS = atof(argv[++i]);
+		} else {
+			cerr << "ERROR: unknown option " << opt << endl;
+			throw 1;
+		}
+	}
+	if (streaming && targetFPS > 0) {
+		cerr << "ERROR: a streamed animation can't be resampled" << endl;
+		throw 1;
+	}
+	if (streaming && (crowdSize > 0 || renderJob.on)) {
+		cerr << "ERROR: a crowd or a render can't play a streamed animation" << endl;
+		throw 1;
+	}
+	if (!crowdClips.empty() && crowdSize == 0) {
+		cerr << "ERROR: --crowd-clip is for the clips of a crowd, it needs --crowd" << endl;
 		throw 1;
 	}
+	if (batchJob.on && (crowdSize > 0 || renderJob.on)) {
+		cerr << "ERROR: --batch can't be used with --crowd or --render" << endl;
+		throw 1;
+	}
+	if (batchJob.on && streaming && (batchJob.outputs & OUT_FRAMES)) {
+		cerr << "ERROR: the frames of a streamed animation are not baked" << endl;
+		throw 1;
+	}
+	if (renderJob.on && (renderJob.fps <= 0 || renderJob.to < renderJob.from || renderJob.width == 0 || renderJob.height == 0)) {
+		cerr << "ERROR: nothing to render" << endl;
+		throw 1;
+	}
+
+	if (!traceFile.empty()) {
+		trace::start();
+		atexit(writeTrace);
+	}
 
 	cout << "Reading in file now." << endl;
+	double stageStart = FrameScheduler::now();
 	try {
 		model.reset(new Mesh());
-		model->loadModel(argv[1]);
+		model->loadModel(argv[1], reorder);
+		if (lodLevels > 0) model->buildLods(lodLevels);
 
-		anim.reset(new Animation(argv[2]));
+		anim.reset(new Animation(argv[2], streaming));
+		// no stale W.out picked up from where it runs, and no logs next to the outputs
+		if (batchJob.on || renderJob.on) anim->setTestFiles(false);
+		if (targetFPS > 0) anim->resample(targetFPS);
 		cout << "The name of the loaded file is " << anim->getFileName() << endl;
 
 		float xMin, xMax, yMin, yMax, zMin, zMax;
 		anim->closestFit(xMin, xMax, yMin, yMax, zMin, zMax);
+		if (crowdSize > 0) {
+			// the copies stand as far apart as the clip goes, in rows behind the first
+			crowdSpacing = std::max(xMax - xMin, zMax - zMin);
+			const unsigned perRow = (unsigned) ceil(sqrt((double) crowdSize));
+			const float halfWidth = (perRow - 1) * crowdSpacing * 0.5f;
+			xMin -= halfWidth;
+			xMax += halfWidth;
+			zMin -= ((crowdSize - 1) / perRow) * crowdSpacing;
+		}
 
 		float extra = 1; // TODO maybe based on figure size? (our upper bound is too big)
-		cam.makeVisible(xMin-extra, xMax+extra,
-				yMin-extra, yMax+extra, zMin-extra, zMax+extra);
+		if (batchJob.on) {
+			// no camera (or GL) needed
+		} else if (renderJob.on) {
+			// no GL here
+			const float box[6] = {xMin-extra, xMax+extra, yMin-extra, yMax+extra, zMin-extra, zMax+extra};
+			std::copy(box, box + 6, renderJob.box);
+		} else {
+			cam.makeVisible(xMin-extra, xMax+extra,
+					yMin-extra, yMax+extra, zMin-extra, zMax+extra);
+		}
 
 	} catch (ParseException& e) {
 		cerr << e.what() << endl;
 		throw 2;
 	}
 
+	batchJob.loading = FrameScheduler::now() - stageStart;
+	reportMemory("loading");
+
 	if (debug::ison(debug::DETAILED)) {
 		cout << endl << "-- The bones are:" << endl;
 		anim->printBoneStruct(cout);
@@ -79,7 +297,207 @@ void loadThings(int argc, char **argv) throw (int) {
 	cout << "EVERYTHING is " << debug::ison(debug::EVERYTHING) << endl << endl;
 
 	anim->printSelectedBone();
-	anim->setModel(model);
+	// a crowd (and a render) skins its own frames, the batch mode only bakes them if they are written
+	const bool bake = (crowdSize == 0 && !renderJob.on && !batchJob.on) || (batchJob.outputs & OUT_FRAMES);
+	stageStart = FrameScheduler::now();
+	if (weightsMesh) {
+		Mesh source;
+		Eigen::MatrixXd weights;
+		try {
+			source.loadModel(weightsMesh);
+		} catch (ParseException& e) {
+			cerr << e.what() << endl;
+			throw 2;
+		}
+		if (!anim->readAttachWeights(weightsFile, source, weights)) {
+			cerr << "ERROR: could not read the weights of " << weightsMesh << " from " << weightsFile << endl;
+			throw 2;
+		}
+		anim->setModelFrom(model, source, weights, 2, false);
+	} else {
+		// what setModel does, a stage at a time
+		anim->attachBones(model);
+		anim->solveAttachWeights();
+	}
+	batchJob.attaching = FrameScheduler::now() - stageStart;
+	reportMemory("attaching");
+	if (bake) {
+		stageStart = FrameScheduler::now();
+		if (!anim->precalculateMesh() && batchJob.on) {
+			cerr << "ERROR: could not write meshMotion.out" << endl;
+			throw 2;
+		}
+		batchJob.baking = FrameScheduler::now() - stageStart;
+		reportMemory("baking");
+	}
+
+	if (crowdSize > 0) {
+		crowd.reset(new Crowd(anim, model));
+		try {
+			for (unsigned c = 0; c < crowdClips.size(); ++c) {
+				boost::shared_ptr<Animation> clip(new Animation(crowdClips[c]));
+				if (targetFPS > 0) clip->resample(targetFPS);
+				crowd->addClip(clip);
+			}
+		} catch (ParseException& e) {
+			cerr << e.what() << endl;
+			throw 2;
+		} catch (WrongStateException& e) {
+			cerr << e.what() << endl;
+			throw 2;
+		}
+		crowd->addGrid(crowdSize, crowdSpacing);
+		cout << "Playing " << crowd->getClipNum() << " clip(s) on a crowd of " << crowdSize << endl;
+		reportMemory("making the crowd");
+	}
+}
+
+// closes out (file), false with a message if it could not be opened or written
+static bool finish(ofstream& out, char const* file) {
+	out.close();
+	if (out) return true;
+	cerr << "ERROR: could not write " << file << endl;
+	return false;
+}
+
+// writes the outputs in what (Output flags) into the current directory, false if any of them could not be
+bool writeOutputs(unsigned what) {
+	TRACE_SCOPE("write outputs");
+	bool ok = true;
+	if (what & OUT_BVH) {
+		ofstream outfile1("motionout.bvh");
+		anim->outputBVH(outfile1);
+		ok &= finish(outfile1, "motionout.bvh");
+	}
+
+	if (what & OUT_MATRICES) {
+		ofstream outfile2("meshout.obj");
+		model->printOrigMesh(outfile2);
+		ok &= finish(outfile2, "meshout.obj");
+
+		ofstream outfile3("S.out");
+		anim->printAttachedMatrix(outfile3, Animation::SIMPLE_M);
+		ok &= finish(outfile3, "S.out");
+
+		ofstream outfile4("C.out");
+		anim->printAttachedMatrix(outfile4, Animation::VISIBLE_M);
+		ok &= finish(outfile4, "C.out");
+
+		ofstream outfile5("h.out");
+		anim->printImportances(outfile5);
+		ok &= finish(outfile5, "h.out");
+
+		ofstream outfile6("A.out");
+		model->printAdjMatrix(outfile6);
+		ok &= finish(outfile6, "A.out");
+
+		ofstream outfile7("L.out");
+		model->printLaplacian(outfile7);
+		ok &= finish(outfile7, "L.out");
+	}
+
+	if (what & OUT_WEIGHTS) {
+		ofstream outfile8("W.out");
+		anim->printFinalAttachMatrix(outfile8);
+		ok &= finish(outfile8, "W.out");
+	}
+
+	if (ok) cout << "Finished writing output files." << endl;
+	return ok;
+}
+
+/* The rest of the batch mode, after loadThings did the loading, attaching
+ * and baking: writes the outputs and how long each part took. 0 if all
+ * of them were written.
+ */
+int runBatch() {
+	const double start = FrameScheduler::now();
+	try {
+		if (!writeOutputs(batchJob.outputs)) return 1;
+	} catch (WrongStateException& e) {
+		cerr << e.what() << endl;
+		return 2;
+	}
+	batchJob.writing = FrameScheduler::now() - start;
+
+	cout << "Batch done: loading " << batchJob.loading << "s, attaching " << batchJob.attaching
+			<< "s, baking " << batchJob.baking << "s, writing " << batchJob.writing << "s" << endl;
+	return 0;
+}
+
+/* Renders the frames of renderJob with the SoftRenderer, as the viewer would
+ * show them. The frames are skinned in batches, as a crowd of the character
+ * at the times of the frames. 0 if all of them were written, else 1
+ * (it stops at the first one that can't be).
+ */
+int renderClip() {
+	SoftRenderer renderer(renderJob.width, renderJob.height);
+	renderer.setMode(renderJob.mode);
+	float eye[3], centre[3];
+	float far = cam.getFar();
+	float const* b = renderJob.box;
+	Camera::findView(b[0], b[1], b[2], b[3], b[4], b[5], eye, centre, far);
+	const float up[3] = {0, 1, 0};
+	renderer.setCamera(eye, centre, up, cam.getFovY(), cam.getNear(), far);
+
+	VertexStream const& stream = model->getStream();
+	std::vector<float> positions(stream.positions.size());
+	std::vector<float> bones(6 * anim->getBoneLineNum());
+	std::vector<float> boneColors(bones.size());
+	for (unsigned i = 0; i < boneColors.size(); i += 3) {
+		boneColors[i] = boneColors[i+1] = 1.0;
+		boneColors[i+2] = 0.1; // yellow
+	}
+
+	const unsigned frames = (unsigned) floor((renderJob.to - renderJob.from) * renderJob.fps + 1e-6) + 1;
+	static const unsigned BATCH = 16;
+	Crowd batch(anim, model);
+	double skinning = 0, drawing = 0;
+	const double start = FrameScheduler::now();
+	for (unsigned first = 0; first < frames; first += BATCH) {
+		double t = FrameScheduler::now();
+		batch.clear();
+		for (unsigned f = first; f < std::min(frames, first + BATCH); ++f) {
+			batch.add(CrowdInstance(renderJob.from + f / renderJob.fps));
+		}
+		batch.skin();
+		skinning += FrameScheduler::now() - t;
+
+		for (unsigned i = 0; i < batch.getInstanceNum(); ++i) {
+			TRACE_SCOPE("render frame");
+			t = FrameScheduler::now();
+			renderer.clear();
+			if (!positions.empty()) stream.gatherPositions(batch.getSkinned(i), &positions[0]);
+			renderer.drawMesh(positions.empty() ? NULL : &positions[0], stream.normals.empty() ? NULL : &stream.normals[0],
+					NULL, stream.getVertexNum(), stream.indices.empty() ? NULL : &stream.indices[0], stream.getTriangleNum());
+			if (renderJob.skeleton && !bones.empty()) {
+				batch.boneLines(i, &bones[0]);
+				renderer.drawLines(&bones[0], &boneColors[0], anim->getBoneLineNum(), 3);
+			}
+			drawing += FrameScheduler::now() - t;
+
+			std::stringstream file;
+			file << renderJob.prefix;
+			file.width(4);
+			file.fill('0');
+			file << first + i << ".ppm";
+			if (!renderer.writePPM(file.str())) {
+				cerr << "ERROR: could not write " << file.str() << ", stopping" << endl;
+				return 1;
+			}
+		}
+	}
+	const double total = FrameScheduler::now() - start;
+	reportMemory("rendering", &batch);
+
+	int cores = 1;
+#ifdef _OPENMP
+	cores = omp_get_max_threads();
+#endif
+	cout << "Rendered " << frames << " frames of " << renderJob.width << "x" << renderJob.height << " in " << total << "s ("
+			<< 1000 * skinning / frames << " ms skinning, " << 1000 * drawing / frames << " ms drawing per frame)" << endl;
+	cout << frames / total << " frames/s on " << cores << " threads, " << frames / total / cores << " frames/s per core" << endl;
+	return 0;
 }
 
 void graphicsSetup() {
@@ -89,7 +507,8 @@ void graphicsSetup() {
 
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	gluPerspective(90, ((double)SCR_WIDTH)/((double)SCR_HEIGHT), cam.getNear(), cam.getFar());
+	gluPerspective(cam.getFovY(), ((double)SCR_WIDTH)/((double)SCR_HEIGHT), cam.getNear(), cam.getFar());
+	cam.setScreenHeight(SCR_HEIGHT);
 
 	// Light property vectors.
 //	float globAmb[] = { 0.2, 0.2, 0.2, 1.0 };
@@ -124,7 +543,8 @@ void resize(int w, int h)
 	glViewport(0, 0, (GLsizei)w, (GLsizei)h);
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
-	gluPerspective(90, ((float) w)/((float) h), cam.getNear(), cam.getFar());
+	gluPerspective(cam.getFovY(), ((float) w)/((float) h), cam.getNear(), cam.getFar());
+	cam.setScreenHeight(h);
 }
 
 
@@ -148,9 +568,18 @@ void drawAxes(float length) {
 	glColor3f(0.0, 0.0, 0.0);
 }
 
+// the timer drawScene set for the next frame while playing
+void nextFrame(int) {
+	scheduler.timerFired();
+	glutPostRedisplay();
+}
+
 // Drawing (display) routine.
 void drawScene(void)
 {
+	TRACE_SCOPE("frame");
+	scheduler.frameBegin();
+
 	// Clear screen to background color.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -165,6 +594,19 @@ void drawScene(void)
 //	glColor3f(0.0, 0.0, 0.0);
 	glColor3f(1.0, 1.0, 1.0);
 	drawText(-37, 27, -30, fpsStream.str().c_str());
+	// what the previous frame sent to the GL
+	std::stringstream glStream;
+	glStream << "draw calls: " << MeshBuffers::stats.drawCalls << ", uploads: " << MeshBuffers::stats.uploads
+			<< " (" << MeshBuffers::stats.uploadedBytes / 1024 << " KB)";
+	drawText(-37, 25.5, -30, glStream.str().c_str());
+	MeshBuffers::resetStats();
+	// the frames of the last second (while playing)
+	FrameScheduler::Stats const& frames = scheduler.getLastSecond();
+	std::stringstream frameStream;
+	frameStream.precision(3);
+	frameStream << "frames: " << frames.frames << "/s, " << (frames.frames ? 1000 * frames.work / frames.frames : 0)
+			<< " ms avg, " << 1000 * frames.maxWork << " ms max";
+	drawText(-37, 24, -30, frameStream.str().c_str());
 
 	cam.view();
 
@@ -172,11 +614,20 @@ void drawScene(void)
 
 	// Set stickman color.
 	glColor3f(1.0,1.0,0.1);
-	anim->display(true);
+	if (crowd) {
+		crowd->display(anim->isAnimating(), cam);
+	} else {
+		Point const& c = model->getBoundCentre();
+		model->setViewScale(cam.pixelsPerUnit(c.x(), c.y(), c.z()));
+		anim->display(true);
+	}
 
 	glDisable(GL_LIGHTING);
 
 	glutSwapBuffers();
+
+	const int wait = scheduler.frameEnd(anim->isAnimating());
+	if (wait >= 0) glutTimerFunc(wait, nextFrame, 0);
 }
 
 
@@ -195,9 +646,19 @@ void keyInput(unsigned char key, int x, int y) {
 	case 'z':
 		model->nextIntersection();
 		break;
+	case 'o':
+		model->nextLod();
+		break;
 	// -- testing over
 	case 'q':
+	{
+		FrameScheduler::Stats const& frames = scheduler.getTotal();
+		if (frames.frames > 0) {
+			cout << frames.frames << " frames drawn, " << 1000 * frames.work / frames.frames << " ms avg, "
+					<< 1000 * frames.maxWork << " ms max" << endl;
+		}
 		exit(0);
+	}
 		break;
 	case 'p':
 		anim->startAnim();
@@ -227,60 +688,22 @@ void keyInput(unsigned char key, int x, int y) {
 //		glEnable(GL_COLOR_MATERIAL);
 		break;
 	case 'w':
-	{
-		ofstream outfile1("motionout.bvh");
-		anim->outputBVH(outfile1);
-		outfile1.close();
-
-		ofstream outfile2("meshout.obj");
-		model->printOrigMesh(outfile2);
-		outfile2.close();
-
-		ofstream outfile3("S.out");
-		anim->printAttachedMatrix(outfile3, Animation::SIMPLE_M);
-		outfile3.close();
-
-		ofstream outfile4("C.out");
-		anim->printAttachedMatrix(outfile4, Animation::VISIBLE_M);
-		outfile4.close();
-
-		ofstream outfile5("h.out");
-		anim->printImportances(outfile5);
-		outfile5.close();
-
-		ofstream outfile6("A.out");
-		model->printAdjMatrix(outfile6);
-		outfile6.close();
-
-		ofstream outfile7("L.out");
-		model->printLaplacian(outfile7);
-		outfile7.close();
-
-		ofstream outfile8("W.out");
-		anim->printFinalAttachMatrix(outfile8);
-		outfile8.close();
-
-		cout << "Finished writing output files." << endl;
+		writeOutputs(OUT_ALL);
+		break;
+	case 'm':
+		reportMemory("this frame");
 		break;
-	}
 	default:
 		cam.control(key);
 		break;
 	}
+	// nothing is drawn unless asked for
+	glutPostRedisplay();
 }
 
 // Special keyboard input processing routine.
 void specialKeyInput(int key, int x, int y) {
 	cam.controlSpec(key);
-}
-
-//void animate(int arg) {
-//
-//	glutPostRedisplay();
-//	glutTimerFunc((unsigned) (anim->getStdFrameTime()*SECtoMSEC), animate, 0);
-//}
-
-void doWhenIdle() {
 	glutPostRedisplay();
 }
 
@@ -348,7 +771,9 @@ void printInstructions() {
 	cout << "------ OTHER CONTROLS ------" << endl;
 	cout << "    l to show wire frame  " << endl;
 	cout << "  L to show shaded figure  " << endl;
-	cout << "   w to print out infos  " << endl << endl;
+	cout << " o to change level of detail" << endl;
+	cout << "   w to print out infos  " << endl;
+	cout << "  m to print the memory use" << endl << endl;
 
 	cout << "Do not press 'z'!" << endl;
 	cout << "'q' to quit" << endl;
@@ -360,6 +785,20 @@ int main(int argc, char **argv) {
 	testCode();
 //	return 0;
 
+	// rendering into files and the batch mode don't need a window (or GL)
+	for (int i = 3; i < argc; ++i) {
+		const std::string opt(argv[i]);
+		if (opt.compare("--render") != 0 && opt.compare("--batch") != 0) continue;
+		try {
+			loadThings(argc, argv);
+		} catch (int e) {
+			cerr << "The program is going to terminate now." << endl;
+			return 1;
+		}
+		if (batchJob.on) return runBatch();
+		return renderClip();
+	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
 	glutInitWindowSize(SCR_WIDTH, SCR_HEIGHT);
@@ -381,8 +820,7 @@ int main(int argc, char **argv) {
 	glutReshapeFunc(resize);
 	glutKeyboardFunc(keyInput);
 	glutSpecialFunc(specialKeyInput);
-	glutIdleFunc(doWhenIdle); // we'll prob have to use this now
-//	glutTimerFunc((unsigned) anim->getStdFrameTime()*1000000, animate, 0);
+	// no idle function: frames are drawn after input, and on a timer while playing
 	glutMainLoop();
 
 
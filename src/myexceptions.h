@@ -16,15 +16,17 @@ class ParseException: public std::exception {
 private:
 	std::string expected;
 	std::string got;
+	std::string message; // what() points into it, so it lives as long as the exception
 public:
 	ParseException(std::string expected, std::string got) {
 		this->expected = expected;
 		this->got = got;
-	}
-	virtual const char* what() const throw() {
 		std::stringstream ss;
 		ss << "Read '" << got << "' where '" << expected << "' was expected!";
-		return ss.str().c_str();
+		message = ss.str();
+	}
+	virtual const char* what() const throw() {
+		return message.c_str();
 	}
 	virtual ~ParseException() throw() {}
 };
@@ -11,15 +11,15 @@
 #include <Eigen/Sparse>
 #include "geometry.h"
 
-// prints "rowNum indOfNonzero indOfNonzero etc"
+// prints "rowNum indOfNonzero indOfNonzero etc" (with label instead of rowNum if given)
 template <class T>
-inline void printSparseRow(std::ostream& out, Eigen::SparseMatrix<T> const & toPrint, int row) {
+inline void printSparseRow(std::ostream& out, Eigen::SparseMatrix<T> const & toPrint, int row, int label = -1) {
 //	const int* a = toPrint.outerIndexPtr();
 //	for (int i = 0; i < toPrint.outerSize(); ++i) {
 //
 //	}
 	// probably not the fastest..
-	out << row;
+	out << (label < 0 ? row : label);
 	for (int col = 0; col < toPrint.cols(); ++col) {
 		if (toPrint.coeff(row, col) != 0) out << " " << col;
 	}
@@ -0,0 +1,125 @@
+/*
+ * textScan.h
+ * Small scanners that read numbers straight out of a character buffer (like
+ * a memory mapped file) without allocating anything. They all take the
+ * current position by reference and advance it past what they read.
+ *
+ *  Created on: 2026-10-19
+ *      Author: david
+ */
+
+#ifndef TEXTSCAN_H_
+#define TEXTSCAN_H_
+
+#include <cstring>
+#include <cmath>
+
+namespace textScan {
+
+	inline bool isBlank(char c) {
+		return (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f');
+	}
+
+	inline bool isDigit(char c) { return (c >= '0' && c <= '9'); }
+
+	// skips spaces AND newlines
+	inline void skipBlanks(const char*& p, const char* end) {
+		while (p < end && isBlank(*p)) ++p;
+	}
+
+	// skips spaces and tabs only; stays on the current line
+	inline void skipSpaces(const char*& p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+	}
+
+	// moves p to the first character of the next line (or to end)
+	inline void skipLine(const char*& p, const char* end) {
+		const char* nl = (const char*) memchr(p, '\n', end - p);
+		p = (nl == NULL) ? end : nl + 1;
+	}
+
+	// reads an unsigned decimal integer. Leading spaces/newlines are skipped.
+	inline bool scanUnsigned(const char*& p, const char* end, unsigned& out) {
+		skipBlanks(p, end);
+		if (p == end || !isDigit(*p)) return false;
+		unsigned v = 0;
+		while (p < end && isDigit(*p)) {
+			v = v*10 + (*p - '0');
+			++p;
+		}
+		out = v;
+		return true;
+	}
+
+	// reads numbers like -12, .0083333, 3.5e-4. Leading spaces/newlines are skipped.
+	// The digits are collected in an integer and scaled once at the end, so
+	// the result is within a double rounding of strtod (more than enough for float).
+	inline bool scanDouble(const char*& p, const char* end, double& out) {
+		static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+				1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+				1e19, 1e20, 1e21, 1e22 };
+		skipBlanks(p, end);
+		const char* q = p;
+		bool neg = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			neg = (*q == '-');
+			++q;
+		}
+		unsigned long long mant = 0;
+		int exp10 = 0, digits = 0, sigDigits = 0;
+		for (; q < end && isDigit(*q); ++q, ++digits) {
+			if (sigDigits < 19) {
+				mant = mant*10 + (*q - '0');
+				if (mant != 0) sigDigits++;
+			} else {
+				exp10++; // too many digits to hold, just keep the magnitude
+			}
+		}
+		if (q < end && *q == '.') {
+			++q;
+			for (; q < end && isDigit(*q); ++q, ++digits) {
+				if (sigDigits < 19) {
+					mant = mant*10 + (*q - '0');
+					if (mant != 0) sigDigits++;
+					exp10--;
+				}
+			}
+		}
+		if (digits == 0) return false; // no number here
+		if (q < end && (*q == 'e' || *q == 'E')) {
+			const char* e = q + 1;
+			bool eNeg = false;
+			if (e < end && (*e == '-' || *e == '+')) {
+				eNeg = (*e == '-');
+				++e;
+			}
+			if (e < end && isDigit(*e)) {
+				int ev = 0;
+				for (; e < end && isDigit(*e); ++e) {
+					if (ev < 10000) ev = ev*10 + (*e - '0');
+				}
+				exp10 += eNeg ? -ev : ev;
+				q = e;
+			}
+		}
+		double v = (double) mant;
+		if (exp10 < 0) {
+			v = (exp10 >= -22) ? v / pow10[-exp10] : v * std::pow(10.0, exp10);
+		} else if (exp10 > 0) {
+			v = (exp10 <= 22) ? v * pow10[exp10] : v * std::pow(10.0, exp10);
+		}
+		out = neg ? -v : v;
+		p = q;
+		return true;
+	}
+
+	inline bool scanFloat(const char*& p, const char* end, float& out) {
+		double d;
+		if (!scanDouble(p, end, d)) return false;
+		out = (float) d;
+		return true;
+	}
+
+}
+
+#endif /* TEXTSCAN_H_ */